@@ -0,0 +1,87 @@
+#pragma once
+#include <istream>
+#include <string>
+#include <vector>
+
+// Pinyin typo correction ("ign" -> "ing", "uen" -> "un", ...).
+// Platform neutral; used by CDictionaryEngine and the benchmarks.
+
+struct CorrectionRule
+{
+    std::string pattern;
+    std::string replacement;
+
+    // Optional context, evaluated against the original key split into
+    // syllables (see MarkSyllableStarts). Empty conditions always hold.
+    bool atSyllableStart = false;       // Match must begin a syllable
+    bool atSyllableEnd = false;         // Match must end a syllable
+    std::vector<std::string> initials;  // Match must directly follow one of these initials ("j", "zh")
+};
+
+// The built-in correction table, used when no rules file is available.
+const std::vector<CorrectionRule>& GetDefaultCorrectionRules();
+
+// Parse a rules file. One rule per line, '#' starts a comment:
+//   pattern replacement [@start] [@end] [@initial=j,q,x,y]
+// Patterns and replacements are lowercase ASCII letters. Returns false on the
+// first malformed line and describes it in *error; `rules` is only replaced
+// when the whole file parses.
+bool LoadCorrectionRules(std::istream& in, std::vector<CorrectionRule>& rules, std::string* error);
+
+// All rules compiled into one Aho-Corasick automaton over 'a'-'z', so the
+// input is scanned once regardless of how many rules exist. When several
+// rules match, the one that completes first wins and, among those, the
+// longest whose conditions hold (file order breaks ties); matching then
+// restarts after the replaced text.
+class CCorrectionAutomaton
+{
+public:
+    CCorrectionAutomaton();
+
+    void Build(const std::vector<CorrectionRule>& rules);
+
+    // Apply all rules to `in`, writing at most `capacity` bytes to `out`.
+    // Returns the number of bytes written; sets *truncated if out was too small.
+    size_t Apply(const char* in, size_t len, char* out, size_t capacity, bool* truncated) const;
+
+    std::string Apply(const std::string& input) const;
+
+    size_t StateCount() const { return _next.size() / kAlphabet; }
+    size_t RuleCount() const { return _rules.size(); }
+
+private:
+    static const int kAlphabet = 27;    // 'a'-'z' plus one class for everything else
+
+    // Keys longer than this skip syllable segmentation; conditional rules
+    // then never match but unconditional ones still apply.
+    static const size_t kMaxContext = 256;
+
+    static int _Symbol(char c)
+    {
+        return (c >= 'a' && c <= 'z') ? c - 'a' : kAlphabet - 1;
+    }
+
+    bool _ConditionsHold(const CorrectionRule& rule, const char* in, size_t start, size_t end,
+                         const unsigned char* starts) const;
+
+    std::vector<unsigned short> _next;     // Dense DFA: state * kAlphabet + symbol
+    std::vector<unsigned short> _match;    // Nearest state (self or suffix) that ends a pattern, or 0
+    std::vector<unsigned short> _dictLink; // Next shorter pattern-ending suffix of a state, or 0
+    std::vector<int> _stateRule;           // First rule whose pattern ends exactly at a state, or -1
+    std::vector<int> _ruleNext;            // Next rule with the same pattern, or -1
+    std::vector<CorrectionRule> _rules;
+};
+
+// Process-wide automaton compiled from the default rules.
+const CCorrectionAutomaton& GetDefaultCorrector();
+
+// ---------------------------------------------------------
+// Fuzzy expansion
+// ---------------------------------------------------------
+
+// Variants of an already corrected key for sounds that are commonly
+// confused (z<->zh, c<->ch, s<->sh, l<->n, in<->ing), the key itself
+// first. The strings in `variants` are reused from the last call, so a
+// warm vector allocates nothing; returns the count, and entries past it
+// are stale.
+size_t GetFuzzyVariants(const std::string& key, std::vector<std::string>& variants);
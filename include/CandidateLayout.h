@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Candidate window geometry without GDI: text widths come from a cache in
+// front of the host's measuring call, and the layout turns them into the
+// window size and one cell per candidate, in a column or a row. Paint and
+// mouse handling both work from the same layout. Platform neutral.
+
+// Measures `len` characters of `text` in the host's font, in pixels.
+typedef std::function<int(const wchar_t* text, size_t len)> TextMeasure;
+
+// Widths of strings already measured, keyed by (font, string). Candidates
+// repeat from key to key ("你" shows up for ni, nih, niha...), so after
+// the first few keys nearly every width is a hit. Lookups hash the text in
+// place, so a hit allocates nothing.
+class CTextExtentCache
+{
+public:
+    explicit CTextExtentCache(size_t capacity);
+
+    // Width of `length` characters of `text` in font `font`, measured with
+    // `measure` on a miss.
+    int Width(uint32_t font, const wchar_t* text, size_t length, const TextMeasure& measure);
+    int Width(uint32_t font, const std::wstring& text, const TextMeasure& measure)
+    {
+        return Width(font, text.data(), text.length(), measure);
+    }
+
+    void Clear();
+
+    size_t Hits() const { return _hits; }
+    size_t Misses() const { return _misses; }
+
+private:
+    struct Entry
+    {
+        uint32_t font;
+        std::wstring text;
+        int width;
+    };
+
+    size_t _capacity;           // Entries kept before the cache starts over
+    std::unordered_map<uint64_t, Entry> _widths;    // By hash of (font, text); a collision is a miss
+    size_t _hits;
+    size_t _misses;
+};
+
+struct LayoutRect
+{
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+enum CandidateOrientation
+{
+    LAYOUT_VERTICAL,        // One candidate per line, as wide as the widest
+    LAYOUT_HORIZONTAL,      // One row, each cell as wide as its candidate
+};
+
+struct CandidateLayoutMetrics
+{
+    CandidateOrientation orientation;
+    int minWidth;
+    int padding;
+    int lineHeight;
+};
+
+struct CandidateCell
+{
+    LayoutRect rect;    // Highlight and hit-test rect
+    int labelX;         // Where "N. " is drawn
+    int textX;          // Where the candidate is drawn, right after its label
+    int textY;
+};
+
+// Cells in candidate order, which is also their order along the layout's
+// axis, so hit testing is a binary search.
+struct CandidateLayout
+{
+    CandidateOrientation orientation;
+    int width;          // Window size
+    int height;
+    std::vector<CandidateCell> cells;
+};
+
+// Compute the layout from the label widths (one per cell, "1. ", "2. "...)
+// and candidate text widths.
+void LayoutCandidates(const CandidateLayoutMetrics& metrics, const std::vector<int>& labelWidths,
+                      const std::vector<int>& textWidths, CandidateLayout& layout);
+
+// Index of the cell containing (x, y), or -1. O(log n).
+int HitTestCandidates(const CandidateLayout& layout, int x, int y);
+
+// The label drawn before candidate `index` ("1. " for 0). Static storage.
+const std::wstring& CandidateLabel(size_t index);
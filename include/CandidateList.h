@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CandidatePool.h"
+
+// Candidates in display order, as CCandidatePool ids. Copying or comparing
+// a list moves integers, never text. Clear() keeps every buffer, so a list
+// reused from key to key stops allocating once it has grown to the largest
+// candidate set seen. Platform neutral.
+class CCandidateList
+{
+public:
+    CCandidateList();
+
+    // Drop the candidates, keeping the memory for the next ones.
+    void Clear();
+
+    size_t Size() const { return _words.size(); }
+    bool Empty() const { return _words.empty(); }
+
+    // Append pool word `word` unless the list already holds it. Returns
+    // whether it was added.
+    bool Add(uint32_t word);
+    bool Add(const wchar_t* text, size_t length) { return Add(CCandidatePool::Instance().Intern(text, length)); }
+    bool Add(const std::wstring& text) { return Add(text.data(), text.length()); }
+
+    bool Contains(uint32_t word) const;
+
+    // Candidate `index`. The text lives in the pool, so the pointer stays
+    // valid after the list changes.
+    uint32_t Word(size_t index) const { return _words[index]; }
+    const wchar_t* Text(size_t index) const { return CCandidatePool::Instance().Text(_words[index]); }
+    size_t Length(size_t index) const { return CCandidatePool::Instance().Length(_words[index]); }
+    std::wstring String(size_t index) const { return std::wstring(Text(index), Length(index)); }
+
+    // Replace the contents with candidates [first, first + count) of
+    // `other`, or compare them with that range.
+    void AssignRange(const CCandidateList& other, size_t first, size_t count);
+    bool EqualsRange(const CCandidateList& other, size_t first, size_t count) const;
+
+    // Reorder candidates [first, Size()): position first + i receives the
+    // candidate that was at order[i], for i < count.
+    void Permute(size_t first, const uint32_t* order, size_t count);
+
+private:
+    size_t _Probe(uint32_t word) const;
+    void _Index(uint32_t word);
+    void _Reindex(size_t slots);
+
+    std::vector<uint32_t> _words;   // Pool ids by position
+    std::vector<uint32_t> _slots;   // Open-addressed set of the ids: id + 1, 0 if empty
+    std::vector<uint32_t> _scratch; // For Permute
+};
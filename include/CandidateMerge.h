@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include "CandidateList.h"
+
+// Merging candidates from several dictionaries (system lexicon, user
+// overlay, ...) that each return results in the same rank order.
+// Platform neutral.
+
+struct RankedCandidate
+{
+    uint32_t word;      // CCandidatePool id
+    uint32_t order;     // Position in its stream as added, to break ties
+    int keyLength;      // Length of the matched pinyin; shorter ranks first
+    int priority;       // Higher ranks first among equal key lengths
+};
+
+// True if `a` ranks strictly before `b`.
+inline bool RanksBefore(const RankedCandidate& a, const RankedCandidate& b)
+{
+    if (a.keyLength != b.keyLength) return a.keyLength < b.keyLength;
+    return a.priority > b.priority;
+}
+
+// One dictionary's results, in rank order once sorted. Either reused from
+// key to key, or built per batch in a composition's arena.
+struct RankedStream
+{
+    std::pmr::vector<RankedCandidate> ranks;
+
+    RankedStream() {}
+    explicit RankedStream(std::pmr::memory_resource* memory) : ranks(memory) {}
+
+    void Clear() { ranks.clear(); }
+    void Add(const wchar_t* text, size_t length, int keyLength, int priority);
+};
+
+// Sort a stream into rank order; source order breaks ties.
+void SortRankedStream(RankedStream& stream);
+
+// Part of a stream still to be merged; MergeRankedStreams advances `begin`
+// past what it consumed, so a merge can stop and resume later.
+struct RankedRange
+{
+    const RankedStream* stream;
+    size_t begin;
+    size_t end;
+};
+
+// K-way merge of ranges already in rank order, appending up to `limit`
+// candidates not yet in `out`. Ranges earlier in the array win ties, so an
+// overlay listed first shadows equally ranked base entries. Each range is
+// read once; with the handful of dictionaries merged here a scan of the
+// heads beats a heap, and needs no memory.
+size_t MergeRankedStreams(RankedRange* ranges, size_t count, size_t limit, CCandidateList& out);
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Every candidate string the process has shown, stored once and numbered.
+// Lexicon rows, overlay words and hot words are interned as they are read,
+// and candidate lists carry the numbers, so copying a page copies a few
+// integers. An interned word never changes or moves, so its id and text
+// pointer stay valid for the life of the process. The pool only grows, up
+// to the distinct words of the lexicon and overlay.
+//
+// Not locked: like the dictionary queries that fill it, it is used from
+// the text service's thread only. Platform neutral.
+class CCandidatePool
+{
+public:
+    static CCandidatePool& Instance();
+
+    // Id of `text`, adding it on first sight.
+    uint32_t Intern(const wchar_t* text, size_t length);
+
+    size_t Size() const { return _words.size(); }
+
+    const wchar_t* Text(uint32_t word) const { return _words[word].text; }
+    size_t Length(uint32_t word) const { return _words[word].length; }
+
+private:
+    CCandidatePool();
+
+    struct Word
+    {
+        const wchar_t* text;
+        uint32_t length;
+    };
+
+    // Text is appended to blocks of this many code units; a block is never
+    // reallocated, which is what keeps the pointers valid
+    static const size_t kBlockLength = 16384;
+
+    const wchar_t* _Store(const wchar_t* text, size_t length);
+    static uint32_t _Hash(const wchar_t* text, size_t length);
+    size_t _Probe(const wchar_t* text, size_t length, uint32_t hash) const;
+    void _Index(uint32_t word);
+    void _Reindex(size_t slots);
+
+    std::vector<std::unique_ptr<wchar_t[]>> _blocks;
+    size_t _blockUsed;              // Code units used in the last block
+    std::vector<Word> _words;       // By id
+    std::vector<uint32_t> _slots;   // Open-addressed index: id + 1, 0 if empty
+};
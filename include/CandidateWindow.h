@@ -2,6 +2,8 @@
 #include <windows.h>
 #include <string>
 #include <vector>
+#include "CandidateLayout.h"
+#include "CandidateList.h"
 
 class CTextService;
 struct ITfContext;
@@ -15,9 +17,16 @@ public:
     bool Initialize(HINSTANCE hInstance);
     void Destroy();
 
-    // Show the window at specific coordinates with candidate strings
-    void Show(int x, int y, const std::vector<std::wstring>& candidates, int selectedIndex);
+    // Show the window at specific coordinates with candidates [first,
+    // first + count) of `candidates`
+    void Show(int x, int y, const CCandidateList& candidates, size_t first, size_t count, int selectedIndex);
     void Hide();
+
+    // Show another page of candidates where the window already is
+    void SetCandidates(const CCandidateList& candidates, size_t first, size_t count, int selectedIndex);
+
+    // Move the highlight; repaints only the two cells involved
+    void SetSelection(int selectedIndex);
     
     // Check if window is currently visible
     bool IsVisible() const { return _hwnd != NULL && IsWindowVisible(_hwnd); }
@@ -27,12 +36,33 @@ public:
 
 private:
     static LRESULT CALLBACK _WndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
-    void _OnPaint(HDC hdc);
+    void _OnPaint(HDC hdc, const RECT& rcDirty);
+    void _Layout();
+    void _InvalidateCell(int index);
+    HDC _GetBackBuffer(HDC hdc, int width, int height);
+    void _ReleaseBackBuffer();
 
     HWND _hwnd;
-    std::vector<std::wstring> _candidates;
+    CCandidateList _candidates;     // The page shown, copied into buffers kept between pages
     int _selectedIndex;
     HFONT _hFont;
+    HBRUSH _hBrushBg;
+    HBRUSH _hBrushSel;
+
+    // Back buffer: painting goes here and is copied to the window, so a
+    // repaint never flickers. Grows to the largest window size seen.
+    HDC _hdcBack;
+    HBITMAP _hbmBack;
+    HGDIOBJ _hbmOld;
+    HGDIOBJ _hFontOld;
+    int _backWidth;
+    int _backHeight;
+
+    // Layout of _candidates, recomputed only when they change
+    CTextExtentCache _extents;
+    CandidateLayout _layout;
+    std::vector<int> _labelWidths;  // Scratch for _Layout
+    std::vector<int> _textWidths;
     
     // Callback mechanism
     CTextService* _pTextService;
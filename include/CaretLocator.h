@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+// Chooses how to find the caret for the candidate window. Hosts differ in
+// which of the strategies below work, and the failing ones cost a call
+// each, so the locator remembers the strategy that last worked for each
+// host window and tries it first. Platform neutral: the host supplies the
+// probes and an opaque window key.
+
+enum CaretStrategy
+{
+    CARET_TEXT_EXT,             // Composition extent from the edit session (GetTextExt)
+    CARET_VIEW_THREAD,          // GetGUIThreadInfo on the view's window thread
+    CARET_FOREGROUND_THREAD,    // GetGUIThreadInfo on the foreground window's thread
+    CARET_CARET_POS,            // GetCaretPos in the focus window
+    CARET_MOUSE,                // Below the mouse pointer
+    CARET_STRATEGY_COUNT,
+    CARET_NONE = CARET_STRATEGY_COUNT
+};
+
+struct CaretRect
+{
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+struct CaretStrategyStats
+{
+    unsigned long long attempts;
+    unsigned long long hits;
+    unsigned long long totalNs;     // Time spent in the probe, hit or miss
+};
+
+// Try one strategy; true and `rc` (screen coordinates) on success.
+typedef std::function<bool(CaretStrategy strategy, CaretRect& rc)> CaretProbe;
+
+class CCaretLocator
+{
+public:
+    // `recheckInterval`: a window whose only working strategy is the mouse
+    // fallback gets the full walk again every this many locates, in case
+    // it started reporting its caret.
+    explicit CCaretLocator(unsigned recheckInterval);
+
+    // Find the caret for `window`: its remembered strategy first, then
+    // every strategy in order. Returns the strategy that produced `rc`, or
+    // CARET_NONE if all failed. Without `textExtent` (no composition was
+    // measured, e.g. predictions after a commit) CARET_TEXT_EXT is skipped
+    // and nothing is learned, so the window keeps its strategy for the
+    // next composition.
+    CaretStrategy Locate(uintptr_t window, const CaretProbe& probe, CaretRect& rc, bool textExtent = true);
+
+    // The document in `window` changed; forget its strategy.
+    void Invalidate(uintptr_t window);
+
+    // Focus moved; forget everything.
+    void Clear();
+
+    const CaretStrategyStats& Stats(CaretStrategy strategy) const { return _stats[strategy]; }
+    static const char* StrategyName(CaretStrategy strategy);
+
+private:
+    struct Remembered
+    {
+        CaretStrategy strategy;
+        unsigned uses;          // Locates since the last full walk
+    };
+
+    CaretStrategy _LocateWithoutExtent(uintptr_t window, const CaretProbe& probe, CaretRect& rc);
+    bool _Try(CaretStrategy strategy, const CaretProbe& probe, CaretRect& rc);
+
+    unsigned _recheckInterval;
+    std::unordered_map<uintptr_t, Remembered> _remembered;
+    CaretStrategyStats _stats[CARET_STRATEGY_COUNT];
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for data that lives no longer than one composition: the
+// per-batch streams and rank scratch, the typo search and its SQL. An
+// allocation moves a pointer; freeing the most recent one moves it back,
+// anything else waits for Reset, which releases everything at once when
+// the composition ends (commit, escape). Blocks are kept for the next
+// composition, so once warm the arena takes nothing from the heap.
+//
+// A std::pmr::memory_resource, so std::pmr containers can live in it. They
+// must be destroyed before the next Reset. Platform neutral.
+class CCompositionArena : public std::pmr::memory_resource
+{
+public:
+    explicit CCompositionArena(size_t blockSize);
+
+    // Release everything allocated since the last Reset.
+    void Reset();
+
+    // Start measuring the peak of one query from the bytes held now.
+    void ResetPeak() { _peak = _used; }
+
+    // Record the peak since ResetPeak against composition length `length`.
+    void NoteLength(size_t length);
+
+    size_t Used() const { return _used; }           // Bytes held since the last Reset, padding included
+    size_t Peak() const { return _peak; }           // Most bytes held at once since the last ResetPeak or Reset
+    size_t Reserved() const { return _blocks.size() * _blockSize; }
+
+    // Largest Peak() noted at composition length `length`: the most one
+    // query held (with what earlier queries of its composition left),
+    // over every composition so far; 0 if that length was never seen.
+    size_t PeakAtLength(size_t length) const { return length < _peakByLength.size() ? _peakByLength[length] : 0; }
+    size_t LongestLength() const { return _peakByLength.empty() ? 0 : _peakByLength.size() - 1; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    void _Hold(size_t bytes);
+
+    size_t _blockSize;
+    std::vector<std::unique_ptr<unsigned char[]>> _blocks;  // Kept across Reset
+    size_t _current;                // Block being filled
+    size_t _offset;                 // Bytes used in it
+    unsigned char* _top;            // End of the most recent allocation
+    std::vector<size_t> _starts;    // _offset before each allocation in the current block, padding included; kept across Reset
+    std::vector<std::unique_ptr<unsigned char[]>> _large;   // Larger than a block; freed by Reset
+    size_t _used;
+    size_t _peak;
+    std::vector<size_t> _peakByLength;
+};
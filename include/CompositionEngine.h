@@ -0,0 +1,124 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "CandidateList.h"
+
+// The composition state machine behind CTextService::OnKeyDown: the pinyin
+// typed so far, its candidates, the page shown and the selection, or after
+// a commit the next words predicted for it. It consumes abstract key
+// events and reports what the host has to do (update the preedit, show the
+// candidate window, commit text); TSF edit sessions and windows stay in
+// CTextService. Platform neutral, so it can be benchmarked and fuzzed
+// without a TSF host.
+
+enum CompositionKeyCode
+{
+    COMP_KEY_LETTER,        // `ch` is 'a'..'z'
+    COMP_KEY_DIGIT,         // `ch` is '1'..'9'
+    COMP_KEY_BACKSPACE,
+    COMP_KEY_SPACE,
+    COMP_KEY_ENTER,
+    COMP_KEY_UP,
+    COMP_KEY_DOWN,
+    COMP_KEY_PAGE_UP,       // PgUp or '-'
+    COMP_KEY_PAGE_DOWN,     // PgDn or '='
+    COMP_KEY_ESCAPE,
+    COMP_KEY_MODIFIER,      // Shift, Ctrl or Alt on its own
+    COMP_KEY_OTHER,         // Anything else, including chords with Ctrl/Alt
+};
+
+struct CompositionKey
+{
+    CompositionKeyCode code;
+    wchar_t ch;
+};
+
+// Host actions, combined as bit flags in CompositionResult::actions. The
+// host applies them in the order listed.
+enum CompositionAction
+{
+    ACTION_LEARN = 1 << 0,              // The commit chose a candidate for CommitKey() (empty for a prediction)
+    ACTION_END_COMMIT_RUN = 1 << 1,     // The next commit does not continue a phrase
+    ACTION_COMMIT = 1 << 2,             // Insert CommitText() and end the composition
+    ACTION_UPDATE_PREEDIT = 1 << 3,     // Show Composition() as the preedit
+    ACTION_END_COMPOSITION = 1 << 4,    // Remove the preedit without inserting anything
+    ACTION_SHOW_CANDIDATES = 1 << 5,    // The candidates changed: place and show the window
+    ACTION_MOVE_SELECTION = 1 << 6,     // Only Selection() changed: redraw in place
+    ACTION_SHOW_PAGE = 1 << 7,          // Another page is shown: redraw without moving
+    ACTION_HIDE_CANDIDATES = 1 << 8,
+};
+
+struct CompositionResult
+{
+    bool eaten;             // The key belongs to the IME, not the application
+    unsigned actions;       // CompositionAction flags
+};
+
+// Appends candidates for a composition string: the first batch when `more`
+// is false (`candidates` is then empty), the batch after those already in
+// `candidates` when true. Returns whether another batch may follow, so
+// later pages are fetched only when the user turns to them.
+typedef std::function<bool(const std::wstring& composition, bool more, CCandidateList& candidates)> CandidateSource;
+
+// Fills `predictions` (empty) with the words likely to follow `committed`.
+typedef std::function<void(const std::wstring& committed, CCandidateList& predictions)> PredictionSource;
+
+class CCompositionEngine
+{
+public:
+    // Without `predict`, the candidate window closes after every commit.
+    CCompositionEngine(const CandidateSource& source, int pageSize, const PredictionSource& predict = PredictionSource());
+
+    // Whether OnKey would eat `key` in the current state (OnTestKeyDown).
+    bool WouldEat(const CompositionKey& key) const;
+
+    CompositionResult OnKey(const CompositionKey& key);
+
+    // Commit candidate `index` of the page (a click in the candidate window). Not eaten
+    // if there is no such candidate.
+    CompositionResult SelectCandidate(int index);
+
+    // Drop the composition or the predictions without host actions, e.g.
+    // when the application terminated the composition.
+    void Reset();
+
+    // The candidates are next-word predictions for the last commit. Only
+    // digits, page keys and Escape act on them; a letter starts a new
+    // composition, and any other key goes to the application and
+    // dismisses them.
+    bool Predicting() const { return _predicting; }
+
+    const std::wstring& Composition() const { return _composition; }
+    // Every candidate fetched so far; the page shown is PageLength()
+    // candidates from PageStart(), and Selection() counts from there
+    const CCandidateList& Candidates() const { return _candidates; }
+    size_t PageStart() const { return (size_t)_pageStart; }
+    size_t PageLength() const;
+    int Page() const { return _pageStart / _pageSize; }
+    int Selection() const { return _selection - _pageStart; }
+
+    // Valid after ACTION_COMMIT until the next key.
+    const std::wstring& CommitText() const { return _commitText; }
+    const std::wstring& CommitKey() const { return _commitKey; }
+
+private:
+    CompositionResult _Refresh();
+    CompositionResult _Commit(size_t id);
+    CompositionResult _CommitRaw();
+    CompositionResult _MoveTo(int index);
+    bool _Fetch(size_t count);
+    bool _WouldEatPrediction(const CompositionKey& key) const;
+
+    CandidateSource _source;
+    PredictionSource _predict;
+    int _pageSize;
+    std::wstring _composition;              // Pinyin typed so far (e.g. "nihao")
+    CCandidateList _candidates;             // Fetched so far, or the predictions; never empty while composing
+    bool _more;                             // The source may have more after _candidates
+    bool _predicting;                       // _candidates are predictions and _composition is empty
+    int _pageStart;                         // First candidate of the page shown
+    int _selection;                         // Index into _candidates for up/down navigation
+    std::wstring _commitText;
+    std::wstring _commitKey;
+};
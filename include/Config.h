@@ -12,6 +12,9 @@ namespace Config {
         const int Y_OFFSET = 25;            // Y-axis offset from cursor position
         const int PADDING = 5;              // Internal padding
         const int LINE_HEIGHT = 24;         // Height of each candidate line
+        const bool HORIZONTAL = false;      // Candidates in one row instead of a column
+        const int EXTENT_CACHE_SIZE = 4096; // Measured strings kept before the cache starts over
+        const int PAGE_SIZE = 9;            // Candidates per page, one per digit key
     }
 
 // ===================================================================
@@ -23,6 +26,8 @@ namespace Config {
         const int FALLBACK_HEIGHT = 20;          // Default caret height
         const int DEFAULT_POSITION_X = 100;      // Default X position if all strategies fail
         const int DEFAULT_POSITION_Y = 100;      // Default Y position if all strategies fail
+        const int MOUSE_RECHECK_INTERVAL = 16;   // Retry real caret strategies in mouse-only windows
+        const int STATS_LOG_INTERVAL = 256;      // Candidate window placements between strategy stats
     }
 
 // ===================================================================
@@ -30,7 +35,35 @@ namespace Config {
 // ===================================================================
     namespace Dictionary {
         const int MAX_FUZZY_VARIANTS = 5;   // Maximum number of fuzzy pinyin variants
-        const int MAX_QUERY_RESULTS = 20;   // Maximum SQL query result limit
+        const int QUERY_BATCH_SIZE = 18;    // Candidates fetched per query batch (two pages)
+        const int MAX_KEY_LENGTH = 128;     // Maximum composition length passed to a query
+        const int TYPO_TRIGGER_RESULTS = 3; // Run typo search when fewer candidates than this
+        const int TYPO_MAX_COST = 2;        // Largest edit cost (adjacent key = 1, missing/extra/swap = 2)
+        const int TYPO_WORK_BUDGET = 4000;  // Trie rows evaluated per typo search (~0.2 ms)
+        const int TYPO_MAX_KEYS = 8;        // Corrected keys queried in one statement
+        const int HOT_SET_MAX_BYTES = 16 * 1024 * 1024; // Cap on the hot set prefetched after activation
+        const int ARENA_BLOCK_SIZE = 64 * 1024;         // Per-composition query scratch, allocated a block at a time
+        const int MAX_PREDICTIONS = 18;     // Next-word suggestions shown after a commit (two pages)
+    }
+
+// ===================================================================
+// User History Configuration
+// ===================================================================
+    namespace UserHistory {
+        const int WRITE_BATCH = 32;         // Dirty entries that trigger an immediate write
+        const int WRITE_DELAY_MS = 2000;    // Longest a selection waits before it reaches user.db
+        const int JOURNAL_COMPACT_BYTES = 64 * 1024;    // Journal size that triggers folding it into user.db
+        const int RANK_WEIGHT = 3;          // Positions gained per doubling of a candidate's selections
+        const int MAX_USER_WORDS = 20000;   // Cap on the user overlay (learned words and phrases)
+        const int USER_WORD_PRIORITY = 15;  // Priority of overlay words (system lexicon spans 0..15)
+        const int PHRASE_CANDIDATES = 4096; // Commit sequences tracked by the phrase learner
+        const int PHRASE_PROMOTE_COUNT = 2; // Sightings that make a commit sequence a user phrase
+        const int PHRASE_MAX_CHARS = 8;     // Longest learned phrase, in characters
+        const int PHRASE_MAX_SEGMENTS = 4;  // Most commits joined into one phrase
+        const int PHRASE_GAP_MS = 10000;    // Commits further apart do not form a phrase
+        const int PHRASE_AGING_INTERVAL = 1000; // Commits before an unseen sequence starts to fade
+        const int MAX_SUCCESSORS = 18;      // Learned next words kept per word
+        const int MAX_SUCCESSOR_WORDS = 20000;  // Words with learned next words
     }
 
 // ===================================================================
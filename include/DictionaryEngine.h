@@ -1,23 +1,147 @@
 #pragma once
 #include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "sqlite/sqlite3.h"
+#include "Config.h"
+#include "AutoCorrect.h"
+#include "TypoCorrector.h"
+#include "UserHistory.h"
+#include "CandidateList.h"
+#include "CandidateMerge.h"
+#include "CompositionArena.h"
+#include "MixedPinyin.h"
+#include "PhraseLearner.h"
+#include "PagePrefetch.h"
+
+// What the keys of a query are matched against.
+enum QueryMode
+{
+    QUERY_PINYIN,       // Prefixes of the full pinyin ("zhongg")
+    QUERY_INITIALS,     // Prefixes of the syllable initials ("zg" for "zhg")
+    QUERY_MIXED,        // Initials prefixes, filtered by whole syllables and initials ("nhao")
+    QUERY_MODE_COUNT,
+};
+
+// Where a query stopped, so later pages can be fetched without computing
+// the earlier ones again. Filled by Query, advanced by QueryMore; callers
+// only hold on to it. It also owns the memory a query works in: buffers
+// reused from key to key, and an arena for each batch's scratch that is
+// reset when the composition ends, so the query path stays off the heap.
+struct QueryCursor
+{
+    QueryCursor() : arena(Config::Dictionary::ARENA_BLOCK_SIZE) {}
+
+    size_t inputLength;                     // Composition length, for the arena's statistics
+    std::string key;                        // Corrected key, for user history
+    QueryMode mode;
+    std::vector<std::string> searchKeys;    // Initials readings, initials of the mixed readings, or fuzzy variants
+    std::vector<MixedReading> readings;     // Mixed readings of the key, for QUERY_MIXED
+    size_t readingCount;
+    std::vector<std::string> searchEnds;    // PrefixEnd of each variant
+    size_t searchKeyCount;                  // Entries of the two above in use
+    RankedStream userStream;
+    size_t userNext;                        // Overlay entries merged so far
+    bool started;                           // The lexicon fields below are set
+    int lastLength;                         // Rank of the last lexicon row read (key length in the mode's column)
+    int lastPriority;
+    sqlite3_int64 lastRowid;
+    bool lexiconDone;
+    bool exhausted;                         // Nothing left to fetch
+    CCompositionArena arena;
+};
 
 class CDictionaryEngine
 {
 public:
     static CDictionaryEngine& Instance();
 
+    // Open the lexicon and user data; blocks until done.
     bool Initialize();
-    std::vector<std::wstring> Query(const std::wstring& pinyin);
+
+    // Start Initialize on a background thread and return at once. Until it
+    // completes, queries are answered from the built-in hot-word table and
+    // learning is not recorded.
+    void InitializeAsync();
+    bool IsReady() const { return _isInitialized.load(std::memory_order_acquire); }
+
+    // First batch of candidates for `pinyin` into `results` (cleared).
+    // Returns true if QueryMore can find more.
+    bool Query(const std::wstring& pinyin, QueryCursor& cursor, CCandidateList& results);
+
+    // Append the next batch for the query `cursor` came from to `results`,
+    // which holds the earlier batches. Returns true if there may be more
+    // after it.
+    bool QueryMore(QueryCursor& cursor, CCandidateList& results);
+
+    // The composition `cursor` served has ended (commit, escape): release
+    // what its queries left in the cursor's arena.
+    void EndComposition(QueryCursor& cursor);
+
+    // Next-word suggestions after `text` was committed into `results`
+    // (cleared): the words the user has committed after it, then the
+    // lexicon's successor list. One primary key lookup, no prefix query.
+    // Returns whether there are any.
+    bool Predict(const std::wstring& text, CCandidateList& results);
+
+    // Learn that `hanzi` was chosen for `pinyin` (empty for a prediction).
+    // Memory only; persisted in the background. Consecutive commits also
+    // feed the phrase learner and teach the words that follow each other.
+    void RecordCommit(const std::wstring& pinyin, const std::wstring& hanzi);
+
+    // The text that follows is not a continuation of the last commit (raw
+    // commit, cancelled composition, other keys typed, focus lost).
+    void EndCommitRun();
+
+    // Add a word or phrase to the user overlay; it is merged with the
+    // system lexicon from the next query on.
+    void AddUserWord(const std::wstring& pinyin, const std::wstring& hanzi);
+
+    // Wait for the loader, persist pending learning data and stop the
+    // writer thread. Call before the DLL unloads: the destructor runs under
+    // the loader lock and never waits for either thread.
+    void FlushUserData();
 
 private:
     CDictionaryEngine();
     ~CDictionaryEngine();
     
     bool _CreateDatabase();
+    bool _Load();
+    bool _OpenLexicon(const std::wstring& dbPath);
+    void _ReadHotSet(std::vector<FileRange>& ranges);
+    bool _HasColumn(const char* table, const char* column);
+    void _RegisterFunctions();
+    void _WaitForInitialize();
+    void _QueryHotWords(const std::wstring& pinyin, CCandidateList& results);
+    void _LoadCorrectionRules();
+    void _OpenUserHistory();
+    bool _MakeKey(const std::wstring& pinyin, std::string& key) const;
+    void _AddOverlayWord(const std::string& key, const std::wstring& hanzi);
+    void _ApplyUserHistory(QueryCursor& cursor, CCandidateList& results, size_t first) const;
+    sqlite3_stmt* _PrefixStatement(QueryMode mode, size_t keyCount, bool resume);
+    void _QueryKeys(QueryCursor& cursor, int limit, RankedStream& stream);
+    void _FetchBatch(QueryCursor& cursor, CCandidateList& results);
+    void _QueryTypoKeys(const std::pmr::vector<TypoCandidate>& typos, int limit, CCandidateList& results,
+                        std::pmr::memory_resource* memory);
 
     sqlite3* _db;
-    bool _isInitialized;
+    bool _hasAbbreviations;                 // The lexicon has an abbreviations table with pinyin; older ones have none
+    bool _hasSuccessors;                    // The lexicon has successor lists; older ones have none
+    sqlite3_stmt* _successorStatement;      // Prepared on first use
+    sqlite3_stmt* _prefixStatements[QUERY_MODE_COUNT][Config::Dictionary::MAX_FUZZY_VARIANTS][2];  // By mode, key count - 1, resume
+    sqlite3_stmt* _typoStatements[Config::Dictionary::TYPO_MAX_KEYS];  // By key count - 1
+    std::atomic<bool> _isInitialized;      // Set last by the loader; everything below is safe to use once true
+    std::mutex _initLock;                   // Guards starting _initTask
+    std::shared_future<bool> _initTask;
+    std::chrono::steady_clock::time_point _initStart;
+    std::atomic<int> _hotQueries;           // Queries answered before the lexicon was ready
+    CCorrectionAutomaton _corrector;
+    CUserHistory _history;
+    CPhraseLearner _phrases;
+    std::wstring _lastCommit;               // Text of the previous commit in the run, for learning successors
 };
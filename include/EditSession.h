@@ -22,13 +22,19 @@ protected:
     long _cRef;
 };
 
+// Sets the composition to the text service's current pinyin when it runs
+// (not when it is requested), then measures where the composition landed
+// and shows the candidate window there.
 class CUpdateCompositionEditSession : public CEditSessionBase
 {
 public:
-    CUpdateCompositionEditSession(CTextService *pTextService, ITfContext *pContext, const std::wstring &text);
+    CUpdateCompositionEditSession(CTextService *pTextService, ITfContext *pContext);
     STDMETHODIMP DoEditSession(TfEditCookie ec);
+
+    bool IsFor(ITfContext *pContext) const { return _pContext == pContext; }
+
 private:
-    std::wstring _text;
+    RECT _GetTextRect(TfEditCookie ec);
 };
 
 class CEndCompositionEditSession : public CEditSessionBase
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <strsafe.h>
+#include "Config.h"
 
 // Global HINSTANCE for the DLL
 extern HINSTANCE g_hInst;
@@ -24,3 +25,8 @@ void DllRelease();
 
 // Debug Logger Helper
 void DebugLog(const wchar_t* format, ...);
+
+// Per-keystroke detail. Each DebugLog opens the log file, so these are
+// logged only when Config::Log::DEFAULT_LEVEL is LOG_LEVEL_DEBUG.
+#define DebugTrace(...) \
+    do { if (Config::Log::DEFAULT_LEVEL <= Config::Log::LOG_LEVEL_DEBUG) DebugLog(__VA_ARGS__); } while (0)
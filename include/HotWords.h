@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+
+// A small built-in table of the most frequent characters and words, so the
+// first keystrokes after activation get candidates while the lexicon is
+// still opening in the background. Platform neutral.
+
+// Up to `max` entries whose key starts with key[0..len), shortest key
+// first, then most frequent. Returns the number written to `out`.
+size_t LookupHotWords(const char* key, size_t len, const wchar_t** out, size_t max);
+
+size_t HotWordCount();
+
+// Key of entry `index` (< HotWordCount()), for tools that warm the lexicon
+// for the same prefixes.
+const char* HotWordKey(size_t index);
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Append-only journal in front of the user database. Learning events are
+// buffered in memory on the key path and made durable in groups by the
+// background writer (one fsync per group), so a crash of the host process
+// loses at most the events of the group in flight. Platform neutral.
+//
+// On disk the journal is a 4-byte header followed by records:
+//   u32 length | u32 crc32(length, payload) | payload
+// Payloads are opaque to the journal. A record that is short, oversized or
+// fails its checksum marks the end of the valid log; everything from there
+// on is a torn write and is cut off when the journal is opened.
+//
+// Once the events are contained in a durable snapshot (user.db), the owner
+// calls Reset() to start an empty journal.
+
+// File names in the platform's own form: UTF-16 for _wfopen on Windows,
+// bytes for fopen elsewhere.
+#ifdef _WIN32
+typedef std::wstring JournalPath;
+#else
+typedef std::string JournalPath;
+#endif
+
+// Largest payload accepted; longer lengths are treated as corruption.
+const size_t MAX_JOURNAL_RECORD = 64 * 1024;
+
+class CLearningJournal
+{
+public:
+    CLearningJournal();
+    ~CLearningJournal();
+
+    // Open or create the journal, calling `replay` for every valid record in
+    // order and truncating any torn tail. Returns the number of records
+    // replayed, or -1 if the file cannot be opened.
+    long Open(const JournalPath& path, const std::function<void(const char*, size_t)>& replay);
+    void Close();
+
+    // Queue a record. Memory only; safe to call from any thread once the
+    // journal is open (records are dropped while it is not).
+    void Append(const std::string& payload);
+
+    // Write every queued record and fsync once. Call from one thread.
+    bool Commit();
+
+    // Discard the journal contents, including anything still queued. The
+    // caller guarantees the events are already in a durable snapshot.
+    bool Reset();
+
+    // Bytes on disk plus bytes queued. Call from the committing thread.
+    size_t Size() const;
+    bool HasPending() const;
+
+private:
+    bool _Sync();
+
+    FILE* _file;
+    size_t _fileSize;
+
+    mutable std::mutex _lock;   // Guards _pending
+    std::string _pending;       // Encoded records not yet written
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Keys typed as a mix of whole syllables and initials: "nhao" for ni hao,
+// "zhgguo" for zhong guo. Neither the full pinyin nor the initials column
+// matches them as typed; the key is read as pieces, one per syllable, and
+// the lexicon is searched by the pieces' initials and filtered by the
+// pieces themselves. Platform neutral.
+
+// One piece of a reading: key letters [start, start + length), standing
+// for exactly that syllable (whole) or for any syllable that begins with
+// them (an initial). The last piece is matched as a prefix either way,
+// since the user may still be typing it.
+struct MixedPiece
+{
+    unsigned char start;
+    unsigned char length;
+    bool whole;
+};
+
+struct MixedReading
+{
+    std::string initials;               // First letter of each piece, as the initials column holds them
+    std::vector<MixedPiece> pieces;
+};
+
+// Longest key split into readings; longer ones are not mixed keys.
+const size_t MAX_MIXED_KEY_LENGTH = 64;
+
+// The readings of `key` as whole syllables and initials, fewest pieces
+// first. Each position of a segmentation lattice holds the syllables and
+// initials that start there, and only paths that reach the end of the key
+// are followed. A key with no initial in it (full pinyin, possibly ending
+// in an unfinished syllable) or that no path covers has no readings.
+// Writes at most `max` into `readings`, reusing their buffers, and returns
+// the count. The lattice lives in `memory`.
+size_t GetMixedReadings(const char* key, size_t len, std::vector<MixedReading>& readings, size_t max,
+                        std::pmr::memory_resource* memory);
+
+// The initials prefix ranges that cover `readings`: each reading's
+// initials, leaving out those inside another range ("nha" within "nh").
+// Reuses the strings of `keys` and returns the count.
+size_t GetMixedSearchKeys(const std::vector<MixedReading>& readings, size_t readingCount, std::vector<std::string>& keys);
+
+// True if a word whose full pinyin is `pinyin` and whose syllable
+// initials are `initials` begins with the syllables that `reading` of
+// `key` stands for. Syllable boundaries in `pinyin` are taken where the
+// initials say the next syllable starts.
+bool MatchesMixedReading(const char* key, const MixedReading& reading, const char* pinyin, size_t pinyinLength,
+                         const char* initials, size_t initialsLength);
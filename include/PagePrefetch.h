@@ -0,0 +1,19 @@
+#pragma once
+#include <windows.h>
+#include <string>
+#include <vector>
+
+// Byte range of a file to bring into the system cache.
+struct FileRange
+{
+    ULONGLONG offset;
+    ULONGLONG length;
+};
+
+// Bring `ranges` of the file at `path` into the system file cache so the
+// first queries do not wait on disk. Maps the file, hands the ranges to
+// PrefetchVirtualMemory where available (Windows 8+) so the reads are
+// issued in large batches, then touches each page to make sure it is
+// resident. Blocking; call from a background thread. Returns the number of
+// bytes covered.
+ULONGLONG PrefetchFileRanges(const std::wstring& path, const std::vector<FileRange>& ranges);
@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Learns new phrases from runs of consecutive commits: choosing "输入" and
+// then "法" back to back, twice, promotes "输入法" (shuru + fa) to a user
+// phrase. Platform neutral; the caller supplies the clock and stores the
+// promoted phrases.
+
+struct PhraseLearnerLimits
+{
+    size_t capacity;            // Phrase candidates tracked before eviction
+    int promoteCount;           // Sightings that turn a candidate into a phrase
+    size_t maxChars;            // Longest phrase, in characters
+    size_t maxSegments;         // Most commits joined into one phrase
+    unsigned long long maxGapMs;    // Commits further apart than this do not join
+    size_t agingInterval;       // Observations between count decays
+};
+
+struct LearnedPhrase
+{
+    std::string key;            // Joined full pinyin ("shurufa")
+    std::wstring text;          // Joined text ("输入法")
+};
+
+class CPhraseLearner
+{
+public:
+    explicit CPhraseLearner(const PhraseLearnerLimits& limits);
+
+    // Observe one committed candidate. `key` is the normalized pinyin it was
+    // chosen for and `nowMs` a monotonic clock. Appends any phrases that
+    // reached promoteCount to `promoted` and returns how many were added.
+    //
+    // Only commits whose key splits into exactly one syllable per character
+    // take part; anything else (abbreviations, prefix matches, typos) ends
+    // the run, since the joined pinyin would be wrong.
+    size_t Observe(const std::string& key, const std::wstring& text, unsigned long long nowMs,
+                   std::vector<LearnedPhrase>& promoted);
+
+    // End the current run (raw commit, cancelled composition, caret moved,
+    // focus lost). The next commit starts a new phrase.
+    void Break();
+
+    size_t CandidateCount() const { return _candidates.size(); }
+
+private:
+    struct Candidate
+    {
+        std::string key;
+        int count;
+        unsigned long long lastSeen;    // Observation tick
+    };
+
+    struct Segment
+    {
+        std::string key;
+        std::wstring text;
+        size_t chars;
+    };
+
+    void _Age();
+    void _Evict();
+
+    PhraseLearnerLimits _limits;
+    std::vector<Segment> _run;          // Most recent commits, oldest first
+    unsigned long long _lastCommitMs;
+    unsigned long long _tick;
+    std::unordered_map<std::wstring, Candidate> _candidates;    // Joined text -> candidate
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+
+// Pinyin text normalization shared by the engine and the offline tools.
+// This header must stay free of windows.h so DictBuilder and other
+// command-line tools can compile it unchanged.
+
+// Decode a single UTF-8 sequence at the start of `s` (at most `len` bytes).
+// Returns the number of bytes consumed (always >= 1 when len > 0) and stores
+// the code point in `cp`. Malformed or truncated sequences yield U+FFFD and
+// consume one byte so the caller can resynchronize.
+size_t DecodeUtf8(const char* s, size_t len, char32_t& cp);
+
+// Map a pinyin letter (ASCII or tone-marked, either case) to its bare
+// lowercase ASCII letter. ü and its tone forms map to 'v'. Returns 0 for
+// code points that are not pinyin letters.
+char ToneMarkToAscii(char32_t cp);
+
+// Outcome of a span-based StripTones call.
+struct ToneStripResult
+{
+    size_t length;    // Bytes written to the output buffer
+    size_t unknown;   // Non-ASCII code points that are not pinyin letters
+    bool truncated;   // Output buffer was too small; `length` bytes are valid
+};
+
+// Strip tone marks from UTF-8 pinyin without allocating: "HǍO" -> "hao",
+// "lǜ" -> "lv". Writes at most `capacity` bytes to `out` (not terminated).
+// ASCII digits, spaces and punctuation are dropped silently, as are combining
+// diacritics (U+0300-U+036F) that follow a base letter. Anything else is
+// dropped and counted in `unknown` so callers can report bad input.
+ToneStripResult StripTones(const char* in, size_t len, char* out, size_t capacity);
+
+// Convenience wrapper over the span API.
+std::string StripTones(const std::string& pinyin);
+
+// ---------------------------------------------------------
+// Composition key normalization
+// ---------------------------------------------------------
+
+// Outcome of converting raw UTF-16 composition text into key bytes.
+struct KeyNormalizeResult
+{
+    size_t length;    // Bytes written to the output buffer
+    bool ok;          // False if the input contained non-ASCII code units or did not fit
+};
+
+// Convert UTF-16 composition input to lowercase ASCII key bytes in one pass.
+// Every code unit must be ASCII; anything else fails the whole key since the
+// dictionary is keyed on plain pinyin letters. Dispatches once to SSE2 when
+// the CPU has it, scalar otherwise.
+KeyNormalizeResult NormalizeKey(const char16_t* in, size_t len, char* out, size_t capacity);
+
+#ifdef _WIN32
+inline KeyNormalizeResult NormalizeKey(const wchar_t* in, size_t len, char* out, size_t capacity)
+{
+    static_assert(sizeof(wchar_t) == sizeof(char16_t), "wchar_t is UTF-16 on Windows");
+    return NormalizeKey(reinterpret_cast<const char16_t*>(in), len, out, capacity);
+}
+#endif
+
+// Individual kernels, exposed for benchmarks. `out` must hold `len` bytes.
+// NormalizeKey does not use the AVX2 kernel: it is slower than SSE2 on keys
+// of typical length and only matches it on long ones.
+// They return false as soon as a non-ASCII code unit is seen.
+bool NormalizeKeyScalar(const char16_t* in, size_t len, char* out);
+bool NormalizeKeySse2(const char16_t* in, size_t len, char* out);
+bool NormalizeKeyAvx2(const char16_t* in, size_t len, char* out);
+bool CpuHasSse2();
+bool CpuHasAvx2();
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// The Hanyu Pinyin syllable inventory (toneless, ü written as v) and
+// helpers for splitting typed keys into syllables. Platform neutral.
+
+// Longest syllable in letters ("zhuang", "chuang", "shuang").
+const size_t MAX_SYLLABLE_LENGTH = 6;
+
+// True if s[0..len) is a complete syllable such as "zhong" or "lve".
+bool IsPinyinSyllable(const char* s, size_t len);
+
+// True if s[0..len) can be extended into a syllable ("zho", "x").
+bool IsPinyinSyllablePrefix(const char* s, size_t len);
+
+// Length of the initial consonant at the start of s ("zh" -> 2, "b" -> 1,
+// vowels and non-initials -> 0).
+size_t PinyinInitialLength(const char* s, size_t len);
+
+// Mark syllable starts in a typed key by greedy longest-match segmentation.
+// starts[i] is set to 1 when a syllable begins at position i, and
+// starts[len] is always 1. Runs of letters that do not form a syllable
+// are consumed as far as they remain a valid syllable prefix (at least one
+// letter), so incomplete or mistyped input still gets boundaries.
+// `starts` must hold len + 1 entries.
+void MarkSyllableStarts(const char* s, size_t len, unsigned char* starts);
+
+// Syllable initials of a full-pinyin key as the lexicon's initials column
+// holds them: the first letter of each syllable ("zhongguo" -> "zg").
+std::string SyllableInitials(const char* s, size_t len);
+
+// If `key` is typed as initials alone (only consonants, and more than a
+// single initial, which could still become a syllable), the initials
+// strings it can stand for, in the form of the initials column. zh, ch and
+// sh read first as one initial, stored as its first letter, then as two
+// ("zhg" -> "zg", "zhg"). Writes at most `max` into `keys`, reusing its
+// strings, and returns the count; 0 means `key` is not an abbreviation.
+size_t GetInitialsKeys(const std::string& key, std::vector<std::string>& keys, size_t max);
+
+// Incremental walk over the syllable trie, for searches that build keys one
+// letter at a time. Node 0 is the root; a step returns 0 when no syllable
+// continues with `c`.
+size_t SyllableTrieStep(size_t node, char c);
+bool SyllableTrieIsTerminal(size_t node);
+
+// Enumerate the letters that continue `node`, in alphabetical order.
+// `letters` and `children` must hold 26 entries; returns the count.
+size_t SyllableTrieChildren(size_t node, char* letters, size_t* children);
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+
+// SQLite URI for opening a database file that is never written, such as the
+// shipped lexicon in the install directory. "immutable=1" tells SQLite the
+// file cannot change while open, so it takes no locks and creates no
+// -journal/-wal files (the directory may not be writable at all).
+// Pass the result to sqlite3_open_v2 with SQLITE_OPEN_READONLY | SQLITE_OPEN_URI.
+// Platform neutral; `utf8Path` may use '\' or '/' and a drive letter, and
+// may be a UNC path (\\server\share\...) or have the \\?\ prefix.
+inline std::string MakeImmutableSqliteUri(const std::string& utf8Path)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    // \\?\C:\... is C:\..., and \\?\UNC\server\... is \\server\...
+    std::string path = utf8Path;
+    if (path.compare(0, 8, "\\\\?\\UNC\\") == 0) path.replace(0, 8, "\\\\");
+    else if (path.compare(0, 4, "\\\\?\\") == 0) path.erase(0, 4);
+
+    std::string uri = "file:";
+    if (path.length() >= 2 && path[1] == ':') uri += '/';    // file:/C:/...
+    else if (path.length() >= 2 && (path[0] == '\\' || path[0] == '/') && (path[1] == '\\' || path[1] == '/'))
+    {
+        // A UNC path needs an empty authority in front, file:////server/share/...;
+        // SQLite rejects file://server/... as a remote host
+        uri += "//";
+    }
+    for (char c : path)
+    {
+        if (c == '\\') c = '/';
+        if (c == '%' || c == '?' || c == '#' || c == ' ')
+        {
+            uri += '%';
+            uri += hex[(unsigned char)c >> 4];
+            uri += hex[(unsigned char)c & 0xF];
+        }
+        else
+        {
+            uri += c;
+        }
+    }
+    uri += "?mode=ro&immutable=1";
+    return uri;
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "Globals.h"
 #include "CandidateWindow.h"
+#include "CompositionEngine.h"
+#include "DictionaryEngine.h"
+#include "CaretLocator.h"
 
 class CUpdateCompositionEditSession;
 class CEndCompositionEditSession;
@@ -52,13 +55,21 @@ private:
     void _UninitKeyEventSink();
 
     HRESULT _UpdateComposition(ITfContext *pContext);
+    void _CancelPendingUpdate();
     HRESULT _EndComposition(ITfContext *pContext);
     
-    // Helper method to commit candidate text (extracted common logic)
+    // Insert text into the document, ending the composition
     HRESULT _CommitCandidateText(ITfContext *pContext, const std::wstring& text);
+
+    // Carry out the host actions the composition engine asked for
+    void _ApplyResult(ITfContext *pContext, const CompositionResult& result);
     
-    // Update Candidate Window
-    void _UpdateCandidateWindow(ITfContext *pContext);
+    // Update Candidate Window; rcText is the composition's screen extent,
+    // empty if unknown
+    // `rcText` is the composition's extent; NULL when there is no
+    // composition to measure (predictions after a commit).
+    void _UpdateCandidateWindow(ITfContext *pContext, const RECT *prcText);
+    static uintptr_t _CaretWindowKey(ITfContext *pContext, HWND *phwndView);
 
     long _cRef;
     ITfThreadMgr *_pThreadMgr;
@@ -66,14 +77,13 @@ private:
     DWORD _dwCookieKey;
 
     ITfComposition *_pComposition;
-    std::wstring _sComposition; // Current internal buffer (e.g. "nihao")
-    int _selectedCandidateIndex; // Current selected candidate index for up/down navigation
+    CUpdateCompositionEditSession *_pPendingUpdate; // Queued update session, reused by later keys
+    int _coalescedUpdates;      // Keys folded into _pPendingUpdate
+    QueryCursor _queryCursor;   // Where the composition's candidate query stopped
+    CCompositionEngine _composer; // Pinyin buffer, candidate pages and selection
     
     // UI
     CCandidateWindow *_pCandidateWindow;
-    std::vector<std::wstring> _candidateList;
-    
-    // Cached position for up/down key navigation
-    int _lastCandidateX;
-    int _lastCandidateY;
+    CCaretLocator _caretLocator;    // Remembers the working caret strategy per window
+    unsigned _caretLocates;
 };
@@ -0,0 +1,47 @@
+#pragma once
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Typo-tolerant key search: finds pinyin keys within a small weighted edit
+// distance of what was typed ("nihap" -> "nihao"). Platform neutral.
+//
+// Costs are in integer units so neighbouring-key slips are cheaper than
+// arbitrary ones:
+//   substitution by a QWERTY neighbour   1
+//   swap of two adjacent letters         2
+//   missing or extra letter              2
+//   any other substitution               3
+
+struct TypoSearchLimits
+{
+    int maxCost;            // Largest total edit cost accepted
+    size_t workBudget;      // Maximum DP rows evaluated per search
+    size_t maxResults;      // Keys returned, best first
+};
+
+struct TypoCandidate
+{
+    std::pmr::string key;
+    int cost;
+    bool complete;          // Ends on a full syllable rather than a prefix
+    int syllables;          // Fewest syllables the key splits into
+};
+
+struct TypoSearchResult
+{
+    size_t work;            // DP rows evaluated
+    bool exhausted;         // Stopped by workBudget; results may be incomplete
+};
+
+// Cost of typing `typed` where `intended` was meant (0 if equal).
+int TypoSubstitutionCost(char intended, char typed);
+
+// Search the language of syllable sequences for keys within limits.maxCost
+// of `key`, ordered by cost, then complete before partial, then fewer
+// syllables (longer, more plausible words). The key itself is
+// never returned. Candidates may end in a partial syllable, since the user
+// may still be typing. The keys and the search's tables come from `out`'s
+// memory resource.
+TypoSearchResult FindTypoCorrections(const char* key, size_t len, const TypoSearchLimits& limits,
+                                     std::pmr::vector<TypoCandidate>& out);
@@ -0,0 +1,129 @@
+#pragma once
+#include <windows.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "sqlite/sqlite3.h"
+#include "CandidateMerge.h"
+#include "LearningJournal.h"
+#include "MixedPinyin.h"
+
+// Per-user learning data in user.db: selection counts for (pinyin key,
+// candidate) pairs, the user overlay of learned words and phrases that is
+// merged with the read-only system lexicon at query time, and the words
+// the user commits after each word, for next-word prediction.
+//
+// Updates only touch memory and the journal's queue; a background writer
+// thread makes them durable in the journal (user.journal) within moments,
+// and folds them into user.db in batched transactions. The journal is
+// replayed on Open and emptied once user.db holds everything in it, so
+// learning survives a crash of the host without disk I/O on the key path.
+class CUserHistory
+{
+public:
+    CUserHistory();
+    ~CUserHistory();
+
+    // Open (or create) the history database, load it into memory and
+    // replay the journal.
+    bool Open(const std::wstring& path);
+
+    // Count one selection of `hanzi` for `key`. Called on the UI thread.
+    void Record(const std::string& key, const std::wstring& hanzi);
+
+    // Selection count under `key` (0 if never chosen) for each candidate
+    // from `first` on, into counts[0...].
+    void GetCounts(const std::string& key, const CCandidateList& candidates, size_t first, std::pmr::vector<int>& counts) const;
+
+    // Add a word to the user overlay, or raise its priority if present.
+    // `key` is the full pinyin ("shurufa"), `initials` its syllable
+    // initials ("srf").
+    void AddWord(const std::string& key, const std::string& initials, const std::wstring& hanzi, int priority);
+
+    // Overlay words whose pinyin, or with `initials` whose syllable
+    // initials, start with `prefix`, appended to `stream` (unsorted) and
+    // ranked by the length of the key matched.
+    void FindWords(const std::string& prefix, bool initials, RankedStream& stream) const;
+
+    // Overlay words that match one of `readings` of the mixed key `key`,
+    // appended to `stream` (unsorted) and ranked by syllable count.
+    void FindMixedWords(const std::string& key, const MixedReading* readings, size_t count, RankedStream& stream) const;
+
+    size_t WordCount() const;
+
+    // Count one commit of `next` straight after `word`. Called on the UI
+    // thread.
+    void RecordSuccessor(const std::wstring& word, const std::wstring& next);
+
+    // Words committed after `word`, most often first, appended to `results`
+    // until it holds `max`.
+    void GetSuccessors(const std::wstring& word, CCandidateList& results, size_t max) const;
+
+    // Write everything pending and stop the writer thread. The thread is
+    // restarted by the next update. Call before the DLL unloads: the
+    // destructor never waits for the thread.
+    void Flush();
+
+private:
+    struct Entry
+    {
+        int count;
+        long long lastUsed;
+    };
+
+    struct UserWord
+    {
+        std::string key;
+        std::string initials;
+        std::wstring hanzi;
+        int priority;
+        long long created;
+    };
+
+    struct Successor
+    {
+        std::wstring next;
+        int count;
+        long long lastUsed;
+    };
+
+    struct SuccessorUpdate
+    {
+        std::wstring word;
+        Successor successor;
+    };
+
+    static std::wstring _MakeId(const std::string& key, const std::wstring& hanzi);
+    bool _MergeWord(const UserWord& word);
+    void _IndexInitials();
+    bool _MergeSuccessor(const std::wstring& word, const Successor& successor);
+    void _Replay(const char* payload, size_t len);
+    void _CommitJournal(std::unique_lock<std::mutex>& guard);
+    void _CompactJournal(std::unique_lock<std::mutex>& guard);
+
+    void _StartWriter();
+    void _WriterLoop();
+    bool _WriteBatch(const std::vector<std::pair<std::wstring, Entry>>& batch, const std::vector<UserWord>& words,
+                     const std::vector<SuccessorUpdate>& successors);
+
+    sqlite3* _db;
+    CLearningJournal _journal;
+
+    mutable std::mutex _lock;                       // Guards everything below
+    std::condition_variable _wake;
+    std::unordered_map<std::wstring, Entry> _entries;   // "key\thanzi" -> entry
+    mutable std::wstring _lookupId;                     // GetCounts scratch, so lookups reuse one buffer
+    std::unordered_set<std::wstring> _dirty;            // Entries not yet persisted
+    std::vector<UserWord> _words;                       // Overlay, sorted by key
+    std::vector<uint32_t> _byInitials;                  // Positions in _words, sorted by initials
+    std::vector<UserWord> _pendingWords;                // Overlay changes not yet persisted
+    std::unordered_map<std::wstring, std::vector<Successor>> _successors;   // Word -> next words, most used first
+    std::vector<SuccessorUpdate> _pendingSuccessors;    // Successor changes not yet persisted
+    bool _journalPending;                               // Journal records queued since the last commit
+    std::thread _writer;
+    bool _stopping;
+};
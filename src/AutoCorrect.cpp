@@ -0,0 +1,347 @@
+#include "AutoCorrect.h"
+#include "PinyinSyllables.h"
+#include <cstring>
+#include <queue>
+#include <sstream>
+
+const std::vector<CorrectionRule>& GetDefaultCorrectionRules()
+{
+    // pattern, replacement, atSyllableStart, atSyllableEnd, initials
+    static const std::vector<CorrectionRule> rules = {
+        {"ign", "ing", false, false, {}},
+        {"img", "ing", false, false, {}},
+        {"uen", "un", false, false, {}},
+        {"iou", "iu", false, false, {}},
+        {"uei", "ui", false, false, {}},
+        // ü is only spelled u after j/q/x/y; lv and nv are real syllables
+        {"v", "u", false, false, {"j", "q", "x", "y"}},
+    };
+    return rules;
+}
+
+// ---------------------------------------------------------
+// Rules file
+// ---------------------------------------------------------
+
+static bool IsLetters(const std::string& s)
+{
+    if (s.empty()) return false;
+    for (char c : s)
+    {
+        if (c < 'a' || c > 'z') return false;
+    }
+    return true;
+}
+
+bool LoadCorrectionRules(std::istream& in, std::vector<CorrectionRule>& rules, std::string* error)
+{
+    std::vector<CorrectionRule> parsed;
+    std::string line;
+    int lineNumber = 0;
+
+    auto fail = [&](const std::string& message) {
+        if (error) *error = "line " + std::to_string(lineNumber) + ": " + message;
+        return false;
+    };
+
+    while (std::getline(in, line))
+    {
+        lineNumber++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+
+        std::istringstream tokens(line);
+        CorrectionRule rule;
+        if (!(tokens >> rule.pattern)) continue;    // Blank or comment-only line
+        if (!(tokens >> rule.replacement)) return fail("missing replacement");
+        if (!IsLetters(rule.pattern) || !IsLetters(rule.replacement))
+            return fail("pattern and replacement must be lowercase letters");
+
+        std::string option;
+        while (tokens >> option)
+        {
+            if (option == "@start")
+            {
+                rule.atSyllableStart = true;
+            }
+            else if (option == "@end")
+            {
+                rule.atSyllableEnd = true;
+            }
+            else if (option.compare(0, 9, "@initial=") == 0)
+            {
+                std::istringstream list(option.substr(9));
+                std::string initial;
+                while (std::getline(list, initial, ','))
+                {
+                    if (!IsLetters(initial) || PinyinInitialLength(initial.data(), initial.length()) != initial.length())
+                        return fail("'" + initial + "' is not a pinyin initial");
+                    rule.initials.push_back(initial);
+                }
+                if (rule.initials.empty()) return fail("empty @initial list");
+            }
+            else
+            {
+                return fail("unknown option '" + option + "'");
+            }
+        }
+        parsed.push_back(rule);
+    }
+
+    rules.swap(parsed);
+    return true;
+}
+
+// ---------------------------------------------------------
+// CCorrectionAutomaton
+// ---------------------------------------------------------
+
+CCorrectionAutomaton::CCorrectionAutomaton()
+{
+    Build(std::vector<CorrectionRule>());
+}
+
+void CCorrectionAutomaton::Build(const std::vector<CorrectionRule>& rules)
+{
+    _rules = rules;
+
+    // 1. Trie of all patterns. 0 in _next means "no edge yet" while building;
+    //    the root is state 0 and can never be a transition target. Rules
+    //    sharing a pattern are chained in file order.
+    std::vector<int> depth(1, 0);
+    std::vector<int> lastRule(1, -1);
+    _next.assign(kAlphabet, 0);
+    _stateRule.assign(1, -1);
+    _ruleNext.assign(_rules.size(), -1);
+
+    for (size_t r = 0; r < _rules.size(); ++r)
+    {
+        const CorrectionRule& rule = _rules[r];
+        if (rule.pattern.empty()) continue;
+
+        size_t state = 0;
+        for (char c : rule.pattern)
+        {
+            size_t slot = state * kAlphabet + _Symbol(c);
+            if (_next[slot] == 0)
+            {
+                if (_stateRule.size() >= 0xFFFF) break;    // State ids are 16-bit
+                _next[slot] = (unsigned short)_stateRule.size();
+                _next.resize(_next.size() + kAlphabet, 0);
+                _stateRule.push_back(-1);
+                lastRule.push_back(-1);
+                depth.push_back(depth[state] + 1);
+            }
+            state = _next[slot];
+        }
+        if (depth[state] != (int)rule.pattern.length()) continue;
+
+        if (_stateRule[state] < 0) _stateRule[state] = (int)r;
+        else _ruleNext[lastRule[state]] = (int)r;
+        lastRule[state] = (int)r;
+    }
+
+    // 2. Breadth-first pass: failure links turn the trie into a full DFA.
+    //    Dictionary links chain each state to the pattern-ending suffixes
+    //    below it, so a rule whose conditions fail falls back to shorter ones.
+    size_t stateCount = _stateRule.size();
+    std::vector<unsigned short> fail(stateCount, 0);
+    _match.assign(stateCount, 0);
+    _dictLink.assign(stateCount, 0);
+
+    std::queue<size_t> pending;
+    for (int sym = 0; sym < kAlphabet; ++sym)
+    {
+        if (_next[sym] != 0) pending.push(_next[sym]);
+    }
+
+    while (!pending.empty())
+    {
+        size_t state = pending.front();
+        pending.pop();
+
+        unsigned short f = fail[state];
+        _dictLink[state] = _stateRule[f] >= 0 ? f : _dictLink[f];
+        _match[state] = _stateRule[state] >= 0 ? (unsigned short)state : _dictLink[state];
+
+        for (int sym = 0; sym < kAlphabet; ++sym)
+        {
+            size_t slot = state * kAlphabet + sym;
+            unsigned short fallback = _next[f * kAlphabet + sym];
+            if (_next[slot] != 0)
+            {
+                fail[_next[slot]] = fallback;
+                pending.push(_next[slot]);
+            }
+            else
+            {
+                _next[slot] = fallback;
+            }
+        }
+    }
+}
+
+bool CCorrectionAutomaton::_ConditionsHold(const CorrectionRule& rule, const char* in, size_t start, size_t end,
+                                           const unsigned char* starts) const
+{
+    if (!rule.atSyllableStart && !rule.atSyllableEnd && rule.initials.empty()) return true;
+    if (!starts) return false;
+
+    if (rule.atSyllableStart && !starts[start]) return false;
+    if (rule.atSyllableEnd && !starts[end]) return false;
+
+    if (!rule.initials.empty())
+    {
+        for (const std::string& initial : rule.initials)
+        {
+            size_t n = initial.length();
+            if (n <= start && starts[start - n] && initial.compare(0, n, in + start - n, n) == 0) return true;
+        }
+        return false;
+    }
+    return true;
+}
+
+size_t CCorrectionAutomaton::Apply(const char* in, size_t len, char* out, size_t capacity, bool* truncated) const
+{
+    size_t written = 0;
+    size_t emitted = 0;     // Input consumed into the output so far
+    size_t state = 0;
+    *truncated = false;
+
+    // Syllable boundaries of the original key, computed the first time a
+    // conditional rule is a candidate
+    unsigned char startsBuffer[kMaxContext + 1];
+    const unsigned char* starts = nullptr;
+    bool segmented = false;
+
+    auto append = [&](const char* s, size_t n) {
+        if (written + n > capacity)
+        {
+            n = capacity - written;
+            *truncated = true;
+        }
+        for (size_t k = 0; k < n; ++k) out[written + k] = s[k];
+        written += n;
+    };
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        state = _next[state * kAlphabet + _Symbol(in[i])];
+
+        // Walk pattern-ending suffixes from longest to shortest. Matching
+        // restarts at the root after every replacement, so every candidate
+        // starts at or after `emitted`.
+        const CorrectionRule* hit = nullptr;
+        for (size_t s = _match[state]; s != 0 && !hit; s = _dictLink[s])
+        {
+            for (int r = _stateRule[s]; r >= 0; r = _ruleNext[r])
+            {
+                const CorrectionRule& rule = _rules[r];
+                if (!segmented && (rule.atSyllableStart || rule.atSyllableEnd || !rule.initials.empty()))
+                {
+                    segmented = true;
+                    if (len <= kMaxContext)
+                    {
+                        MarkSyllableStarts(in, len, startsBuffer);
+                        starts = startsBuffer;
+                    }
+                }
+                if (_ConditionsHold(rule, in, i + 1 - rule.pattern.length(), i + 1, starts))
+                {
+                    hit = &rule;
+                    break;
+                }
+            }
+        }
+        if (!hit) continue;
+
+        size_t start = i + 1 - hit->pattern.length();
+        append(in + emitted, start - emitted);
+        append(hit->replacement.data(), hit->replacement.length());
+        emitted = i + 1;
+        state = 0;
+    }
+    append(in + emitted, len - emitted);
+    return written;
+}
+
+std::string CCorrectionAutomaton::Apply(const std::string& input) const
+{
+    size_t capacity = input.length();
+    for (const CorrectionRule& rule : _rules)
+    {
+        if (rule.replacement.length() > rule.pattern.length())
+            capacity += (rule.replacement.length() - rule.pattern.length()) * input.length();
+    }
+
+    std::string result(capacity, '\0');
+    bool truncated;
+    result.resize(Apply(input.data(), input.length(), &result[0], result.length(), &truncated));
+    return result;
+}
+
+const CCorrectionAutomaton& GetDefaultCorrector()
+{
+    static const CCorrectionAutomaton automaton = []() {
+        CCorrectionAutomaton a;
+        a.Build(GetDefaultCorrectionRules());
+        return a;
+    }();
+    return automaton;
+}
+
+// ---------------------------------------------------------
+// Fuzzy expansion
+// ---------------------------------------------------------
+
+// The next slot of `variants`, emptied; grows the vector only when needed.
+static std::string& NextVariant(std::vector<std::string>& variants, size_t& count)
+{
+    if (count == variants.size()) variants.emplace_back();
+    std::string& variant = variants[count++];
+    variant.clear();
+    return variant;
+}
+
+// `key` with its first `from` characters replaced by `to`.
+static void AddInitialVariant(const std::string& key, size_t from, const char* to,
+                              std::vector<std::string>& variants, size_t& count)
+{
+    std::string& variant = NextVariant(variants, count);
+    variant.append(to);
+    variant.append(key, from, std::string::npos);
+}
+
+static bool StartsWith(const std::string& key, const char* prefix)
+{
+    return key.compare(0, strlen(prefix), prefix) == 0;
+}
+
+size_t GetFuzzyVariants(const std::string& key, std::vector<std::string>& variants)
+{
+    size_t count = 0;
+    NextVariant(variants, count).assign(key);
+
+    // Initials; a key starts with at most one of these
+    if (StartsWith(key, "zh")) AddInitialVariant(key, 2, "z", variants, count);
+    else if (StartsWith(key, "z")) AddInitialVariant(key, 1, "zh", variants, count);
+    else if (StartsWith(key, "ch")) AddInitialVariant(key, 2, "c", variants, count);
+    else if (StartsWith(key, "c")) AddInitialVariant(key, 1, "ch", variants, count);
+    else if (StartsWith(key, "sh")) AddInitialVariant(key, 2, "s", variants, count);
+    else if (StartsWith(key, "s")) AddInitialVariant(key, 1, "sh", variants, count);
+    else if (StartsWith(key, "n")) AddInitialVariant(key, 1, "l", variants, count);
+    else if (StartsWith(key, "l")) AddInitialVariant(key, 1, "n", variants, count);
+
+    // Final ing <-> in
+    size_t len = key.length();
+    if (len > 3 && key.compare(len - 3, 3, "ing") == 0)
+    {
+        NextVariant(variants, count).assign(key, 0, len - 1);
+    }
+    else if (len > 2 && key.compare(len - 2, 2, "in") == 0)
+    {
+        NextVariant(variants, count).assign(key).push_back('g');
+    }
+    return count;
+}
@@ -0,0 +1,142 @@
+#include "CandidateLayout.h"
+#include <algorithm>
+#include <deque>
+
+// ---------------------------------------------------------
+// CTextExtentCache
+// ---------------------------------------------------------
+
+CTextExtentCache::CTextExtentCache(size_t capacity)
+    : _capacity(capacity), _hits(0), _misses(0)
+{
+}
+
+// FNV-1a over the font and the characters
+static uint64_t HashExtent(uint32_t font, const wchar_t* text, size_t length)
+{
+    uint64_t hash = 14695981039346656037ull ^ font;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (uint64_t)text[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+int CTextExtentCache::Width(uint32_t font, const wchar_t* text, size_t length, const TextMeasure& measure)
+{
+    uint64_t hash = HashExtent(font, text, length);
+    auto found = _widths.find(hash);
+    if (found != _widths.end() && found->second.font == font &&
+        found->second.text.compare(0, std::wstring::npos, text, length) == 0)
+    {
+        _hits++;
+        return found->second.width;
+    }
+
+    _misses++;
+    int width = measure(text, length);
+    if (found != _widths.end())
+    {
+        // Same hash, other string: the newer one takes the slot
+        found->second.font = font;
+        found->second.text.assign(text, length);
+        found->second.width = width;
+        return width;
+    }
+
+    if (_widths.size() >= _capacity) _widths.clear();
+    Entry entry = { font, std::wstring(text, length), width };
+    _widths.emplace(hash, std::move(entry));
+    return width;
+}
+
+void CTextExtentCache::Clear()
+{
+    _widths.clear();
+}
+
+// ---------------------------------------------------------
+// Layout
+// ---------------------------------------------------------
+
+void LayoutCandidates(const CandidateLayoutMetrics& metrics, const std::vector<int>& labelWidths,
+                      const std::vector<int>& textWidths, CandidateLayout& layout)
+{
+    const size_t count = textWidths.size();
+    const int pad = metrics.padding;
+    layout.orientation = metrics.orientation;
+    layout.cells.resize(count);
+
+    if (metrics.orientation == LAYOUT_HORIZONTAL)
+    {
+        // Cells side by side, each sized to its own text
+        int x = pad;
+        for (size_t i = 0; i < count; ++i)
+        {
+            int labelWidth = i < labelWidths.size() ? labelWidths[i] : 0;
+            CandidateCell& cell = layout.cells[i];
+            cell.rect.left = x;
+            cell.rect.right = x + labelWidth + textWidths[i] + pad * 2;
+            cell.rect.top = pad;
+            cell.rect.bottom = pad + metrics.lineHeight;
+            cell.labelX = x + pad;
+            cell.textX = cell.labelX + labelWidth;
+            cell.textY = pad + 2;
+            x = cell.rect.right;
+        }
+        layout.width = x + pad > metrics.minWidth ? x + pad : metrics.minWidth;
+        layout.height = pad * 2 + metrics.lineHeight;
+        return;
+    }
+
+    layout.width = metrics.minWidth;
+    layout.height = pad * 2 + (int)count * metrics.lineHeight;
+
+    int y = pad;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int labelWidth = i < labelWidths.size() ? labelWidths[i] : 0;
+        int lineWidth = labelWidth + textWidths[i] + pad * 4;
+        if (lineWidth > layout.width) layout.width = lineWidth;
+
+        CandidateCell& cell = layout.cells[i];
+        cell.labelX = pad * 2;
+        cell.textX = cell.labelX + labelWidth;
+        cell.textY = y + 2;
+        cell.rect.top = y;
+        cell.rect.bottom = y + metrics.lineHeight;
+        y += metrics.lineHeight;
+    }
+
+    // Highlights span the final width
+    for (CandidateCell& cell : layout.cells)
+    {
+        cell.rect.left = pad;
+        cell.rect.right = layout.width - pad;
+    }
+}
+
+int HitTestCandidates(const CandidateLayout& layout, int x, int y)
+{
+    // Last cell starting at or before the point along the layout's axis
+    const bool horizontal = layout.orientation == LAYOUT_HORIZONTAL;
+    const int along = horizontal ? x : y;
+    auto next = std::upper_bound(layout.cells.begin(), layout.cells.end(), along,
+        [horizontal](int value, const CandidateCell& cell) {
+            return value < (horizontal ? cell.rect.left : cell.rect.top);
+        });
+    if (next == layout.cells.begin()) return -1;
+
+    const CandidateCell& cell = *(next - 1);
+    if (x < cell.rect.left || x >= cell.rect.right || y < cell.rect.top || y >= cell.rect.bottom) return -1;
+    return (int)(next - 1 - layout.cells.begin());
+}
+
+const std::wstring& CandidateLabel(size_t index)
+{
+    // A deque keeps earlier references valid as it grows
+    static std::deque<std::wstring> labels;
+    while (labels.size() <= index) labels.push_back(std::to_wstring(labels.size() + 1) + L". ");
+    return labels[index];
+}
@@ -0,0 +1,106 @@
+#include "CandidateList.h"
+#include <algorithm>
+#include <cstring>
+
+// The index starts at this many slots and doubles at half full
+static const size_t kInitialSlots = 64;
+
+CCandidateList::CCandidateList()
+{
+}
+
+void CCandidateList::Clear()
+{
+    _words.clear();
+    std::fill(_slots.begin(), _slots.end(), 0);
+}
+
+bool CCandidateList::Add(uint32_t word)
+{
+    if (Contains(word)) return false;
+    _words.push_back(word);
+
+    if ((_words.size() + 1) * 2 > _slots.size())
+    {
+        _Reindex(_slots.empty() ? kInitialSlots : _slots.size() * 2);
+    }
+    else
+    {
+        _Index(word);
+    }
+    return true;
+}
+
+bool CCandidateList::Contains(uint32_t word) const
+{
+    if (_slots.empty()) return false;
+    return _slots[_Probe(word)] != 0;
+}
+
+void CCandidateList::AssignRange(const CCandidateList& other, size_t first, size_t count)
+{
+    Clear();
+    if (first >= other.Size()) return;
+    if (count > other.Size() - first) count = other.Size() - first;
+    _words.assign(other._words.begin() + first, other._words.begin() + first + count);
+
+    // The range is duplicate free already; only the set needs filling
+    if ((_words.size() + 1) * 2 > _slots.size())
+    {
+        size_t slots = _slots.empty() ? kInitialSlots : _slots.size();
+        while ((_words.size() + 1) * 2 > slots) slots *= 2;
+        _Reindex(slots);
+    }
+    else
+    {
+        for (uint32_t word : _words) _Index(word);
+    }
+}
+
+bool CCandidateList::EqualsRange(const CCandidateList& other, size_t first, size_t count) const
+{
+    if (first + count > other.Size() || count != Size()) return false;
+    return count == 0 || memcmp(_words.data(), other._words.data() + first, count * sizeof(uint32_t)) == 0;
+}
+
+void CCandidateList::Permute(size_t first, const uint32_t* order, size_t count)
+{
+    // The set of ids is unchanged, so the index stays as it is
+    _scratch.assign(_words.begin() + first, _words.end());
+    for (size_t i = 0; i < count && first + i < _words.size(); ++i)
+    {
+        _words[first + i] = _scratch[order[i] - first];
+    }
+}
+
+// Ids are dense from 0; multiplying by an odd constant spreads neighbours
+// across the table
+static size_t HashWord(uint32_t word)
+{
+    return (size_t)(word * 2654435761u);
+}
+
+// The slot holding `word`, or the empty slot where it would go.
+size_t CCandidateList::_Probe(uint32_t word) const
+{
+    const size_t mask = _slots.size() - 1;
+    for (size_t slot = HashWord(word) & mask;; slot = (slot + 1) & mask)
+    {
+        uint32_t entry = _slots[slot];
+        if (entry == 0 || entry == word + 1) return slot;
+    }
+}
+
+void CCandidateList::_Index(uint32_t word)
+{
+    const size_t mask = _slots.size() - 1;
+    size_t slot = HashWord(word) & mask;
+    while (_slots[slot] != 0) slot = (slot + 1) & mask;
+    _slots[slot] = word + 1;
+}
+
+void CCandidateList::_Reindex(size_t slots)
+{
+    _slots.assign(slots, 0);
+    for (uint32_t word : _words) _Index(word);
+}
@@ -0,0 +1,40 @@
+#include "CandidateMerge.h"
+#include <algorithm>
+
+void RankedStream::Add(const wchar_t* text, size_t length, int keyLength, int priority)
+{
+    RankedCandidate candidate = { CCandidatePool::Instance().Intern(text, length), (uint32_t)ranks.size(), keyLength, priority };
+    ranks.push_back(candidate);
+}
+
+void SortRankedStream(RankedStream& stream)
+{
+    // Breaking ties on source order sorts stably without the buffer
+    // std::stable_sort allocates
+    std::sort(stream.ranks.begin(), stream.ranks.end(), [](const RankedCandidate& a, const RankedCandidate& b) {
+        if (RanksBefore(a, b)) return true;
+        if (RanksBefore(b, a)) return false;
+        return a.order < b.order;
+    });
+}
+
+size_t MergeRankedStreams(RankedRange* ranges, size_t count, size_t limit, CCandidateList& out)
+{
+    size_t added = 0;
+    while (added < limit)
+    {
+        // Best head; strict comparison keeps the earliest range on ties
+        RankedRange* best = NULL;
+        for (size_t r = 0; r < count; ++r)
+        {
+            RankedRange& range = ranges[r];
+            if (range.begin >= range.end) continue;
+            if (!best || RanksBefore(range.stream->ranks[range.begin], best->stream->ranks[best->begin])) best = &range;
+        }
+        if (!best) break;
+
+        const RankedCandidate& candidate = best->stream->ranks[best->begin++];
+        if (out.Add(candidate.word)) added++;
+    }
+    return added;
+}
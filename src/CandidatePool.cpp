@@ -0,0 +1,102 @@
+#include "CandidatePool.h"
+#include <cstring>
+
+// The index starts at this many slots and doubles at half full
+static const size_t kInitialSlots = 4096;
+
+CCandidatePool& CCandidatePool::Instance()
+{
+    static CCandidatePool instance;
+    return instance;
+}
+
+CCandidatePool::CCandidatePool() : _blockUsed(0)
+{
+}
+
+uint32_t CCandidatePool::Intern(const wchar_t* text, size_t length)
+{
+    uint32_t hash = _Hash(text, length);
+    if (!_slots.empty())
+    {
+        uint32_t entry = _slots[_Probe(text, length, hash)];
+        if (entry != 0) return entry - 1;
+    }
+
+    Word word = { _Store(text, length), (uint32_t)length };
+    _words.push_back(word);
+
+    uint32_t id = (uint32_t)(_words.size() - 1);
+    if ((_words.size() + 1) * 2 > _slots.size())
+    {
+        _Reindex(_slots.empty() ? kInitialSlots : _slots.size() * 2);
+    }
+    else
+    {
+        _Index(id);
+    }
+    return id;
+}
+
+// Copy `text` into the blocks. A word longer than a block gets a block of
+// its own.
+const wchar_t* CCandidatePool::_Store(const wchar_t* text, size_t length)
+{
+    if (length > kBlockLength)
+    {
+        // The partly filled block is left as it is; the next word starts a new one
+        _blocks.emplace_back(new wchar_t[length]);
+        _blockUsed = kBlockLength;
+        memcpy(_blocks.back().get(), text, length * sizeof(wchar_t));
+        return _blocks.back().get();
+    }
+
+    if (_blocks.empty() || _blockUsed + length > kBlockLength)
+    {
+        _blocks.emplace_back(new wchar_t[kBlockLength]);
+        _blockUsed = 0;
+    }
+    wchar_t* stored = _blocks.back().get() + _blockUsed;
+    memcpy(stored, text, length * sizeof(wchar_t));
+    _blockUsed += length;
+    return stored;
+}
+
+// FNV-1a over the UTF-16/32 code units
+uint32_t CCandidatePool::_Hash(const wchar_t* text, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (uint32_t)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// The slot holding `text`, or the empty slot where it would go.
+size_t CCandidatePool::_Probe(const wchar_t* text, size_t length, uint32_t hash) const
+{
+    const size_t mask = _slots.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        uint32_t entry = _slots[slot];
+        if (entry == 0) return slot;
+        const Word& word = _words[entry - 1];
+        if (word.length == length && memcmp(word.text, text, length * sizeof(wchar_t)) == 0) return slot;
+    }
+}
+
+void CCandidatePool::_Index(uint32_t id)
+{
+    const size_t mask = _slots.size() - 1;
+    size_t slot = _Hash(_words[id].text, _words[id].length) & mask;
+    while (_slots[slot] != 0) slot = (slot + 1) & mask;
+    _slots[slot] = id + 1;
+}
+
+void CCandidatePool::_Reindex(size_t slots)
+{
+    _slots.assign(slots, 0);
+    for (uint32_t id = 0; id < (uint32_t)_words.size(); ++id) _Index(id);
+}
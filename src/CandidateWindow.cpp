@@ -5,8 +5,16 @@
 
 #define CANDIDATE_WINDOW_CLASS L"UTIME_CandidateWindow"
 
-CCandidateWindow::CCandidateWindow() : _hwnd(NULL), _selectedIndex(0), _hFont(NULL), _pTextService(NULL), _pContext(NULL), _clickedIndex(-1)
+// The window draws in a single font
+static const uint32_t kCandidateFont = 0;
+
+CCandidateWindow::CCandidateWindow() : _hwnd(NULL), _selectedIndex(0), _hFont(NULL), _hBrushBg(NULL), _hBrushSel(NULL),
+    _hdcBack(NULL), _hbmBack(NULL), _hbmOld(NULL), _hFontOld(NULL), _backWidth(0), _backHeight(0),
+    _extents(Config::CandidateWindow::EXTENT_CACHE_SIZE), _pTextService(NULL), _pContext(NULL), _clickedIndex(-1)
 {
+    _layout.orientation = LAYOUT_VERTICAL;
+    _layout.width = 0;
+    _layout.height = 0;
 }
 
 CCandidateWindow::~CCandidateWindow()
@@ -24,7 +32,7 @@ bool CCandidateWindow::Initialize(HINSTANCE hInstance)
     wc.cbWndExtra = 0;
     wc.hInstance = hInstance;
     wc.hCursor = LoadCursor(NULL, IDC_ARROW);
-    wc.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1);
+    wc.hbrBackground = NULL;    // _OnPaint fills every pixel it draws
     wc.lpszMenuName = NULL;
     wc.lpszClassName = CANDIDATE_WINDOW_CLASS;
 
@@ -34,6 +42,8 @@ bool CCandidateWindow::Initialize(HINSTANCE hInstance)
         24, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
         DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
         CLEARTYPE_QUALITY, DEFAULT_PITCH | FF_SWISS, L"Microsoft YaHei UI");
+    _hBrushBg = CreateSolidBrush(RGB(255, 255, 255));
+    _hBrushSel = CreateSolidBrush(RGB(230, 240, 255)); // Light blue
 
     // Create the window but don't show it yet
     // WS_POPUP: No border
@@ -63,45 +73,114 @@ void CCandidateWindow::Destroy()
         DestroyWindow(_hwnd);
         _hwnd = NULL;
     }
+    _ReleaseBackBuffer();
     if (_hFont)
     {
         DeleteObject(_hFont);
         _hFont = NULL;
     }
+    if (_hBrushBg)
+    {
+        DeleteObject(_hBrushBg);
+        _hBrushBg = NULL;
+    }
+    if (_hBrushSel)
+    {
+        DeleteObject(_hBrushSel);
+        _hBrushSel = NULL;
+    }
+    _extents.Clear();
     UnregisterClass(CANDIDATE_WINDOW_CLASS, GetModuleHandle(NULL));
 }
 
-void CCandidateWindow::Show(int x, int y, const std::vector<std::wstring>& candidates, int selectedIndex)
+void CCandidateWindow::Show(int x, int y, const CCandidateList& candidates, size_t first, size_t count, int selectedIndex)
+{
+    if (!_hwnd) return;
+
+    // Same list: only the selection can have moved
+    if (_candidates.EqualsRange(candidates, first, count) && _layout.cells.size() == count && IsVisible())
+    {
+        SetSelection(selectedIndex);
+        SetWindowPos(_hwnd, HWND_TOPMOST, x, y + Config::CandidateWindow::Y_OFFSET, 0, 0, SWP_NOACTIVATE | SWP_NOSIZE);
+        return;
+    }
+
+    _candidates.AssignRange(candidates, first, count);
+    _Layout();
+    _selectedIndex = selectedIndex;
+
+    // Position and resize
+    SetWindowPos(_hwnd, HWND_TOPMOST, x, y + Config::CandidateWindow::Y_OFFSET, _layout.width, _layout.height, SWP_NOACTIVATE | SWP_SHOWWINDOW);
+    
+    // Trigger repaint; no erase, the paint covers the whole window
+    InvalidateRect(_hwnd, NULL, FALSE);
+}
+
+void CCandidateWindow::SetCandidates(const CCandidateList& candidates, size_t first, size_t count, int selectedIndex)
 {
     if (!_hwnd) return;
 
-    _candidates = candidates;
+    _candidates.AssignRange(candidates, first, count);
+    _Layout();
+    _selectedIndex = selectedIndex;
+
+    // Resize in place; the caret has not moved
+    SetWindowPos(_hwnd, NULL, 0, 0, _layout.width, _layout.height, SWP_NOACTIVATE | SWP_NOMOVE | SWP_NOZORDER);
+    InvalidateRect(_hwnd, NULL, FALSE);
+}
+
+void CCandidateWindow::SetSelection(int selectedIndex)
+{
+    if (!_hwnd || selectedIndex == _selectedIndex) return;
+    _InvalidateCell(_selectedIndex);
     _selectedIndex = selectedIndex;
+    _InvalidateCell(_selectedIndex);
+}
 
-    // Calculate window size based on content
-    HDC hdc = GetDC(_hwnd);
-    HFONT hOldFont = (HFONT)SelectObject(hdc, _hFont);
+void CCandidateWindow::_InvalidateCell(int index)
+{
+    if (index < 0 || index >= (int)_layout.cells.size()) return;
+    const LayoutRect& cell = _layout.cells[index].rect;
+    RECT rc = { cell.left, cell.top, cell.right, cell.bottom };
+    InvalidateRect(_hwnd, &rc, FALSE);
+}
 
-    int maxWidth = Config::CandidateWindow::MIN_WIDTH;
-    int totalHeight = Config::CandidateWindow::PADDING * 2;
+// Measure the candidates through the extent cache and lay them out. The DC
+// is only fetched if something is not in the cache.
+void CCandidateWindow::_Layout()
+{
+    HDC hdc = NULL;
+    HFONT hOldFont = NULL;
+    TextMeasure measure = [&](const wchar_t* text, size_t len) {
+        if (!hdc)
+        {
+            hdc = GetDC(_hwnd);
+            hOldFont = (HFONT)SelectObject(hdc, _hFont);
+        }
+        SIZE sz = {0, 0};
+        GetTextExtentPoint32(hdc, text, (int)len, &sz);
+        return (int)sz.cx;
+    };
 
-    for (size_t i = 0; i < _candidates.size(); ++i)
+    _labelWidths.clear();
+    _textWidths.clear();
+    for (size_t i = 0; i < _candidates.Size(); ++i)
     {
-        std::wstring line = std::to_wstring(i + 1) + L". " + _candidates[i];
-        SIZE sz;
-        GetTextExtentPoint32(hdc, line.c_str(), (int)line.length(), &sz);
-        if (sz.cx + Config::CandidateWindow::PADDING * 4 > maxWidth) maxWidth = sz.cx + Config::CandidateWindow::PADDING * 4;
-        totalHeight += Config::CandidateWindow::LINE_HEIGHT;
+        _labelWidths.push_back(_extents.Width(kCandidateFont, CandidateLabel(i), measure));
+        _textWidths.push_back(_extents.Width(kCandidateFont, _candidates.Text(i), _candidates.Length(i), measure));
     }
-    
-    SelectObject(hdc, hOldFont);
-    ReleaseDC(_hwnd, hdc);
 
-    // Position and resize
-    SetWindowPos(_hwnd, HWND_TOPMOST, x, y + Config::CandidateWindow::Y_OFFSET, maxWidth, totalHeight, SWP_NOACTIVATE | SWP_SHOWWINDOW);
-    
-    // Trigger repaint
-    InvalidateRect(_hwnd, NULL, TRUE);
+    if (hdc)
+    {
+        SelectObject(hdc, hOldFont);
+        ReleaseDC(_hwnd, hdc);
+    }
+
+    CandidateLayoutMetrics metrics = {
+        Config::CandidateWindow::HORIZONTAL ? LAYOUT_HORIZONTAL : LAYOUT_VERTICAL,
+        Config::CandidateWindow::MIN_WIDTH, Config::CandidateWindow::PADDING, Config::CandidateWindow::LINE_HEIGHT
+    };
+    LayoutCandidates(metrics, _labelWidths, _textWidths, _layout);
 }
 
 void CCandidateWindow::Hide()
@@ -129,11 +208,15 @@ LRESULT CALLBACK CCandidateWindow::_WndProc(HWND hwnd, UINT uMsg, WPARAM wParam,
         {
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hwnd, &ps);
-            pThis->_OnPaint(hdc);
+            pThis->_OnPaint(hdc, ps.rcPaint);
             EndPaint(hwnd, &ps);
         }
         return 0;
 
+    case WM_ERASEBKGND:
+        // Painted in WM_PAINT, through the back buffer
+        return 1;
+
     case WM_MOUSEACTIVATE:
         // Prevent window from being activated when clicked
         return MA_NOACTIVATE;
@@ -141,19 +224,9 @@ LRESULT CALLBACK CCandidateWindow::_WndProc(HWND hwnd, UINT uMsg, WPARAM wParam,
     case WM_LBUTTONDOWN:
         if (pThis)
         {
-            // Calculate which candidate was clicked
-            int mouseY = GET_Y_LPARAM(lParam);
-            int index = (mouseY - Config::CandidateWindow::PADDING) / Config::CandidateWindow::LINE_HEIGHT;
-            
-            // Validate index
-            if (index >= 0 && index < (int)pThis->_candidates.size())
-            {
-                pThis->_clickedIndex = index;
-            }
-            else
-            {
-                pThis->_clickedIndex = -1;
-            }
+            // The painted cells decide which candidate was clicked; -1 for
+            // the padding between them
+            pThis->_clickedIndex = HitTestCandidates(pThis->_layout, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
         }
         return 0;
 
@@ -180,48 +253,108 @@ LRESULT CALLBACK CCandidateWindow::_WndProc(HWND hwnd, UINT uMsg, WPARAM wParam,
     }
 }
 
-void CCandidateWindow::_OnPaint(HDC hdc)
+// The back buffer, at least width x height, with the font selected. NULL
+// if it cannot be created; the caller then paints directly.
+HDC CCandidateWindow::_GetBackBuffer(HDC hdc, int width, int height)
+{
+    if (_hdcBack && width <= _backWidth && height <= _backHeight) return _hdcBack;
+
+    _ReleaseBackBuffer();
+    _hdcBack = CreateCompatibleDC(hdc);
+    _hbmBack = _hdcBack ? CreateCompatibleBitmap(hdc, width, height) : NULL;
+    if (!_hbmBack)
+    {
+        _ReleaseBackBuffer();
+        return NULL;
+    }
+    _hbmOld = SelectObject(_hdcBack, _hbmBack);
+    _hFontOld = SelectObject(_hdcBack, _hFont);
+    SetBkMode(_hdcBack, TRANSPARENT);
+    _backWidth = width;
+    _backHeight = height;
+    return _hdcBack;
+}
+
+void CCandidateWindow::_ReleaseBackBuffer()
+{
+    if (_hdcBack)
+    {
+        if (_hbmOld) SelectObject(_hdcBack, _hbmOld);
+        if (_hFontOld) SelectObject(_hdcBack, _hFontOld);
+        DeleteDC(_hdcBack);
+        _hdcBack = NULL;
+    }
+    if (_hbmBack)
+    {
+        DeleteObject(_hbmBack);
+        _hbmBack = NULL;
+    }
+    _hbmOld = NULL;
+    _hFontOld = NULL;
+    _backWidth = 0;
+    _backHeight = 0;
+}
+
+// Paint the cells that intersect rcDirty into the back buffer, then copy
+// just that region to the window.
+void CCandidateWindow::_OnPaint(HDC hdc, const RECT& rcDirty)
 {
     RECT rc;
     GetClientRect(_hwnd, &rc);
     int maxWidth = rc.right;
-    
+
+    HDC hdcPaint = _GetBackBuffer(hdc, rc.right, rc.bottom);
+    HGDIOBJ hOldFont = NULL;
+    if (!hdcPaint)
+    {
+        hdcPaint = hdc;
+        hOldFont = SelectObject(hdc, _hFont);
+        SetBkMode(hdc, TRANSPARENT);
+    }
+
     // Fill background
-    HBRUSH hBrushBg = CreateSolidBrush(RGB(255, 255, 255));
-    FillRect(hdc, &rc, hBrushBg);
-    DeleteObject(hBrushBg);
+    FillRect(hdcPaint, &rcDirty, _hBrushBg);
 
     // Draw candidates
-    HFONT hOldFont = (HFONT)SelectObject(hdc, _hFont);
-    SetBkMode(hdc, TRANSPARENT);
-
-    int y = Config::CandidateWindow::PADDING;
-    for (size_t i = 0; i < _candidates.size(); ++i)
+    for (size_t i = 0; i < _candidates.Size() && i < _layout.cells.size(); ++i)
     {
-        std::wstring line = std::to_wstring(i + 1) + L". " + _candidates[i];
+        const CandidateCell& cell = _layout.cells[i];
+        if (cell.rect.bottom <= rcDirty.top || cell.rect.top >= rcDirty.bottom ||
+            cell.rect.right <= rcDirty.left || cell.rect.left >= rcDirty.right) continue;
         
         // Highlight selected
         if ((int)i == _selectedIndex)
         {
-            RECT rcLine = { Config::CandidateWindow::PADDING, y, maxWidth - Config::CandidateWindow::PADDING, y + Config::CandidateWindow::LINE_HEIGHT };
-            HBRUSH hBrushSel = CreateSolidBrush(RGB(230, 240, 255)); // Light blue
-            FillRect(hdc, &rcLine, hBrushSel);
-            DeleteObject(hBrushSel);
-            SetTextColor(hdc, RGB(0, 120, 215)); // Blue text
+            RECT rcCell = { cell.rect.left, cell.rect.top, cell.rect.right, cell.rect.bottom };
+            FillRect(hdcPaint, &rcCell, _hBrushSel);
+            SetTextColor(hdcPaint, RGB(0, 120, 215)); // Blue text
         }
         else
         {
-            SetTextColor(hdc, RGB(0, 0, 0)); // Black text
+            SetTextColor(hdcPaint, RGB(0, 0, 0)); // Black text
         }
 
-        TextOut(hdc, Config::CandidateWindow::PADDING * 2, y + 2, line.c_str(), (int)line.length());
-        y += Config::CandidateWindow::LINE_HEIGHT;
+        const std::wstring& label = CandidateLabel(i);
+        TextOut(hdcPaint, cell.labelX, cell.textY, label.c_str(), (int)label.length());
+        TextOut(hdcPaint, cell.textX, cell.textY, _candidates.Text(i), (int)_candidates.Length(i));
     }
 
-    // Draw Version Stamp
-    SetTextColor(hdc, RGB(150, 150, 150)); // Gray text
-    std::wstring ver = L"UTIME v1.3";
-    TextOut(hdc, maxWidth - 80, 2, ver.c_str(), (int)ver.length());
+    // Draw Version Stamp; a row of candidates has no free corner for it
+    if (_layout.orientation == LAYOUT_VERTICAL &&
+        rcDirty.top < Config::CandidateWindow::PADDING + Config::CandidateWindow::LINE_HEIGHT)
+    {
+        SetTextColor(hdcPaint, RGB(150, 150, 150)); // Gray text
+        static const wchar_t ver[] = L"UTIME v1.3";
+        TextOut(hdcPaint, maxWidth - 80, 2, ver, (int)(sizeof(ver) / sizeof(ver[0]) - 1));
+    }
 
-    SelectObject(hdc, hOldFont);
+    if (hdcPaint == hdc)
+    {
+        SelectObject(hdc, hOldFont);
+    }
+    else
+    {
+        BitBlt(hdc, rcDirty.left, rcDirty.top, rcDirty.right - rcDirty.left, rcDirty.bottom - rcDirty.top,
+               hdcPaint, rcDirty.left, rcDirty.top, SRCCOPY);
+    }
 }
@@ -0,0 +1,105 @@
+#include "CaretLocator.h"
+#include <chrono>
+#include <cstring>
+
+// Windows seen by one text service stay few; past this the map is reset
+// rather than aged.
+static const size_t kMaxRememberedWindows = 64;
+
+CCaretLocator::CCaretLocator(unsigned recheckInterval)
+    : _recheckInterval(recheckInterval)
+{
+    memset(_stats, 0, sizeof(_stats));
+}
+
+CaretStrategy CCaretLocator::Locate(uintptr_t window, const CaretProbe& probe, CaretRect& rc, bool textExtent)
+{
+    if (!textExtent) return _LocateWithoutExtent(window, probe, rc);
+
+    CaretStrategy first = CARET_NONE;
+    auto known = _remembered.find(window);
+    if (known != _remembered.end())
+    {
+        Remembered& entry = known->second;
+        entry.uses++;
+        bool recheck = entry.strategy == CARET_MOUSE && _recheckInterval && entry.uses % _recheckInterval == 0;
+        if (!recheck)
+        {
+            first = entry.strategy;
+            if (_Try(first, probe, rc)) return first;
+        }
+    }
+
+    // The remembered strategy failed, or there is none: walk them all
+    bool isNew = known == _remembered.end();
+    for (int i = 0; i < CARET_STRATEGY_COUNT; ++i)
+    {
+        CaretStrategy strategy = (CaretStrategy)i;
+        if (strategy == first || !_Try(strategy, probe, rc)) continue;
+
+        if (isNew && _remembered.size() >= kMaxRememberedWindows) _remembered.clear();
+        Remembered& entry = _remembered[window];
+        if (isNew || entry.strategy != strategy) entry.uses = 0;
+        entry.strategy = strategy;
+        return strategy;
+    }
+
+    _remembered.erase(window);
+    return CARET_NONE;
+}
+
+// Locate for a caller with no composition extent: the remembered strategy
+// unless it is the extent, then the others in order, all read-only.
+CaretStrategy CCaretLocator::_LocateWithoutExtent(uintptr_t window, const CaretProbe& probe, CaretRect& rc)
+{
+    CaretStrategy first = CARET_NONE;
+    auto known = _remembered.find(window);
+    if (known != _remembered.end() && known->second.strategy != CARET_TEXT_EXT)
+    {
+        first = known->second.strategy;
+        if (_Try(first, probe, rc)) return first;
+    }
+
+    for (int i = 0; i < CARET_STRATEGY_COUNT; ++i)
+    {
+        CaretStrategy strategy = (CaretStrategy)i;
+        if (strategy == CARET_TEXT_EXT || strategy == first) continue;
+        if (_Try(strategy, probe, rc)) return strategy;
+    }
+    return CARET_NONE;
+}
+
+void CCaretLocator::Invalidate(uintptr_t window)
+{
+    _remembered.erase(window);
+}
+
+void CCaretLocator::Clear()
+{
+    _remembered.clear();
+}
+
+const char* CCaretLocator::StrategyName(CaretStrategy strategy)
+{
+    switch (strategy)
+    {
+    case CARET_TEXT_EXT: return "GetTextExt";
+    case CARET_VIEW_THREAD: return "view thread";
+    case CARET_FOREGROUND_THREAD: return "foreground thread";
+    case CARET_CARET_POS: return "GetCaretPos";
+    case CARET_MOUSE: return "mouse";
+    default: return "none";
+    }
+}
+
+bool CCaretLocator::_Try(CaretStrategy strategy, const CaretProbe& probe, CaretRect& rc)
+{
+    auto start = std::chrono::steady_clock::now();
+    bool hit = probe(strategy, rc);
+    CaretStrategyStats& stats = _stats[strategy];
+    stats.attempts++;
+    if (hit) stats.hits++;
+    stats.totalNs += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return hit;
+}
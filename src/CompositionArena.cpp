@@ -0,0 +1,84 @@
+#include "CompositionArena.h"
+#include <cstdint>
+
+CCompositionArena::CCompositionArena(size_t blockSize)
+    : _blockSize(blockSize), _current(0), _offset(0), _top(nullptr), _used(0), _peak(0)
+{
+}
+
+void CCompositionArena::Reset()
+{
+    _current = 0;
+    _offset = 0;
+    _top = nullptr;
+    _starts.clear();
+    _large.clear();
+    _used = 0;
+    _peak = 0;
+}
+
+void CCompositionArena::NoteLength(size_t length)
+{
+    if (_peakByLength.size() <= length) _peakByLength.resize(length + 1, 0);
+    if (_peak > _peakByLength[length]) _peakByLength[length] = _peak;
+}
+
+void CCompositionArena::_Hold(size_t bytes)
+{
+    _used += bytes;
+    if (_used > _peak) _peak = _used;
+}
+
+void* CCompositionArena::do_allocate(size_t bytes, size_t alignment)
+{
+    if (bytes + alignment > _blockSize)
+    {
+        _large.emplace_back(new unsigned char[bytes + alignment]);
+        uintptr_t address = (uintptr_t)_large.back().get();
+        _Hold(bytes + alignment);
+        return (void*)((address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    for (;;)
+    {
+        if (_current == _blocks.size()) _blocks.emplace_back(new unsigned char[_blockSize]);
+
+        unsigned char* base = _blocks[_current].get();
+        uintptr_t address = (uintptr_t)(base + _offset);
+        size_t padding = (size_t)((alignment - address % alignment) % alignment);
+        if (_offset + padding + bytes <= _blockSize)
+        {
+            unsigned char* p = base + _offset + padding;
+            _starts.push_back(_offset);
+            _offset += padding + bytes;
+            _top = base + _offset;
+            _Hold(padding + bytes);
+            return p;
+        }
+
+        // The rest of this block goes unused until the next Reset
+        _current++;
+        _offset = 0;
+        _starts.clear();
+    }
+}
+
+void CCompositionArena::do_deallocate(void* p, size_t bytes, size_t)
+{
+    // Only the most recent allocation can be given back, with its padding,
+    // so the one before it is the most recent again; containers freed in
+    // reverse order of creation (locals) unwind to the start of the block
+    if (p && !_starts.empty() && (unsigned char*)p + bytes == _top)
+    {
+        size_t start = _starts.back();
+        _starts.pop_back();
+        _used -= _offset - start;
+        _offset = start;
+        _top = _blocks[_current].get() + start;
+    }
+}
+
+bool CCompositionArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
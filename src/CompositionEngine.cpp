@@ -0,0 +1,227 @@
+#include "CompositionEngine.h"
+#include <algorithm>
+
+static CompositionResult Result(bool eaten, unsigned actions)
+{
+    CompositionResult result = { eaten, actions };
+    return result;
+}
+
+CCompositionEngine::CCompositionEngine(const CandidateSource& source, int pageSize, const PredictionSource& predict)
+    : _source(source), _predict(predict), _pageSize(pageSize), _more(false), _predicting(false), _pageStart(0),
+      _selection(0)
+{
+}
+
+bool CCompositionEngine::WouldEat(const CompositionKey& key) const
+{
+    if (key.code == COMP_KEY_LETTER) return true;
+    if (_predicting) return _WouldEatPrediction(key);
+    if (_composition.empty()) return false;
+
+    switch (key.code)
+    {
+    case COMP_KEY_DIGIT:
+    case COMP_KEY_BACKSPACE:
+    case COMP_KEY_SPACE:
+    case COMP_KEY_ENTER:
+    case COMP_KEY_UP:
+    case COMP_KEY_DOWN:
+    case COMP_KEY_PAGE_UP:
+    case COMP_KEY_PAGE_DOWN:
+    case COMP_KEY_ESCAPE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Predictions appear without the user asking, so they take only the keys
+// that choose or page through them. Space, Enter, arrows and digits
+// beyond the page keep their meaning in the application, and '-' and '='
+// are text unless there is a page to turn to.
+bool CCompositionEngine::_WouldEatPrediction(const CompositionKey& key) const
+{
+    switch (key.code)
+    {
+    case COMP_KEY_DIGIT:
+        return key.ch >= L'1' && key.ch <= L'9' && key.ch - L'1' < (int)PageLength();
+    case COMP_KEY_PAGE_UP:
+        return _pageStart > 0;
+    case COMP_KEY_PAGE_DOWN:
+        return _pageStart + _pageSize < (int)_candidates.Size();
+    case COMP_KEY_ESCAPE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+CompositionResult CCompositionEngine::OnKey(const CompositionKey& key)
+{
+    if (_predicting && !WouldEat(key))
+    {
+        // A modifier may be the start of a chord or a capital; anything
+        // else is typing that ignores the predictions
+        if (key.code == COMP_KEY_MODIFIER) return Result(false, 0);
+        Reset();
+        return Result(false, ACTION_END_COMMIT_RUN | ACTION_HIDE_CANDIDATES);
+    }
+
+    if (!WouldEat(key))
+    {
+        // Punctuation, navigation, editing keys etc. separate the commits
+        // on either side of them
+        return Result(false, key.code == COMP_KEY_MODIFIER ? 0 : ACTION_END_COMMIT_RUN);
+    }
+
+    switch (key.code)
+    {
+    case COMP_KEY_LETTER:
+        // Typing over predictions continues the commit run
+        _predicting = false;
+        _composition += key.ch;
+        return _Refresh();
+
+    case COMP_KEY_BACKSPACE:
+        _composition.pop_back();
+        if (!_composition.empty()) return _Refresh();
+        Reset();
+        return Result(true, ACTION_END_COMPOSITION | ACTION_HIDE_CANDIDATES);
+
+    case COMP_KEY_DIGIT:
+        // Eaten even when out of range, so the digit never lands mid-pinyin
+        if (key.ch >= L'1' && key.ch <= L'9' && key.ch - L'1' < (int)PageLength())
+        {
+            return _Commit(_pageStart + (key.ch - L'1'));
+        }
+        return Result(true, 0);
+
+    case COMP_KEY_SPACE:
+        // Selected candidate; the raw pinyin if the list is somehow empty
+        return _selection < (int)_candidates.Size() ? _Commit(_selection) : _CommitRaw();
+
+    case COMP_KEY_ENTER:
+        return _CommitRaw();
+
+    case COMP_KEY_UP:
+        // Wraps to the last candidate fetched, without fetching the rest
+        return _MoveTo((_selection == 0 ? (int)_candidates.Size() : _selection) - 1);
+
+    case COMP_KEY_DOWN:
+        _Fetch(_selection + 2);
+        return _MoveTo((_selection + 1) % (int)_candidates.Size());
+
+    case COMP_KEY_PAGE_UP:
+        if (_pageStart == 0) return Result(true, 0);
+        return _MoveTo(_pageStart - _pageSize);
+
+    case COMP_KEY_PAGE_DOWN:
+        // Eaten on the last page too, so '=' never lands mid-pinyin
+        if (!_Fetch(_pageStart + _pageSize + 1)) return Result(true, 0);
+        return _MoveTo(_pageStart + _pageSize);
+
+    case COMP_KEY_ESCAPE:
+        if (_predicting)
+        {
+            Reset();
+            return Result(true, ACTION_HIDE_CANDIDATES);
+        }
+        Reset();
+        return Result(true, ACTION_END_COMMIT_RUN | ACTION_END_COMPOSITION | ACTION_HIDE_CANDIDATES);
+
+    default:
+        return Result(false, 0);
+    }
+}
+
+CompositionResult CCompositionEngine::SelectCandidate(int index)
+{
+    if ((_composition.empty() && !_predicting) || index < 0 || index >= (int)PageLength()) return Result(false, 0);
+    return _Commit(_pageStart + index);
+}
+
+size_t CCompositionEngine::PageLength() const
+{
+    return std::min(_candidates.Size() - (size_t)_pageStart, (size_t)_pageSize);
+}
+
+void CCompositionEngine::Reset()
+{
+    _composition.clear();
+    _candidates.Clear();
+    _more = false;
+    _predicting = false;
+    _pageStart = 0;
+    _selection = 0;
+}
+
+// The composition changed: query its first batch again and go back to the
+// first page.
+CompositionResult CCompositionEngine::_Refresh()
+{
+    _candidates.Clear();
+    _more = _source(_composition, false, _candidates);
+    if (_candidates.Empty())
+    {
+        _candidates.Add(_composition);
+        _more = false;
+    }
+    _pageStart = -1;
+    _MoveTo(0);
+    return Result(true, ACTION_UPDATE_PREEDIT | ACTION_SHOW_CANDIDATES);
+}
+
+// Select candidate `index` (already fetched), turning the page if needed.
+// A page is filled when it is turned to, so only the last one is short.
+CompositionResult CCompositionEngine::_MoveTo(int index)
+{
+    _selection = index;
+    int pageStart = index - index % _pageSize;
+    if (pageStart == _pageStart) return Result(true, ACTION_MOVE_SELECTION);
+
+    _Fetch(pageStart + _pageSize);
+    _pageStart = pageStart;
+    return Result(true, ACTION_SHOW_PAGE);
+}
+
+// Fetch batches until at least `count` candidates are known or the source
+// runs dry. Returns whether there are `count`.
+bool CCompositionEngine::_Fetch(size_t count)
+{
+    while (_candidates.Size() < count && _more)
+    {
+        size_t before = _candidates.Size();
+        _more = _source(_composition, true, _candidates);
+        if (_candidates.Size() == before) _more = false;
+    }
+    return _candidates.Size() >= count;
+}
+
+CompositionResult CCompositionEngine::_Commit(size_t id)
+{
+    // assign() reuses the strings' buffers from the last commit
+    _commitText.assign(_candidates.Text(id), _candidates.Length(id));
+    _commitKey.assign(_composition);
+
+    // Learn from real candidate choices, not raw pinyin commits
+    unsigned learning = _commitText != _commitKey ? ACTION_LEARN : ACTION_END_COMMIT_RUN;
+    Reset();
+    if (learning != ACTION_LEARN || !_predict) return Result(true, learning | ACTION_COMMIT | ACTION_HIDE_CANDIDATES);
+
+    // Offer what usually follows in place of the candidates just used
+    _predict(_commitText, _candidates);
+    if (_candidates.Empty()) return Result(true, learning | ACTION_COMMIT | ACTION_HIDE_CANDIDATES);
+    _predicting = true;
+    _pageStart = -1;
+    _MoveTo(0);
+    return Result(true, learning | ACTION_COMMIT | ACTION_SHOW_CANDIDATES);
+}
+
+CompositionResult CCompositionEngine::_CommitRaw()
+{
+    _commitText.assign(_composition);
+    _commitKey.assign(_composition);
+    Reset();
+    return Result(true, ACTION_END_COMMIT_RUN | ACTION_COMMIT | ACTION_HIDE_CANDIDATES);
+}
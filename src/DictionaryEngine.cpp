@@ -1,128 +1,76 @@
 #include "DictionaryEngine.h"
 #include "Globals.h"
 #include "Config.h"
+#include "PinyinNormalizer.h"
+#include "AutoCorrect.h"
+#include "PinyinSyllables.h"
+#include "HotWords.h"
+#include "SqliteUri.h"
 #include <shlobj.h>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
-#include <set>
+#include <cstring>
 #include <vector>
 #include <string>
 
-// ---------------------------------------------------------
-// Smart Correction & Fuzzy Logic Helpers
-// ---------------------------------------------------------
-
-// 1. Auto-Correction: Fix common typos
-std::string AutoCorrect(std::string input) {
-    static const std::vector<std::pair<std::string, std::string>> corrections = {
-        {"ign", "ing"},  {"img", "ing"},
-        {"uen", "un"},   {"iou", "iu"},
-        {"uei", "ui"},   {"v", "u"} 
-    };
-    for (const auto& pair : corrections) {
-        size_t pos = 0;
-        while ((pos = input.find(pair.first, pos)) != std::string::npos) {
-            input.replace(pos, pair.first.length(), pair.second);
-            pos += pair.second.length();
-        }
-    }
-    return input;
-}
-
-// 2. Fuzzy Expansion: Generate variants (z<->zh, l<->n, etc.)
-std::vector<std::string> GetFuzzyList(const std::string& input) {
-    std::string corrected = AutoCorrect(input);
-    std::set<std::string> variants;
-    variants.insert(corrected);
-
-    // Simple single-pass fuzzy expansion for performance
-    // Focusing on initials and common confused sounds
-    std::string temp = corrected;
-    
-    // z <-> zh
-    if (temp.find("zh") == 0) variants.insert("z" + temp.substr(2));
-    else if (temp.find("z") == 0) variants.insert("zh" + temp.substr(1));
-    
-    // c <-> ch
-    if (temp.find("ch") == 0) variants.insert("c" + temp.substr(2));
-    else if (temp.find("c") == 0) variants.insert("ch" + temp.substr(1));
-    
-    // s <-> sh
-    if (temp.find("sh") == 0) variants.insert("s" + temp.substr(2));
-    else if (temp.find("s") == 0) variants.insert("sh" + temp.substr(1));
-    
-    // l <-> n
-    if (temp.find("n") == 0) variants.insert("l" + temp.substr(1));
-    else if (temp.find("l") == 0) variants.insert("n" + temp.substr(1));
-    
-    // ing <-> in
-    if (temp.length() > 3 && temp.substr(temp.length()-3) == "ing") 
-        variants.insert(temp.substr(0, temp.length()-1)); // ing -> in
-    else if (temp.length() > 2 && temp.substr(temp.length()-2) == "in")
-        variants.insert(temp + "g"); // in -> ing
-
-    return std::vector<std::string>(variants.begin(), variants.end());
-}
-
-
-// Helper to remove tones from pinyin (e.g., "hǎo" -> "hao")
-std::string RemoveTones(const std::string& pinyin) {
-    std::string result;
-    // Simple tone mapping (this is a simplified version, robust implementation would map all unicode tone chars)
-    // Since input is UTF-8, we need to handle multibyte chars.
-    // However, for this specific task, we can use a simpler approach:
-    // Only keep a-z chars if we assume user only types a-z.
-    // But wait, the input file has unicode tones (ā, á, ǎ, à...).
-    // Let's use a brute-force mapping for common pinyin tone vowels.
-    
-    // Detailed mapping for Pinyin vowels with tones to ASCII vowels
-    static const std::vector<std::pair<std::string, char>> toneMap = {
-        {"ā", 'a'}, {"á", 'a'}, {"ǎ", 'a'}, {"à", 'a'},
-        {"ē", 'e'}, {"é", 'e'}, {"ě", 'e'}, {"è", 'e'},
-        {"ī", 'i'}, {"í", 'i'}, {"ǐ", 'i'}, {"ì", 'i'},
-        {"ō", 'o'}, {"ó", 'o'}, {"ǒ", 'o'}, {"ò", 'o'},
-        {"ū", 'u'}, {"ú", 'u'}, {"ǔ", 'u'}, {"ù", 'u'},
-        {"ǖ", 'v'}, {"ǘ", 'v'}, {"ǚ", 'v'}, {"ǜ", 'v'}, {"ü", 'v'},
-        {"n", 'n'}, {"g", 'g'} // just to be safe
-    };
-
-    for (size_t i = 0; i < pinyin.length(); ++i) {
-        unsigned char c = (unsigned char)pinyin[i];
-        if (c < 128) {
-            if (isalpha(c)) result += tolower(c);
-        } else {
-            // Multibyte character, check if it is a tone vowel
-            bool found = false;
-            for (const auto& pair : toneMap) {
-                if (pinyin.substr(i).find(pair.first) == 0) {
-                    result += pair.second;
-                    i += pair.first.length() - 1;
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-               // Skip unknown multibyte chars (or keep them? let's skip for pure pinyin)
-               // Actually, for safety, let's just skip until next ascii if we don't recognize
-            }
-        }
-    }
-    return result;
-}
-
 CDictionaryEngine& CDictionaryEngine::Instance()
 {
     static CDictionaryEngine instance;
     return instance;
 }
 
-CDictionaryEngine::CDictionaryEngine() : _db(NULL), _isInitialized(false)
+static PhraseLearnerLimits GetPhraseLimits()
 {
+    PhraseLearnerLimits limits;
+    limits.capacity = Config::UserHistory::PHRASE_CANDIDATES;
+    limits.promoteCount = Config::UserHistory::PHRASE_PROMOTE_COUNT;
+    limits.maxChars = Config::UserHistory::PHRASE_MAX_CHARS;
+    limits.maxSegments = Config::UserHistory::PHRASE_MAX_SEGMENTS;
+    limits.maxGapMs = Config::UserHistory::PHRASE_GAP_MS;
+    limits.agingInterval = Config::UserHistory::PHRASE_AGING_INTERVAL;
+    return limits;
+}
+
+CDictionaryEngine::CDictionaryEngine()
+    : _db(NULL), _hasAbbreviations(false), _hasSuccessors(false), _successorStatement(NULL), _isInitialized(false),
+      _hotQueries(0), _phrases(GetPhraseLimits())
+{
+    memset(_prefixStatements, 0, sizeof(_prefixStatements));
+    memset(_typoStatements, 0, sizeof(_typoStatements));
 }
 
 CDictionaryEngine::~CDictionaryEngine()
 {
+    // Destroyed as a static at DLL detach, under the loader lock, where
+    // waiting for a thread can deadlock. Deactivate and DllCanUnloadNow
+    // wait for the loader, so it has normally finished long ago. If not
+    // (or process exit killed it), abandon it: keep its state alive so the
+    // async future does not block in its destructor, and close nothing it
+    // may be using.
+    if (_initTask.valid() && _initTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        new std::shared_future<bool>(_initTask);
+        return;
+    }
+    for (auto& modes : _prefixStatements)
+    {
+        for (auto& statements : modes)
+        {
+            for (sqlite3_stmt*& stmt : statements)
+            {
+                sqlite3_finalize(stmt);
+                stmt = NULL;
+            }
+        }
+    }
+    for (sqlite3_stmt*& stmt : _typoStatements)
+    {
+        sqlite3_finalize(stmt);
+        stmt = NULL;
+    }
+    sqlite3_finalize(_successorStatement);
+    _successorStatement = NULL;
     if (_db)
     {
         sqlite3_close(_db);
@@ -132,28 +80,58 @@ CDictionaryEngine::~CDictionaryEngine()
 
 bool CDictionaryEngine::Initialize()
 {
-    if (_isInitialized) return true;
+    InitializeAsync();
+    _WaitForInitialize();
+    return IsReady();
+}
 
-    DebugLog(L"DictionaryEngine::Initialize starting...");
+void CDictionaryEngine::InitializeAsync()
+{
+    std::lock_guard<std::mutex> guard(_initLock);
+    if (IsReady()) return;
 
-    // Build candidate paths list
-    std::vector<std::pair<std::wstring, bool>> candidatePaths; // path, isWritable
-    
-    // Path 1: AppData\UTIME\utime.db (read-write)
-    TCHAR szPath[MAX_PATH];
-    if (SUCCEEDED(SHGetFolderPath(NULL, CSIDL_APPDATA, NULL, 0, szPath)))
-    {
-        std::wstring appDataPath = szPath;
-        appDataPath += L"\\UTIME\\utime.db";
-        candidatePaths.push_back(std::make_pair(appDataPath, true));
-        DebugLog(L"Candidate path 1 (AppData): %s", appDataPath.c_str());
-    }
-    else
+    // One load at a time; a failed load is retried by the next activation
+    if (_initTask.valid() && _initTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+
+    _initStart = std::chrono::steady_clock::now();
+    _hotQueries = 0;
+    _initTask = std::async(std::launch::async, [this]() { return _Load(); }).share();
+    DebugLog(L"DictionaryEngine: Loading in the background");
+}
+
+void CDictionaryEngine::_WaitForInitialize()
+{
+    std::shared_future<bool> task;
     {
-        DebugLog(L"SHGetFolderPath failed, skipping AppData path");
+        std::lock_guard<std::mutex> guard(_initLock);
+        task = _initTask;
     }
-    
-    // Path 2: DLL directory\utime.db (read-only)
+    if (task.valid()) task.wait();
+}
+
+static int MillisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+}
+
+// Runs on the loader thread started by InitializeAsync. Nothing here may
+// be touched by the UI thread until _isInitialized is set.
+bool CDictionaryEngine::_Load()
+{
+    DebugLog(L"DictionaryEngine::_Load starting...");
+
+    auto start = std::chrono::steady_clock::now();
+    _LoadCorrectionRules();
+    auto rulesDone = std::chrono::steady_clock::now();
+    _OpenUserHistory();
+    auto userDataDone = std::chrono::steady_clock::now();
+
+    // The lexicon is opened read-only where it is, never copied: the
+    // shipped file next to the DLL first, then a copy in AppData left by
+    // older versions (or placed there by hand). Only user data is written,
+    // to user.db and user.journal.
+    std::vector<std::wstring> candidatePaths;
+
     wchar_t dllPath[MAX_PATH];
     if (GetModuleFileName(g_hInst, dllPath, MAX_PATH))
     {
@@ -161,217 +139,785 @@ bool CDictionaryEngine::Initialize()
         size_t lastSlash = dllDirPath.find_last_of(L"\\/");
         if (lastSlash != std::wstring::npos)
         {
-            dllDirPath = dllDirPath.substr(0, lastSlash);
-            dllDirPath += L"\\utime.db";
-            candidatePaths.push_back(std::make_pair(dllDirPath, false));
-            DebugLog(L"Candidate path 2 (DLL dir): %s", dllDirPath.c_str());
+            candidatePaths.push_back(dllDirPath.substr(0, lastSlash) + L"\\utime.db");
         }
     }
-    
-    // Path 3: Windows\Temp\UTIME\utime.db (read-write)
-    TCHAR szTempPath[MAX_PATH];
-    if (GetTempPath(MAX_PATH, szTempPath))
+
+    TCHAR szPath[MAX_PATH];
+    if (SUCCEEDED(SHGetFolderPath(NULL, CSIDL_APPDATA, NULL, 0, szPath)))
     {
-        std::wstring tempPath = szTempPath;
-        tempPath += L"UTIME\\utime.db";
-        candidatePaths.push_back(std::make_pair(tempPath, true));
-        DebugLog(L"Candidate path 3 (Temp): %s", tempPath.c_str());
+        candidatePaths.push_back(std::wstring(szPath) + L"\\UTIME\\utime.db");
     }
 
-    // Try each path
     for (size_t i = 0; i < candidatePaths.size(); ++i)
     {
-        std::wstring dbPath = candidatePaths[i].first;
-        bool isWritable = candidatePaths[i].second;
-        
-        DebugLog(L"Trying path %d: %s (writable=%d)", i + 1, dbPath.c_str(), isWritable);
-        
-        // Check if file exists
-        DWORD attr = GetFileAttributes(dbPath.c_str());
-        bool fileExists = (attr != INVALID_FILE_ATTRIBUTES);
-        
-        if (!fileExists && isWritable)
+        const std::wstring& dbPath = candidatePaths[i];
+        if (GetFileAttributes(dbPath.c_str()) == INVALID_FILE_ATTRIBUTES)
         {
-            // Try to copy from DLL directory
-            DebugLog(L"Database not found, attempting to copy from DLL dir");
-            
-            // Get source path (DLL directory)
-            wchar_t srcDllPath[MAX_PATH];
-            if (GetModuleFileName(g_hInst, srcDllPath, MAX_PATH))
-            {
-                std::wstring sourcePath = srcDllPath;
-                size_t lastSlash = sourcePath.find_last_of(L"\\/");
-                if (lastSlash != std::wstring::npos)
-                {
-                    sourcePath = sourcePath.substr(0, lastSlash);
-                    sourcePath += L"\\utime.db";
-                    
-                    DebugLog(L"Source DB path: %s", sourcePath.c_str());
-                    
-                    // Create directory if needed
-                    std::wstring dirPath = dbPath.substr(0, dbPath.find_last_of(L"\\/"));
-                    CreateDirectory(dirPath.c_str(), NULL);
-                    
-                    if (!CopyFile(sourcePath.c_str(), dbPath.c_str(), FALSE))
-                    {
-                        DebugLog(L"Failed to copy database, error=%d", GetLastError());
-                        continue; // Try next path
-                    }
-                    else
-                    {
-                        DebugLog(L"Database copied successfully");
-                        fileExists = true;
-                    }
-                }
-            }
+            DebugLog(L"No lexicon at %s", dbPath.c_str());
+            continue;
         }
-        
-        if (fileExists)
+        if (!_OpenLexicon(dbPath)) continue;
+
+        _hasAbbreviations = _HasColumn("abbreviations", "pinyin_clean");
+        if (!_hasAbbreviations) DebugLog(L"Lexicon has no abbreviations table, initials are matched through idx_initials");
+        _hasSuccessors = _HasColumn("successors", "next");
+        if (!_hasSuccessors) DebugLog(L"Lexicon has no successor lists, predictions come from user history only");
+        _RegisterFunctions();
+
+        std::vector<FileRange> hotSet;
+        _ReadHotSet(hotSet);
+        _isInitialized.store(true, std::memory_order_release);
+
+        auto end = std::chrono::steady_clock::now();
+        DebugLog(L"Startup: ready %d ms after activation (rules %d ms, user data %d ms, lexicon %d ms); %d queries served from hot words",
+                 MillisecondsBetween(_initStart, end), MillisecondsBetween(start, rulesDone),
+                 MillisecondsBetween(rulesDone, userDataDone), MillisecondsBetween(userDataDone, end),
+                 _hotQueries.load());
+
+        // The lexicon is usable already; warm the pages the first keys will
+        // need while the user is still reaching for the keyboard
+        ULONGLONG prefetched = PrefetchFileRanges(dbPath, hotSet);
+        DebugLog(L"Startup: prefetched %d KB of hot pages in %d ms", (int)(prefetched / 1024),
+                 MillisecondsBetween(end, std::chrono::steady_clock::now()));
+        return true;
+    }
+
+    DebugLog(L"All database paths failed");
+    return false;
+}
+
+// The hot set DictBuilder recorded: runs of pages that the most frequent
+// prefixes read. Lexicons built before it existed have no hot_pages table.
+void CDictionaryEngine::_ReadHotSet(std::vector<FileRange>& ranges)
+{
+    ULONGLONG pageSize = 0;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(_db, "PRAGMA page_size;", -1, &stmt, 0) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW) pageSize = (ULONGLONG)sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    if (pageSize == 0) return;
+
+    if (sqlite3_prepare_v2(_db, "SELECT first_page, page_count FROM hot_pages ORDER BY first_page;", -1, &stmt, 0) != SQLITE_OK)
+    {
+        DebugLog(L"Lexicon has no hot set");
+        return;
+    }
+
+    ULONGLONG total = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW && total < (ULONGLONG)Config::Dictionary::HOT_SET_MAX_BYTES)
+    {
+        FileRange range;
+        range.offset = (ULONGLONG)sqlite3_column_int64(stmt, 0) * pageSize;
+        range.length = (ULONGLONG)sqlite3_column_int64(stmt, 1) * pageSize;
+        ranges.push_back(range);
+        total += range.length;
+    }
+    sqlite3_finalize(stmt);
+}
+
+// True if the lexicon has table `table` with column `column`. Reads the
+// schema only.
+bool CDictionaryEngine::_HasColumn(const char* table, const char* column)
+{
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(_db, "SELECT 1 FROM pragma_table_info(?) WHERE name = ?;", -1, &stmt, 0) != SQLITE_OK)
+    {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, column, -1, SQLITE_STATIC);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Open the lexicon at `dbPath` in place as an immutable database and check
+// that it has a lexicon table.
+bool CDictionaryEngine::_OpenLexicon(const std::wstring& dbPath)
+{
+    char dbPathUtf8[MAX_PATH * 3];
+    if (WideCharToMultiByte(CP_UTF8, 0, dbPath.c_str(), -1, dbPathUtf8, MAX_PATH * 3, NULL, NULL) == 0)
+    {
+        DebugLog(L"Failed to convert path to UTF-8, error=%d", GetLastError());
+        return false;
+    }
+
+    std::string uri = MakeImmutableSqliteUri(dbPathUtf8);
+    int rc = sqlite3_open_v2(uri.c_str(), &_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, NULL);
+    if (rc != SQLITE_OK)
+    {
+        DebugLog(L"Failed to open %s: %S", dbPath.c_str(), sqlite3_errmsg(_db));
+        sqlite3_close(_db);
+        _db = NULL;
+        return false;
+    }
+
+    // Reads one row rather than counting them all, which would page in the
+    // whole table on a cold start
+    sqlite3_stmt* stmt;
+    rc = sqlite3_prepare_v2(_db, "SELECT 1 FROM lexicon LIMIT 1;", -1, &stmt, 0);
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        if (rc == SQLITE_ROW || rc == SQLITE_DONE)
         {
-            // Try to open database
-            char dbPathUtf8[MAX_PATH * 3];
-            int ret = WideCharToMultiByte(CP_UTF8, 0, dbPath.c_str(), -1, dbPathUtf8, MAX_PATH * 3, NULL, NULL);
-            if (ret == 0)
-            {
-                DebugLog(L"Failed to convert path to UTF-8, error=%d", GetLastError());
-                continue;
-            }
-            
-            int rc = sqlite3_open(dbPathUtf8, &_db);
-            if (rc != SQLITE_OK)
-            {
-                DebugLog(L"Failed to open database: %S", sqlite3_errmsg(_db));
-                sqlite3_close(_db);
-                _db = NULL;
-                continue;
-            }
-            
-            DebugLog(L"Database opened successfully");
-            
-            // Verify table structure
-            sqlite3_stmt* stmt;
-            const char* testQuery = "SELECT COUNT(*) FROM lexicon LIMIT 1;";
-            rc = sqlite3_prepare_v2(_db, testQuery, -1, &stmt, 0);
-            if (rc == SQLITE_OK)
+            DebugLog(L"Lexicon opened in place: %s", dbPath.c_str());
+            return true;
+        }
+    }
+
+    DebugLog(L"Lexicon validation failed for %s: %S", dbPath.c_str(), sqlite3_errmsg(_db));
+    sqlite3_close(_db);
+    _db = NULL;
+    return false;
+}
+
+// Compile autocorrect.rules from the DLL directory, falling back to the
+// built-in table when the file is missing or malformed.
+void CDictionaryEngine::_LoadCorrectionRules()
+{
+    std::vector<CorrectionRule> rules = GetDefaultCorrectionRules();
+
+    wchar_t dllPath[MAX_PATH];
+    if (GetModuleFileName(g_hInst, dllPath, MAX_PATH))
+    {
+        std::wstring rulesPath = dllPath;
+        size_t lastSlash = rulesPath.find_last_of(L"\\/");
+        if (lastSlash != std::wstring::npos)
+        {
+            rulesPath = rulesPath.substr(0, lastSlash) + L"\\autocorrect.rules";
+            std::ifstream file(rulesPath.c_str());
+            if (file.is_open())
             {
-                rc = sqlite3_step(stmt);
-                sqlite3_finalize(stmt);
-                if (rc == SQLITE_ROW || rc == SQLITE_DONE)
+                std::vector<CorrectionRule> loaded;
+                std::string error;
+                if (LoadCorrectionRules(file, loaded, &error))
                 {
-                    DebugLog(L"Database structure validated");
-                    _isInitialized = true;
-                    return true;
+                    rules.swap(loaded);
+                    DebugLog(L"Loaded %d correction rules from %s", rules.size(), rulesPath.c_str());
                 }
                 else
                 {
-                    DebugLog(L"Database validation failed: %S", sqlite3_errmsg(_db));
+                    DebugLog(L"Ignoring %s: %S", rulesPath.c_str(), error.c_str());
                 }
             }
             else
             {
-                DebugLog(L"Failed to prepare validation query: %S", sqlite3_errmsg(_db));
+                DebugLog(L"No rules file at %s, using built-in corrections", rulesPath.c_str());
             }
-            
-            // If validation failed, close and try next path
-            sqlite3_close(_db);
-            _db = NULL;
         }
     }
-    
-    DebugLog(L"All database paths failed");
-    return false;
+
+    _corrector.Build(rules);
+    DebugLog(L"Correction automaton: %d rules, %d states", _corrector.RuleCount(), _corrector.StateCount());
+}
+
+// Normalize UTF-16 input to lowercase key bytes, then apply typo
+// corrections through the precompiled automaton (one pass each).
+bool CDictionaryEngine::_MakeKey(const std::wstring& pinyin, std::string& key) const
+{
+    char keyBuffer[Config::Dictionary::MAX_KEY_LENGTH];
+    KeyNormalizeResult normalized = NormalizeKey(pinyin.c_str(), pinyin.length(), keyBuffer, sizeof(keyBuffer));
+    if (!normalized.ok) return false;
+
+    char correctedBuffer[Config::Dictionary::MAX_KEY_LENGTH * 2];
+    bool truncated = false;
+    size_t correctedLength = _corrector.Apply(keyBuffer, normalized.length, correctedBuffer, sizeof(correctedBuffer), &truncated);
+    if (truncated)
+    {
+        // A cut-off correction would match the wrong words; the key as typed
+        // at least matches what the user wrote
+        DebugLog(L"Corrected key for '%s' does not fit, using it uncorrected", pinyin.c_str());
+        key.assign(keyBuffer, normalized.length);
+        return true;
+    }
+    key.assign(correctedBuffer, correctedLength);
+    return true;
+}
+
+// User data lives in AppData\UTIME, the only place the IME writes. Without it
+// learning still works for the session, it just is not persisted.
+void CDictionaryEngine::_OpenUserHistory()
+{
+    TCHAR szPath[MAX_PATH];
+    if (FAILED(SHGetFolderPath(NULL, CSIDL_APPDATA, NULL, 0, szPath)))
+    {
+        DebugLog(L"SHGetFolderPath failed, user history is session-only");
+        return;
+    }
+
+    std::wstring dirPath = szPath;
+    dirPath += L"\\UTIME";
+    CreateDirectory(dirPath.c_str(), NULL);
+    _history.Open(dirPath + L"\\user.db");
+}
+
+// Stand-in for Query while the lexicon is still loading: the built-in
+// hot-word table, without correction or fuzzy variants.
+void CDictionaryEngine::_QueryHotWords(const std::wstring& pinyin, CCandidateList& results)
+{
+    char key[Config::Dictionary::MAX_KEY_LENGTH];
+    KeyNormalizeResult normalized = NormalizeKey(pinyin.c_str(), pinyin.length(), key, sizeof(key));
+    if (!normalized.ok) return;
+
+    const wchar_t* words[Config::Dictionary::QUERY_BATCH_SIZE];
+    size_t count = LookupHotWords(key, normalized.length, words, Config::Dictionary::QUERY_BATCH_SIZE);
+    for (size_t i = 0; i < count; ++i) results.Add(words[i], wcslen(words[i]));
+    _hotQueries++;
+    DebugTrace(L"Query: Lexicon not ready, %d hot words for '%S'", count, std::string(key, normalized.length).c_str());
+}
+
+// Move candidates the user keeps choosing towards the front. Each doubling
+// of a candidate's selection count gains RANK_WEIGHT positions, and
+// dictionary order breaks ties.
+void CDictionaryEngine::_ApplyUserHistory(QueryCursor& cursor, CCandidateList& results, size_t first) const
+{
+    std::pmr::vector<int> counts(&cursor.arena);
+    _history.GetCounts(cursor.key, results, first, counts);
+
+    std::pmr::vector<std::pair<int, uint32_t>> ranked(&cursor.arena);
+    ranked.reserve(counts.size());
+    bool learned = false;
+    for (size_t i = first; i < results.Size(); ++i)
+    {
+        int count = counts[i - first];
+        int boost = 0;
+        for (int c = count; c > 0; c >>= 1) boost += Config::UserHistory::RANK_WEIGHT;
+        ranked.push_back(std::make_pair((int)(i - first) - boost, (uint32_t)i));
+        learned = learned || count > 0;
+    }
+    if (!learned) return;
+
+    // Pairs are unique (the position), so a plain sort keeps dictionary order on
+    // ties without the buffer std::stable_sort allocates
+    std::sort(ranked.begin(), ranked.end());
+
+    std::pmr::vector<uint32_t> order(&cursor.arena);
+    order.reserve(ranked.size());
+    for (const auto& item : ranked) order.push_back(item.second);
+    results.Permute(first, order.data(), order.size());
+}
+
+bool CDictionaryEngine::Predict(const std::wstring& text, CCandidateList& results)
+{
+    results.Clear();
+    if (!IsReady() || text.empty()) return false;
+
+    const size_t max = Config::Dictionary::MAX_PREDICTIONS;
+    _history.GetSuccessors(text, results, max);
+    size_t learned = results.Size();
+
+    if (_hasSuccessors && results.Size() < max)
+    {
+        if (!_successorStatement &&
+            sqlite3_prepare_v3(_db, "SELECT next FROM successors WHERE word = ?;", -1, SQLITE_PREPARE_PERSISTENT,
+                               &_successorStatement, 0) != SQLITE_OK)
+        {
+            DebugLog(L"Predict: SQL prepare failed: %S", sqlite3_errmsg(_db));
+            _successorStatement = NULL;
+            _hasSuccessors = false;
+            return !results.Empty();
+        }
+
+        char word[Config::Dictionary::MAX_KEY_LENGTH * 4];
+        int length = WideCharToMultiByte(CP_UTF8, 0, text.data(), (int)text.length(), word, sizeof(word), NULL, NULL);
+        sqlite3_bind_text(_successorStatement, 1, word, length, SQLITE_STATIC);
+        if (length > 0 && sqlite3_step(_successorStatement) == SQLITE_ROW)
+        {
+            // Words separated by spaces, best first
+            const char* next = (const char*)sqlite3_column_text(_successorStatement, 0);
+            int bytes = sqlite3_column_bytes(_successorStatement, 0);
+            wchar_t nextW[1024];
+            int count = next ? MultiByteToWideChar(CP_UTF8, 0, next, bytes, nextW, 1024) : 0;
+            for (int start = 0; start < count && results.Size() < max;)
+            {
+                int end = start;
+                while (end < count && nextW[end] != L' ') end++;
+                if (end > start) results.Add(nextW + start, (size_t)(end - start));
+                start = end + 1;
+            }
+        }
+        sqlite3_reset(_successorStatement);
+    }
+
+    DebugTrace(L"Predict: '%s' -> %d learned + %d lexicon suggestions", text.c_str(), learned, results.Size() - learned);
+    return !results.Empty();
 }
 
-std::vector<std::wstring> CDictionaryEngine::Query(const std::wstring& pinyin)
+void CDictionaryEngine::RecordCommit(const std::wstring& pinyin, const std::wstring& hanzi)
 {
-    std::vector<std::wstring> results;
-    if (!_db || pinyin.empty()) 
+    if (!IsReady()) return;
+
+    if (!_lastCommit.empty()) _history.RecordSuccessor(_lastCommit, hanzi);
+    _lastCommit = hanzi;
+
+    // A prediction has no key to learn under, and cannot join a phrase
+    if (pinyin.empty())
     {
-        DebugLog(L"Query: Database not initialized or pinyin empty");
-        return results;
+        _phrases.Break();
+        return;
     }
 
-    // Convert pinyin to UTF-8 and lowercase
-    char pinyinUtf8[128];
-    int ret = WideCharToMultiByte(CP_UTF8, 0, pinyin.c_str(), -1, pinyinUtf8, 128, NULL, NULL);
-    if (ret == 0)
+    std::string key;
+    if (!_MakeKey(pinyin, key)) return;
+    _history.Record(key, hanzi);
+    DebugTrace(L"RecordCommit: key='%S', hanzi='%s'", key.c_str(), hanzi.c_str());
+
+    std::vector<LearnedPhrase> promoted;
+    _phrases.Observe(key, hanzi, GetTickCount64(), promoted);
+    for (const LearnedPhrase& phrase : promoted)
+    {
+        DebugLog(L"RecordCommit: Learned phrase '%s'", phrase.text.c_str());
+        _AddOverlayWord(phrase.key, phrase.text);
+    }
+}
+
+void CDictionaryEngine::EndCommitRun()
+{
+    _phrases.Break();
+    _lastCommit.clear();
+}
+
+void CDictionaryEngine::AddUserWord(const std::wstring& pinyin, const std::wstring& hanzi)
+{
+    if (!IsReady()) return;
+
+    std::string key;
+    if (!_MakeKey(pinyin, key) || key.empty()) return;
+    _AddOverlayWord(key, hanzi);
+}
+
+void CDictionaryEngine::_AddOverlayWord(const std::string& key, const std::wstring& hanzi)
+{
+    // Initials from the syllable split, matching DictBuilder's column
+    std::string initials = SyllableInitials(key.data(), key.length());
+    _history.AddWord(key, initials, hanzi, Config::UserHistory::USER_WORD_PRIORITY);
+    DebugLog(L"AddUserWord: key='%S', initials='%S', hanzi='%s'", key.c_str(), initials.c_str(), hanzi.c_str());
+}
+
+void CDictionaryEngine::FlushUserData()
+{
+    _WaitForInitialize();
+    _history.Flush();
+}
+
+// Prefix match as a key range, [prefix, end), so SQLite can walk the
+// index on the key column. LIKE 'ni%' cannot use it (it is case
+// insensitive on a BINARY column) and scans the whole table. Keys are
+// lowercase letters, so bumping the last byte gives the end of the range.
+template <typename String>
+static void PrefixEnd(const String& prefix, String& end)
+{
+    if (prefix.empty())
+    {
+        end.assign("\x7f");    // Past every key
+        return;
+    }
+    end.assign(prefix);
+    end.back()++;
+}
+
+// Where each query mode looks: the table, the key column matched by
+// prefix, and the id that makes the order total.
+struct PrefixSource
+{
+    const char* table;
+    const char* column;
+    const char* id;
+};
+
+static const PrefixSource kPinyinSource = { "lexicon", "pinyin_clean", "rowid" };
+
+// Initials in their own table, clustered by initials and rank, so an
+// abbreviation reads a few adjacent pages instead of one lexicon row per
+// match
+static const PrefixSource kInitialsSource = { "abbreviations", "initials", "id" };
+
+// Lexicons built before the abbreviations table: idx_initials
+static const PrefixSource kLexiconInitialsSource = { "lexicon", "initials", "rowid" };
+
+// The type name mixed_match() takes its pointer argument under; SQLite
+// hands the pointer only to a function asking for the same name
+static const char* const kQueryCursorPointer = "QueryCursor";
+
+// mixed_match(cursor, pinyin_clean, initials): whether the row's word
+// begins with the syllables one of the cursor's mixed readings stands for.
+// It filters inside the initials ranges, before ORDER BY and LIMIT, so a
+// batch is full however many rows of the ranges it rejects.
+static void MixedMatchFunction(sqlite3_context* context, int, sqlite3_value** args)
+{
+    const QueryCursor* cursor = (const QueryCursor*)sqlite3_value_pointer(args[0], kQueryCursorPointer);
+    const char* pinyin = (const char*)sqlite3_value_text(args[1]);
+    size_t pinyinLength = (size_t)sqlite3_value_bytes(args[1]);
+    const char* initials = (const char*)sqlite3_value_text(args[2]);
+    size_t initialsLength = (size_t)sqlite3_value_bytes(args[2]);
+
+    bool match = false;
+    if (cursor && pinyin && initials)
     {
-        DebugLog(L"Query: Failed to convert pinyin to UTF-8, error=%d", GetLastError());
-        return results;
+        for (size_t i = 0; i < cursor->readingCount && !match; ++i)
+        {
+            match = MatchesMixedReading(cursor->key.data(), cursor->readings[i], pinyin, pinyinLength, initials, initialsLength);
+        }
     }
-    
-    std::string inputRaw = pinyinUtf8;
-    std::transform(inputRaw.begin(), inputRaw.end(), inputRaw.begin(), ::tolower);
-    
-    DebugLog(L"Query: Input pinyin='%s', UTF-8='%S'", pinyin.c_str(), inputRaw.c_str());
+    sqlite3_result_int(context, match ? 1 : 0);
+}
 
-    // Get all fuzzy variants (including auto-corrected)
-    std::vector<std::string> searchKeys = GetFuzzyList(inputRaw);
-    
-    // Limit variants to max configured value for performance
-    if (searchKeys.size() > (size_t)Config::Dictionary::MAX_FUZZY_VARIANTS)
+// SQL functions the prefix queries call, on the lexicon connection.
+void CDictionaryEngine::_RegisterFunctions()
+{
+    if (sqlite3_create_function_v2(_db, "mixed_match", 3, SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_DIRECTONLY, NULL,
+                                   MixedMatchFunction, NULL, NULL, NULL) != SQLITE_OK)
     {
-        searchKeys.resize(Config::Dictionary::MAX_FUZZY_VARIANTS);
+        DebugLog(L"Failed to register mixed_match: %S", sqlite3_errmsg(_db));
     }
-    
-    DebugLog(L"Query: Generated %d fuzzy variants", searchKeys.size());
-    for (size_t i = 0; i < searchKeys.size() && i < 3; ++i)
+}
+
+// The prefix query over `keyCount` key ranges in `mode`'s column, prepared
+// once and reused from key to key. Mixed keys also pass each row through
+// mixed_match. `resume` adds the condition that continues after the last
+// row of the previous batch.
+sqlite3_stmt* CDictionaryEngine::_PrefixStatement(QueryMode mode, size_t keyCount, bool resume)
+{
+    sqlite3_stmt*& stmt = _prefixStatements[mode][keyCount - 1][resume ? 1 : 0];
+    if (stmt)
     {
-        DebugLog(L"  Variant %d: %S", i, searchKeys[i].c_str());
+        sqlite3_reset(stmt);
+        return stmt;
     }
-    
+
+    const PrefixSource& source = mode == QUERY_PINYIN ? kPinyinSource
+                               : _hasAbbreviations ? kInitialsSource : kLexiconInitialsSource;
+    const std::string column = source.column;
+    const std::string length = "length(" + column + ")";
+    const std::string id = source.id;
+
     // Build Dynamic SQL
-    std::string sql = "SELECT hanzi FROM lexicon WHERE ";
-    for (size_t i = 0; i < searchKeys.size(); ++i) {
+    std::string sql = "SELECT hanzi, " + length + ", priority, " + id + " FROM " + source.table + " WHERE (";
+    for (size_t i = 0; i < keyCount; ++i) {
         if (i > 0) sql += " OR ";
-        sql += "(pinyin_clean LIKE ? OR initials LIKE ?)";
+        std::string from = "?" + std::to_string(2 * i + 1);
+        std::string to = "?" + std::to_string(2 * i + 2);
+        sql += "(" + column + " >= " + from + " AND " + column + " < " + to + ")";
+    }
+    sql += ")";
+    if (mode == QUERY_MIXED)
+    {
+        sql += " AND mixed_match(?" + std::to_string(2 * keyCount + 5) + ", pinyin_clean, " + column + ")";
+    }
+    if (resume)
+    {
+        std::string len = "?" + std::to_string(2 * keyCount + 1);
+        std::string priority = "?" + std::to_string(2 * keyCount + 2);
+        std::string last = "?" + std::to_string(2 * keyCount + 3);
+        sql += " AND (" + length + " > " + len + " OR (" + length + " = " + len + " AND "
+               "(priority < " + priority + " OR (priority = " + priority + " AND " + id + " > " + last + "))))";
     }
-    sql += " ORDER BY length(pinyin_clean) ASC, priority DESC LIMIT " + std::to_string(Config::Dictionary::MAX_QUERY_RESULTS) + ";";
-    
-    DebugLog(L"Query: SQL='%S'", sql.c_str());
+    sql += " ORDER BY " + length + " ASC, priority DESC, " + id + " ASC LIMIT ?" + std::to_string(2 * keyCount + 4) + ";";
 
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, 0) == SQLITE_OK)
-    {
-        // Bind parameters with SQLITE_TRANSIENT to let SQLite copy the strings
-        int bindIdx = 1;
-        for (size_t i = 0; i < searchKeys.size(); ++i) {
-            std::string likePattern = searchKeys[i] + "%";
-            // Use SQLITE_TRANSIENT to force SQLite to make a copy
-            sqlite3_bind_text(stmt, bindIdx++, likePattern.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(stmt, bindIdx++, likePattern.c_str(), -1, SQLITE_TRANSIENT);
+    DebugLog(L"Query: Preparing SQL='%S'", sql.c_str());
+    if (sqlite3_prepare_v3(_db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, 0) != SQLITE_OK)
+    {
+        DebugLog(L"Query: SQL prepare failed: %S", sqlite3_errmsg(_db));
+        stmt = NULL;
+    }
+    return stmt;
+}
+
+// Read the next `limit` lexicon rows for the cursor's search keys, in rank
+// order (key length, then priority, then rowid so the order is total).
+// The cursor remembers the last row, and the next call resumes after it
+// through the same index ranges instead of an OFFSET.
+void CDictionaryEngine::_QueryKeys(QueryCursor& cursor, int limit, RankedStream& stream)
+{
+    const size_t keyCount = cursor.searchKeyCount;
+    sqlite3_stmt* stmt = _PrefixStatement(cursor.mode, keyCount, cursor.started);
+    if (!stmt)
+    {
+        cursor.lexiconDone = true;
+        return;
+    }
+
+    // The keys live in the cursor until the next query, so SQLite can read
+    // them in place
+    int bindIdx = 1;
+    for (size_t i = 0; i < keyCount; ++i) {
+        sqlite3_bind_text(stmt, bindIdx++, cursor.searchKeys[i].c_str(), (int)cursor.searchKeys[i].length(), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, bindIdx++, cursor.searchEnds[i].c_str(), (int)cursor.searchEnds[i].length(), SQLITE_STATIC);
+    }
+    if (cursor.started)
+    {
+        sqlite3_bind_int(stmt, bindIdx++, cursor.lastLength);
+        sqlite3_bind_int(stmt, bindIdx++, cursor.lastPriority);
+        sqlite3_bind_int64(stmt, bindIdx++, cursor.lastRowid);
+    }
+    sqlite3_bind_int(stmt, (int)(2 * keyCount + 4), limit);
+    if (cursor.mode == QUERY_MIXED)
+    {
+        sqlite3_bind_pointer(stmt, (int)(2 * keyCount + 5), &cursor, kQueryCursorPointer, NULL);
+    }
+
+    int rowCount = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        // Every row moves the cursor, even one without text
+        cursor.started = true;
+        cursor.lastLength = sqlite3_column_int(stmt, 1);
+        cursor.lastPriority = sqlite3_column_int(stmt, 2);
+        cursor.lastRowid = sqlite3_column_int64(stmt, 3);
+        rowCount++;
+
+        const unsigned char* text = sqlite3_column_text(stmt, 0);
+        if (text)
+        {
+            wchar_t hanziW[128];
+            int length = MultiByteToWideChar(CP_UTF8, 0, (const char*)text, -1, hanziW, 128);
+            if (length > 1) stream.Add(hanziW, length - 1, cursor.lastLength, cursor.lastPriority);
         }
-        
-        DebugLog(L"Query: Bound %d parameters", bindIdx - 1);
-        
-        std::set<std::wstring> seen;
-        int rowCount = 0;
-        while (sqlite3_step(stmt) == SQLITE_ROW)
+    }
+    if (rc != SQLITE_DONE) DebugLog(L"Query: SQL step failed: %S", sqlite3_errmsg(_db));
+    sqlite3_reset(stmt);
+
+    // A short batch means the ranges are used up
+    cursor.lexiconDone = rowCount < limit;
+}
+
+// Append the next batch of the merged overlay + lexicon list. Overlay
+// entries are merged only up to the last lexicon row read, so an entry
+// ranked further down waits for the batch it belongs in.
+void CDictionaryEngine::_FetchBatch(QueryCursor& cursor, CCandidateList& results)
+{
+    RankedStream systemStream(&cursor.arena);
+    systemStream.ranks.reserve(Config::Dictionary::QUERY_BATCH_SIZE);
+    _QueryKeys(cursor, Config::Dictionary::QUERY_BATCH_SIZE, systemStream);
+
+    const std::pmr::vector<RankedCandidate>& user = cursor.userStream.ranks;
+    size_t userEnd = user.size();
+    if (!cursor.lexiconDone && !systemStream.ranks.empty())
+    {
+        userEnd = cursor.userNext;
+        while (userEnd < user.size() && !RanksBefore(systemStream.ranks.back(), user[userEnd])) userEnd++;
+    }
+
+    // Two ranked streams, the user overlay first so it wins ties, merged
+    // into one list without re-sorting the system results
+    RankedRange ranges[2] = {
+        { &cursor.userStream, cursor.userNext, userEnd },
+        { &systemStream, 0, systemStream.ranks.size() },
+    };
+    size_t merged = MergeRankedStreams(ranges, 2, (size_t)-1, results);
+    DebugTrace(L"Query: %d overlay + %d lexicon rows merged into %d candidates%s",
+               userEnd - cursor.userNext, systemStream.ranks.size(), merged,
+               cursor.lexiconDone && userEnd == user.size() ? L" (last batch)" : L"");
+    cursor.userNext = userEnd;
+    cursor.exhausted = cursor.lexiconDone && cursor.userNext == user.size();
+}
+
+// Query all corrected keys in one statement and append their candidates
+// ordered by the edit cost of the key they came from, then by priority.
+// The statement is prepared once per key count, like the prefix queries;
+// the ranking lives in `memory`.
+void CDictionaryEngine::_QueryTypoKeys(const std::pmr::vector<TypoCandidate>& typos, int limit, CCandidateList& results,
+                                       std::pmr::memory_resource* memory)
+{
+    if (typos.empty() || limit <= 0) return;
+
+    const size_t keyCount = std::min(typos.size(), (size_t)Config::Dictionary::TYPO_MAX_KEYS);
+    sqlite3_stmt*& stmt = _typoStatements[keyCount - 1];
+    if (stmt)
+    {
+        sqlite3_reset(stmt);
+    }
+    else
+    {
+        std::string sql = "SELECT hanzi, pinyin_clean FROM lexicon WHERE ";
+        for (size_t i = 0; i < keyCount; ++i) {
+            if (i > 0) sql += " OR ";
+            sql += "(pinyin_clean >= ? AND pinyin_clean < ?)";
+        }
+        sql += " ORDER BY length(pinyin_clean) ASC, priority DESC LIMIT ?" + std::to_string(2 * keyCount + 1) + ";";
+
+        if (sqlite3_prepare_v3(_db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, 0) != SQLITE_OK)
         {
-            const unsigned char* text = sqlite3_column_text(stmt, 0);
-            if (text)
-            {
-                wchar_t hanziW[128];
-                MultiByteToWideChar(CP_UTF8, 0, (const char*)text, -1, hanziW, 128);
-                if (seen.find(hanziW) == seen.end()) {
-                    results.push_back(hanziW);
-                    seen.insert(hanziW);
-                    rowCount++;
-                }
-            }
+            DebugLog(L"Query: Typo SQL prepare failed: %S", sqlite3_errmsg(_db));
+            stmt = NULL;
+            return;
         }
-        sqlite3_finalize(stmt);
-        
-        DebugLog(L"Query: Found %d candidates", rowCount);
-        for (size_t i = 0; i < results.size() && i < 3; ++i)
+    }
+
+    // The keys and their ends outlive the statement's run, so SQLite can
+    // read them in place
+    std::pmr::vector<std::pmr::string> ends(keyCount, std::pmr::string(memory), memory);
+    for (size_t i = 0; i < keyCount; ++i) {
+        PrefixEnd(typos[i].key, ends[i]);
+        sqlite3_bind_text(stmt, (int)(2 * i + 1), typos[i].key.c_str(), (int)typos[i].key.length(), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, (int)(2 * i + 2), ends[i].c_str(), (int)ends[i].length(), SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, (int)(2 * keyCount + 1), limit * 2);
+
+    // (cost, row, word) in SQL order; sorting on the row as well keeps
+    // priority order per cost without std::stable_sort's buffer
+    struct TypoHit
+    {
+        int cost;
+        uint32_t row;
+        uint32_t word;
+        bool operator<(const TypoHit& other) const { return cost != other.cost ? cost < other.cost : row < other.row; }
+    };
+    std::pmr::vector<TypoHit> ranked(memory);
+    ranked.reserve((size_t)limit * 2);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char* text = sqlite3_column_text(stmt, 0);
+        const unsigned char* clean = sqlite3_column_text(stmt, 1);
+        if (!text || !clean) continue;
+
+        int cost = Config::Dictionary::TYPO_MAX_COST + 1;
+        for (size_t i = 0; i < keyCount; ++i)
         {
-            DebugLog(L"  Result %d: %s", i, results[i].c_str());
+            const TypoCandidate& typo = typos[i];
+            if (strncmp((const char*)clean, typo.key.c_str(), typo.key.length()) == 0 && typo.cost < cost)
+                cost = typo.cost;
         }
+
+        wchar_t hanziW[128];
+        int length = MultiByteToWideChar(CP_UTF8, 0, (const char*)text, -1, hanziW, 128);
+        if (length <= 1) continue;
+        TypoHit hit = { cost, (uint32_t)ranked.size(), CCandidatePool::Instance().Intern(hanziW, length - 1) };
+        ranked.push_back(hit);
+    }
+    sqlite3_reset(stmt);
+
+    std::sort(ranked.begin(), ranked.end());
+
+    int added = 0;
+    for (size_t i = 0; i < ranked.size() && added < limit; ++i)
+    {
+        if (results.Add(ranked[i].word)) added++;
+    }
+    DebugTrace(L"Query: Typo keys added %d candidates", added);
+}
+
+bool CDictionaryEngine::Query(const std::wstring& pinyin, QueryCursor& cursor, CCandidateList& results)
+{
+    results.Clear();
+    cursor.inputLength = pinyin.length();
+    cursor.searchKeyCount = 0;
+    cursor.userStream.Clear();
+    cursor.userNext = 0;
+    cursor.started = false;
+    cursor.lexiconDone = true;
+    cursor.exhausted = true;
+    cursor.arena.ResetPeak();
+
+    if (pinyin.empty()) return false;
+    if (!IsReady())
+    {
+        // The hot-word table has a single page
+        _QueryHotWords(pinyin, results);
+        return false;
+    }
+
+    std::string& corrected = cursor.key;
+    if (!_MakeKey(pinyin, corrected))
+    {
+        DebugLog(L"Query: Input '%s' is not an ASCII key of at most %d chars", pinyin.c_str(), Config::Dictionary::MAX_KEY_LENGTH);
+        return false;
+    }
+
+    // Consonants only ("zg", "zhg") is an abbreviation: match its readings
+    // against the initials alone. A key that splits into syllables only if
+    // some stand for their initial ("nhao") searches the initials of those
+    // readings and keeps the rows that match one of them. Anything else
+    // matches the full pinyin through all fuzzy variants (including
+    // auto-corrected), at most the configured number for performance.
+    const size_t maxKeys = Config::Dictionary::MAX_FUZZY_VARIANTS;
+    size_t keyCount = GetInitialsKeys(corrected, cursor.searchKeys, maxKeys);
+    cursor.readingCount = 0;
+    if (keyCount == 0)
+    {
+        cursor.readingCount = GetMixedReadings(corrected.data(), corrected.length(), cursor.readings, maxKeys, &cursor.arena);
+        keyCount = GetMixedSearchKeys(cursor.readings, cursor.readingCount, cursor.searchKeys);
+    }
+    cursor.mode = cursor.readingCount > 0 ? QUERY_MIXED : keyCount > 0 ? QUERY_INITIALS : QUERY_PINYIN;
+    if (cursor.mode == QUERY_PINYIN) keyCount = GetFuzzyVariants(corrected, cursor.searchKeys);
+    if (keyCount > maxKeys) keyCount = maxKeys;
+    cursor.searchKeyCount = keyCount;
+    if (cursor.searchEnds.size() < keyCount) cursor.searchEnds.resize(keyCount);
+    for (size_t i = 0; i < keyCount; ++i) PrefixEnd(cursor.searchKeys[i], cursor.searchEnds[i]);
+
+    DebugTrace(L"Query: Input pinyin='%s', key='%S', %d %s", pinyin.c_str(), corrected.c_str(), keyCount,
+               cursor.mode == QUERY_INITIALS ? L"initials readings" :
+               cursor.mode == QUERY_MIXED ? L"mixed initials ranges" : L"fuzzy variants");
+
+    // The overlay is small and in memory: read it whole, merge it batch by batch
+    if (cursor.mode == QUERY_MIXED)
+    {
+        _history.FindMixedWords(corrected, cursor.readings.data(), cursor.readingCount, cursor.userStream);
     }
     else
     {
-        DebugLog(L"Query: SQL prepare failed: %S", sqlite3_errmsg(_db));
+        for (size_t i = 0; i < keyCount; ++i)
+        {
+            _history.FindWords(cursor.searchKeys[i], cursor.mode == QUERY_INITIALS, cursor.userStream);
+        }
+    }
+    SortRankedStream(cursor.userStream);
+
+    _FetchBatch(cursor, results);
+
+    // Too few hits: the key is probably mistyped. Look for nearby keys under
+    // a fixed work budget and append their candidates below the exact ones,
+    // cheapest correction first. Abbreviations are not spelled, so they
+    // have no typos to correct; a key read as mixed may be a misspelling.
+    if (cursor.mode != QUERY_INITIALS && cursor.exhausted &&
+        results.Size() < (size_t)Config::Dictionary::TYPO_TRIGGER_RESULTS)
+    {
+        TypoSearchLimits limits;
+        limits.maxCost = Config::Dictionary::TYPO_MAX_COST;
+        limits.workBudget = Config::Dictionary::TYPO_WORK_BUDGET;
+        limits.maxResults = Config::Dictionary::TYPO_MAX_KEYS;
+
+        std::pmr::vector<TypoCandidate> typos(&cursor.arena);
+        TypoSearchResult search = FindTypoCorrections(corrected.data(), corrected.length(), limits, typos);
+        DebugTrace(L"Query: Typo search for '%S': %d keys, work %d%s", corrected.c_str(), typos.size(), search.work,
+                   search.exhausted ? L" (budget exhausted)" : L"");
+
+        for (size_t i = 0; i < typos.size(); ++i)
+        {
+            DebugTrace(L"  Typo key %d: %S (cost %d)", i, typos[i].key.c_str(), typos[i].cost);
+        }
+        _QueryTypoKeys(typos, Config::Dictionary::QUERY_BATCH_SIZE - (int)results.Size(), results, &cursor.arena);
     }
 
-    return results;
+    _ApplyUserHistory(cursor, results, 0);
+    cursor.arena.NoteLength(cursor.inputLength);
+
+    return !cursor.exhausted;
+}
+
+bool CDictionaryEngine::QueryMore(QueryCursor& cursor, CCandidateList& results)
+{
+    if (cursor.exhausted) return false;
+
+    // Learned counts reorder candidates within their batch only, so the
+    // pages already shown keep their order
+    size_t first = results.Size();
+    cursor.arena.ResetPeak();
+    _FetchBatch(cursor, results);
+    _ApplyUserHistory(cursor, results, first);
+    cursor.arena.NoteLength(cursor.inputLength);
+    return !cursor.exhausted;
+}
+
+void CDictionaryEngine::EndComposition(QueryCursor& cursor)
+{
+    DebugTrace(L"Query: Composition arena held %d bytes at the end, %d at most in its last query (%d reserved)",
+               cursor.arena.Used(), cursor.arena.Peak(), cursor.arena.Reserved());
+    cursor.arena.Reset();
 }
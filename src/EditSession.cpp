@@ -40,13 +40,32 @@ STDMETHODIMP_(ULONG) CEditSessionBase::Release()
 }
 
 // CUpdateCompositionEditSession
-CUpdateCompositionEditSession::CUpdateCompositionEditSession(CTextService *pTextService, ITfContext *pContext, const std::wstring &text)
-    : CEditSessionBase(pTextService, pContext), _text(text)
+CUpdateCompositionEditSession::CUpdateCompositionEditSession(CTextService *pTextService, ITfContext *pContext)
+    : CEditSessionBase(pTextService, pContext)
 {
 }
 
 STDMETHODIMP CUpdateCompositionEditSession::DoEditSession(TfEditCookie ec)
 {
+    // Cancelled (composition terminated, another context) while queued
+    if (_pTextService->_pPendingUpdate != this)
+    {
+        DebugLog(L"CUpdateCompositionEditSession: Cancelled");
+        return S_OK;
+    }
+    if (_pTextService->_coalescedUpdates > 0)
+    {
+        DebugLog(L"CUpdateCompositionEditSession: Applying %d coalesced updates", _pTextService->_coalescedUpdates);
+    }
+    _pTextService->_CancelPendingUpdate();
+
+    // Committed or cancelled since the request; nothing left to show
+    const std::wstring& text = _pTextService->_composer.Composition();
+    if (text.empty())
+    {
+        return S_OK;
+    }
+
     // If no composition, start one
     if (_pTextService->_pComposition == NULL)
     {
@@ -98,7 +117,7 @@ STDMETHODIMP CUpdateCompositionEditSession::DoEditSession(TfEditCookie ec)
         HRESULT hr = _pTextService->_pComposition->GetRange(&pRange);
         if (SUCCEEDED(hr) && pRange)
         {
-            hr = pRange->SetText(ec, 0, _text.c_str(), (LONG)_text.length());
+            hr = pRange->SetText(ec, 0, text.c_str(), (LONG)text.length());
             DebugLog(L"CUpdateCompositionEditSession: SetText returned hr=0x%08X", hr);
             
             // Adjust selection to end of composition
@@ -124,9 +143,53 @@ STDMETHODIMP CUpdateCompositionEditSession::DoEditSession(TfEditCookie ec)
     {
         DebugLog(L"CUpdateCompositionEditSession: _pComposition is still NULL after StartComposition");
     }
+
+    // Place the candidate window in the same session instead of a second
+    // round trip to the application
+    RECT rcText = _GetTextRect(ec);
+    _pTextService->_UpdateCandidateWindow(_pContext, &rcText);
     return S_OK;
 }
 
+// Screen extent of the composition, or of the selection if there is none.
+// Empty if the application cannot tell.
+RECT CUpdateCompositionEditSession::_GetTextRect(TfEditCookie ec)
+{
+    RECT rc = {0, 0, 0, 0};
+    ITfContextView *pView;
+    if (FAILED(_pContext->GetActiveView(&pView)))
+    {
+        return rc;
+    }
+
+    ITfRange *pRange = NULL;
+    if (_pTextService->_pComposition)
+    {
+        _pTextService->_pComposition->GetRange(&pRange);
+    }
+    else
+    {
+        TF_SELECTION tfSelection;
+        ULONG cFetched;
+        if (SUCCEEDED(_pContext->GetSelection(ec, TF_DEFAULT_SELECTION, 1, &tfSelection, &cFetched)) && cFetched > 0)
+        {
+            pRange = tfSelection.range;
+        }
+    }
+
+    if (pRange)
+    {
+        BOOL fClipped;
+        if (FAILED(pView->GetTextExt(ec, pRange, &rc, &fClipped)))
+        {
+            memset(&rc, 0, sizeof(rc));
+        }
+        pRange->Release();
+    }
+    pView->Release();
+    return rc;
+}
+
 // CEndCompositionEditSession
 CEndCompositionEditSession::CEndCompositionEditSession(CTextService *pTextService, ITfContext *pContext)
     : CEditSessionBase(pTextService, pContext)
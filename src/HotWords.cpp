@@ -0,0 +1,86 @@
+#include "HotWords.h"
+#include <algorithm>
+#include <cstring>
+
+struct HotWord
+{
+    const char* key;
+    const wchar_t* text;
+};
+
+// Most frequent characters of modern written Chinese in frequency order,
+// then everyday words; readings checked against src/pinyin.txt.
+static const HotWord kHotWords[] = {
+    { "de", L"的" }, { "yi", L"一" }, { "shi", L"是" }, { "bu", L"不" }, { "le", L"了" }, { "zai", L"在" }, { "ren", L"人" }, { "you", L"有" },
+    { "wo", L"我" }, { "ta", L"他" }, { "zhe", L"这" }, { "ge", L"个" }, { "men", L"们" }, { "zhong", L"中" }, { "lai", L"来" }, { "shang", L"上" },
+    { "da", L"大" }, { "wei", L"为" }, { "he", L"和" }, { "guo", L"国" }, { "di", L"地" }, { "dao", L"到" }, { "yi", L"以" }, { "shuo", L"说" },
+    { "shi", L"时" }, { "yao", L"要" }, { "jiu", L"就" }, { "chu", L"出" }, { "hui", L"会" }, { "ke", L"可" }, { "ye", L"也" }, { "ni", L"你" },
+    { "dui", L"对" }, { "sheng", L"生" }, { "neng", L"能" }, { "er", L"而" }, { "zi", L"子" }, { "na", L"那" }, { "de", L"得" }, { "yu", L"于" },
+    { "zhe", L"着" }, { "xia", L"下" }, { "zi", L"自" }, { "zhi", L"之" }, { "nian", L"年" }, { "guo", L"过" }, { "fa", L"发" }, { "hou", L"后" },
+    { "zuo", L"作" }, { "li", L"里" }, { "yong", L"用" }, { "dao", L"道" }, { "xing", L"行" }, { "suo", L"所" }, { "ran", L"然" }, { "jia", L"家" },
+    { "zhong", L"种" }, { "shi", L"事" }, { "cheng", L"成" }, { "fang", L"方" }, { "duo", L"多" }, { "jing", L"经" }, { "me", L"么" }, { "qu", L"去" },
+    { "fa", L"法" }, { "xue", L"学" }, { "ru", L"如" }, { "dou", L"都" }, { "tong", L"同" }, { "xian", L"现" }, { "dang", L"当" }, { "mei", L"没" },
+    { "dong", L"动" }, { "mian", L"面" }, { "qi", L"起" }, { "kan", L"看" }, { "ding", L"定" }, { "tian", L"天" }, { "fen", L"分" }, { "hai", L"还" },
+    { "jin", L"进" }, { "hao", L"好" }, { "xiao", L"小" }, { "bu", L"部" }, { "qi", L"其" }, { "xie", L"些" }, { "zhu", L"主" }, { "yang", L"样" },
+    { "li", L"理" }, { "xin", L"心" }, { "ta", L"她" }, { "ben", L"本" }, { "qian", L"前" }, { "kai", L"开" }, { "dan", L"但" }, { "yin", L"因" },
+    { "zhi", L"只" }, { "cong", L"从" }, { "xiang", L"想" }, { "shi", L"实" }, { "ri", L"日" }, { "zhe", L"者" }, { "yi", L"意" }, { "wu", L"无" },
+    { "li", L"力" }, { "ta", L"它" }, { "yu", L"与" }, { "chang", L"长" }, { "ba", L"把" }, { "ji", L"机" }, { "shi", L"十" }, { "min", L"民" },
+    { "di", L"第" }, { "gong", L"公" }, { "ci", L"此" }, { "yi", L"已" }, { "gong", L"工" }, { "shi", L"使" }, { "qing", L"情" }, { "ming", L"明" },
+    { "xing", L"性" }, { "zhi", L"知" }, { "quan", L"全" }, { "san", L"三" }, { "you", L"又" }, { "guan", L"关" }, { "dian", L"点" }, { "zheng", L"正" },
+    { "ye", L"业" }, { "wai", L"外" }, { "jiang", L"将" }, { "liang", L"两" }, { "gao", L"高" }, { "jian", L"间" }, { "wen", L"问" }, { "hen", L"很" },
+    { "zui", L"最" }, { "zhong", L"重" }, { "wu", L"物" }, { "shou", L"手" }, { "ying", L"应" }, { "xiang", L"向" }, { "tou", L"头" }, { "wen", L"文" },
+    { "ti", L"体" }, { "xiang", L"相" }, { "jian", L"见" }, { "bei", L"被" }, { "shen", L"什" }, { "er", L"二" }, { "deng", L"等" }, { "huo", L"或" },
+    { "xin", L"新" }, { "shen", L"身" }, { "jia", L"加" }, { "yue", L"月" }, { "hua", L"话" }, { "hui", L"回" }, { "gei", L"给" }, { "lao", L"老" },
+    { "ci", L"次" }, { "men", L"门" }, { "xian", L"先" }, { "tong", L"通" }, { "er", L"儿" }, { "dong", L"东" }, { "bi", L"比" }, { "shui", L"水" },
+    { "ming", L"名" }, { "zhen", L"真" }, { "zou", L"走" }, { "ji", L"几" }, { "kou", L"口" }, { "ping", L"平" }, { "qi", L"气" }, { "ti", L"题" },
+    { "geng", L"更" }, { "bie", L"别" }, { "da", L"打" }, { "nv", L"女" }, { "dian", L"电" }, { "an", L"安" }, { "shao", L"少" }, { "tai", L"太" },
+    { "zai", L"再" }, { "zuo", L"做" }, { "ma", L"吗" }, { "ne", L"呢" }, { "ba", L"吧" }, { "a", L"啊" }, { "nin", L"您" }, { "zen", L"怎" },
+    { "na", L"哪" }, { "shui", L"谁" }, { "ai", L"爱" }, { "chi", L"吃" }, { "mai", L"买" }, { "qing", L"请" }, { "xie", L"谢" }, { "kuai", L"快" },
+    { "che", L"车" }, { "qian", L"钱" }, { "shu", L"书" }, { "lu", L"路" }, { "zi", L"字" }, { "fan", L"饭" }, { "he", L"喝" }, { "wan", L"玩" },
+    { "xiao", L"笑" }, { "zhao", L"找" }, { "xie", L"写" }, { "du", L"读" }, { "ting", L"听" }, { "zhu", L"住" }, { "zuo", L"坐" }, { "rang", L"让" },
+    { "jiao", L"叫" }, { "gen", L"跟" }, { "bang", L"帮" }, { "cuo", L"错" }, { "re", L"热" }, { "leng", L"冷" }, { "lei", L"累" }, { "mang", L"忙" },
+    { "wan", L"晚" }, { "zao", L"早" }, { "o", L"哦" }, { "e", L"俄" }, { "e", L"额" },
+
+    { "women", L"我们" }, { "nimen", L"你们" }, { "tamen", L"他们" }, { "shenme", L"什么" }, { "meiyou", L"没有" },
+    { "yige", L"一个" }, { "zhege", L"这个" }, { "nage", L"那个" }, { "keyi", L"可以" }, { "zhidao", L"知道" },
+    { "xianzai", L"现在" }, { "shihou", L"时候" }, { "yinwei", L"因为" }, { "suoyi", L"所以" }, { "danshi", L"但是" },
+    { "ruguo", L"如果" }, { "ziji", L"自己" }, { "yijing", L"已经" }, { "haishi", L"还是" }, { "jiushi", L"就是" },
+    { "nihao", L"你好" }, { "xiexie", L"谢谢" }, { "bushi", L"不是" }, { "wenti", L"问题" }, { "gongzuo", L"工作" },
+    { "zhongguo", L"中国" }, { "jintian", L"今天" }, { "mingtian", L"明天" }, { "shijian", L"时间" }, { "juede", L"觉得" },
+    { "zheyang", L"这样" }, { "zenme", L"怎么" }, { "weishenme", L"为什么" }, { "yixia", L"一下" }, { "yiqi", L"一起" },
+    { "xihuan", L"喜欢" }, { "pengyou", L"朋友" }, { "dajia", L"大家" }, { "xuyao", L"需要" }, { "yinggai", L"应该" },
+    { "qilai", L"起来" }, { "laoshi", L"老师" }, { "dianhua", L"电话" }, { "gongsi", L"公司" }, { "kaishi", L"开始" },
+    { "buyao", L"不要" }, { "haode", L"好的" }, { "duibuqi", L"对不起" }, { "meiguanxi", L"没关系" }, { "shurufa", L"输入法" },
+};
+
+static const size_t kHotWordCount = sizeof(kHotWords) / sizeof(kHotWords[0]);
+
+size_t LookupHotWords(const char* key, size_t len, const wchar_t** out, size_t max)
+{
+    if (len == 0 || max == 0) return 0;
+
+    // Prefix matches, shortest key first like the lexicon query, table
+    // order (frequency) within a length
+    size_t matches[kHotWordCount];
+    size_t count = 0;
+    for (size_t i = 0; i < kHotWordCount; ++i)
+    {
+        if (strncmp(kHotWords[i].key, key, len) == 0) matches[count++] = i;
+    }
+    std::stable_sort(matches, matches + count,
+        [](size_t a, size_t b) { return strlen(kHotWords[a].key) < strlen(kHotWords[b].key); });
+
+    size_t n = count < max ? count : max;
+    for (size_t i = 0; i < n; ++i) out[i] = kHotWords[matches[i]].text;
+    return n;
+}
+
+size_t HotWordCount()
+{
+    return kHotWordCount;
+}
+
+const char* HotWordKey(size_t index)
+{
+    return index < kHotWordCount ? kHotWords[index].key : "";
+}
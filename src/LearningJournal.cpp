@@ -0,0 +1,238 @@
+#include "LearningJournal.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char kJournalMagic[4] = { 'U', 'T', 'J', '1' };
+static const size_t kRecordHeader = 8;
+
+// ---------------------------------------------------------
+// CRC-32 (IEEE, reflected)
+// ---------------------------------------------------------
+
+struct Crc32Table
+{
+    uint32_t entries[256];
+
+    Crc32Table()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+    }
+};
+
+static uint32_t Crc32(uint32_t crc, const unsigned char* data, size_t len)
+{
+    static const Crc32Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void PutU32(unsigned char* out, uint32_t value)
+{
+    out[0] = (unsigned char)value;
+    out[1] = (unsigned char)(value >> 8);
+    out[2] = (unsigned char)(value >> 16);
+    out[3] = (unsigned char)(value >> 24);
+}
+
+static uint32_t GetU32(const unsigned char* in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static uint32_t RecordCrc(const unsigned char* lengthBytes, const char* payload, size_t len)
+{
+    return Crc32(Crc32(0, lengthBytes, 4), (const unsigned char*)payload, len);
+}
+
+// ---------------------------------------------------------
+// File helpers
+// ---------------------------------------------------------
+
+static FILE* OpenFile(const JournalPath& path, const char* mode)
+{
+#ifdef _WIN32
+    wchar_t wideMode[8] = {};
+    for (size_t i = 0; mode[i] && i < 7; ++i) wideMode[i] = (wchar_t)mode[i];
+    return _wfopen(path.c_str(), wideMode);
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+static bool TruncateFile(FILE* file, size_t size)
+{
+    fflush(file);
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), (long long)size) == 0;
+#else
+    return ftruncate(fileno(file), (off_t)size) == 0;
+#endif
+}
+
+// ---------------------------------------------------------
+// CLearningJournal
+// ---------------------------------------------------------
+
+CLearningJournal::CLearningJournal() : _file(NULL), _fileSize(0)
+{
+}
+
+CLearningJournal::~CLearningJournal()
+{
+    Close();
+}
+
+void CLearningJournal::Close()
+{
+    if (_file)
+    {
+        fclose(_file);
+        _file = NULL;
+    }
+    _fileSize = 0;
+}
+
+long CLearningJournal::Open(const JournalPath& path, const std::function<void(const char*, size_t)>& replay)
+{
+    Close();
+
+    // Read what is there; a missing file is an empty journal
+    std::vector<char> data;
+    if (FILE* in = OpenFile(path, "rb"))
+    {
+        char chunk[64 * 1024];
+        size_t got;
+        while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) data.insert(data.end(), chunk, chunk + got);
+        fclose(in);
+    }
+
+    // Walk the records up to the first one that does not check out
+    long replayed = 0;
+    size_t valid = 0;
+    if (data.size() >= sizeof(kJournalMagic) && memcmp(data.data(), kJournalMagic, sizeof(kJournalMagic)) == 0)
+    {
+        valid = sizeof(kJournalMagic);
+        while (data.size() - valid >= kRecordHeader)
+        {
+            const unsigned char* header = (const unsigned char*)data.data() + valid;
+            size_t len = GetU32(header);
+            if (len > MAX_JOURNAL_RECORD || data.size() - valid - kRecordHeader < len) break;
+
+            const char* payload = data.data() + valid + kRecordHeader;
+            if (RecordCrc(header, payload, len) != GetU32(header + 4)) break;
+
+            replay(payload, len);
+            replayed++;
+            valid += kRecordHeader + len;
+        }
+    }
+
+    // Rewrite the header if it was missing or damaged, else cut the torn tail
+    _file = OpenFile(path, valid == 0 ? "wb" : "r+b");
+    if (!_file) return -1;
+    if (valid == 0)
+    {
+        if (fwrite(kJournalMagic, 1, sizeof(kJournalMagic), _file) != sizeof(kJournalMagic) || !_Sync())
+        {
+            Close();
+            return -1;
+        }
+        valid = sizeof(kJournalMagic);
+    }
+    else if (valid < data.size())
+    {
+        if (!TruncateFile(_file, valid) || !_Sync())
+        {
+            Close();
+            return -1;
+        }
+    }
+    fseek(_file, 0, SEEK_END);
+    _fileSize = valid;
+    return replayed;
+}
+
+void CLearningJournal::Append(const std::string& payload)
+{
+    if (!_file || payload.size() > MAX_JOURNAL_RECORD) return;
+
+    unsigned char header[kRecordHeader];
+    PutU32(header, (uint32_t)payload.size());
+    PutU32(header + 4, RecordCrc(header, payload.data(), payload.size()));
+
+    std::lock_guard<std::mutex> guard(_lock);
+    _pending.append((const char*)header, kRecordHeader);
+    _pending.append(payload);
+}
+
+bool CLearningJournal::Commit()
+{
+    std::string group;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        group.swap(_pending);
+    }
+    if (group.empty()) return true;
+    if (!_file) return false;
+
+    if (fwrite(group.data(), 1, group.size(), _file) == group.size() && _Sync())
+    {
+        _fileSize += group.size();
+        return true;
+    }
+
+    // Drop the partial write so the next group starts on a record boundary,
+    // and keep the group for another attempt
+    TruncateFile(_file, _fileSize);
+    fseek(_file, 0, SEEK_END);
+    std::lock_guard<std::mutex> guard(_lock);
+    _pending.insert(0, group);
+    return false;
+}
+
+bool CLearningJournal::Reset()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _pending.clear();
+    }
+    if (!_file) return false;
+    if (!TruncateFile(_file, sizeof(kJournalMagic)) || !_Sync()) return false;
+    fseek(_file, 0, SEEK_END);
+    _fileSize = sizeof(kJournalMagic);
+    return true;
+}
+
+size_t CLearningJournal::Size() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _fileSize + _pending.size();
+}
+
+bool CLearningJournal::HasPending() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return !_pending.empty();
+}
+
+bool CLearningJournal::_Sync()
+{
+    if (fflush(_file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(_file)) == 0;
+#else
+    return fsync(fileno(_file)) == 0;
+#endif
+}
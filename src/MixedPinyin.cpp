@@ -0,0 +1,213 @@
+#include "MixedPinyin.h"
+#include "PinyinSyllables.h"
+#include <algorithm>
+#include <cstring>
+
+// ---------------------------------------------------------
+// Segmentation lattice
+// ---------------------------------------------------------
+
+// A piece that starts at the position it is listed under and ends at `end`.
+struct LatticeEdge
+{
+    unsigned char end;
+    bool whole;
+};
+
+static const unsigned short kUnreachable = 0xffff;
+
+// Edges tried by the path search per key. Pruning keeps it to a few per
+// piece; the cap only guards against pathological keys.
+static const size_t kMaxLatticeSteps = 4096;
+
+size_t GetMixedReadings(const char* key, size_t len, std::vector<MixedReading>& readings, size_t max,
+                        std::pmr::memory_resource* memory)
+{
+    if (len == 0 || len > MAX_MIXED_KEY_LENGTH || max == 0) return 0;
+
+    // Edges of position i are edges[firstEdge[i], firstEdge[i + 1]): whole
+    // syllables longest first, then initials, then an unfinished syllable
+    // that runs to the end of the key
+    std::pmr::vector<LatticeEdge> edges(memory);
+    std::pmr::vector<unsigned short> firstEdge(len + 1, 0, memory);
+    edges.reserve(len * 3);
+    for (size_t i = 0; i < len; ++i)
+    {
+        firstEdge[i] = (unsigned short)edges.size();
+
+        unsigned char wholeEnds[MAX_SYLLABLE_LENGTH];
+        size_t wholeCount = 0;
+        size_t node = 0;
+        size_t j = i;
+        while (j < len && j - i < MAX_SYLLABLE_LENGTH)
+        {
+            node = SyllableTrieStep(node, key[j]);
+            if (node == 0) break;
+            j++;
+            if (SyllableTrieIsTerminal(node)) wholeEnds[wholeCount++] = (unsigned char)j;
+        }
+        bool unfinishedToEnd = node != 0 && j == len;
+        for (size_t w = wholeCount; w > 0; --w) edges.push_back({ wholeEnds[w - 1], true });
+        bool endCovered = wholeCount > 0 && wholeEnds[wholeCount - 1] == len;
+
+        // zh, ch and sh read as one initial or as two
+        size_t initial = PinyinInitialLength(key + i, len - i);
+        if (initial == 2) edges.push_back({ (unsigned char)(i + 2), false });
+        if (initial >= 1) edges.push_back({ (unsigned char)(i + 1), false });
+        endCovered = endCovered || (initial >= 1 && i + initial == len);
+
+        if (unfinishedToEnd && !endCovered) edges.push_back({ (unsigned char)len, false });
+    }
+    firstEdge[len] = (unsigned short)edges.size();
+
+    // Backwards over the lattice: whether the rest of the key reads as full
+    // pinyin (whole syllables, any piece last), and the fewest and most
+    // pieces it can be split into
+    std::pmr::vector<unsigned char> full(len + 1, 0, memory);
+    std::pmr::vector<unsigned short> fewest(len + 1, kUnreachable, memory);
+    std::pmr::vector<unsigned short> most(len + 1, 0, memory);
+    full[len] = 1;
+    fewest[len] = 0;
+    for (size_t i = len; i-- > 0;)
+    {
+        for (size_t e = firstEdge[i]; e < firstEdge[i + 1]; ++e)
+        {
+            size_t end = edges[e].end;
+            if (end == len || (edges[e].whole && full[end])) full[i] = 1;
+            if (fewest[end] == kUnreachable) continue;
+            fewest[i] = std::min(fewest[i], (unsigned short)(fewest[end] + 1));
+            most[i] = std::max(most[i], (unsigned short)(most[end] + 1));
+        }
+    }
+
+    // Full pinyin is the prefix query's; a key nothing covers is left to
+    // typo correction
+    if (full[0] || fewest[0] == kUnreachable) return 0;
+
+    // Paths of each length in turn, depth first, following only edges from
+    // which the end can still be reached in exactly that many pieces
+    std::pmr::vector<unsigned short> path(memory);
+    path.reserve(len);
+    size_t count = 0;
+    size_t steps = 0;
+    for (size_t target = fewest[0]; target <= most[0] && count < max && steps < kMaxLatticeSteps; ++target)
+    {
+        path.clear();
+        size_t at = 0;
+        size_t next = firstEdge[0];
+        while (count < max && ++steps < kMaxLatticeSteps)
+        {
+            size_t depth = path.size() + 1;
+            size_t e = next;
+            while (e < firstEdge[at + 1])
+            {
+                size_t end = edges[e].end;
+                if (fewest[end] != kUnreachable && depth + fewest[end] <= target && depth + most[end] >= target) break;
+                e++;
+            }
+
+            bool descend = e < firstEdge[at + 1];
+            if (descend)
+            {
+                path.push_back((unsigned short)e);
+                at = edges[e].end;
+                next = firstEdge[at];
+                if (at < len) continue;
+
+                if (readings.size() <= count) readings.resize(count + 1);
+                MixedReading& reading = readings[count++];
+                reading.initials.clear();
+                reading.pieces.clear();
+                size_t start = 0;
+                for (unsigned short edge : path)
+                {
+                    MixedPiece piece = { (unsigned char)start, (unsigned char)(edges[edge].end - start), edges[edge].whole };
+                    reading.pieces.push_back(piece);
+                    reading.initials += key[start];
+                    start = edges[edge].end;
+                }
+            }
+
+            // Back up to the next edge after the last one taken
+            if (path.empty()) break;
+            next = path.back() + 1;
+            path.pop_back();
+            at = path.empty() ? 0 : edges[path.back()].end;
+        }
+    }
+    return count;
+}
+
+// Readings come fewest pieces first, so the shorter initials that cover
+// the others are usually already in place
+size_t GetMixedSearchKeys(const std::vector<MixedReading>& readings, size_t readingCount, std::vector<std::string>& keys)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < readingCount; ++i)
+    {
+        const std::string& initials = readings[i].initials;
+        bool covered = false;
+        for (size_t k = 0; k < count && !covered; ++k)
+        {
+            covered = initials.compare(0, keys[k].length(), keys[k]) == 0;
+        }
+        if (covered) continue;
+
+        // Drop ranges the new one covers
+        size_t kept = 0;
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (keys[k].compare(0, initials.length(), initials) != 0) keys[kept++].swap(keys[k]);
+        }
+        count = kept;
+
+        if (keys.size() <= count) keys.resize(count + 1);
+        keys[count++].assign(initials);
+    }
+    return count;
+}
+
+// ---------------------------------------------------------
+// Matching
+// ---------------------------------------------------------
+
+static bool MatchPieces(const char* key, const MixedPiece* piece, size_t count, const char* pinyin, size_t pinyinLength,
+                        size_t at, const char* initials, size_t initialsLength, size_t syllable)
+{
+    if (pinyinLength - at < piece->length || memcmp(pinyin + at, key + piece->start, piece->length) != 0) return false;
+    if (count == 1) return true;
+    if (syllable + 1 >= initialsLength) return false;
+
+    const char next = initials[syllable + 1];
+    if (piece->whole)
+    {
+        size_t end = at + piece->length;
+        return end < pinyinLength && pinyin[end] == next &&
+               MatchPieces(key, piece + 1, count - 1, pinyin, pinyinLength, end, initials, initialsLength, syllable + 1);
+    }
+
+    // An initial: its syllable is any that continues the letters and is
+    // followed by the word's next initial
+    size_t node = 0;
+    size_t end = at;
+    while (end < pinyinLength && end - at < MAX_SYLLABLE_LENGTH)
+    {
+        node = SyllableTrieStep(node, pinyin[end]);
+        if (node == 0) break;
+        end++;
+        if (end >= at + piece->length && end < pinyinLength && pinyin[end] == next && SyllableTrieIsTerminal(node) &&
+            MatchPieces(key, piece + 1, count - 1, pinyin, pinyinLength, end, initials, initialsLength, syllable + 1))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MatchesMixedReading(const char* key, const MixedReading& reading, const char* pinyin, size_t pinyinLength,
+                         const char* initials, size_t initialsLength)
+{
+    if (reading.pieces.empty() || reading.pieces.size() > initialsLength) return false;
+    return MatchPieces(key, reading.pieces.data(), reading.pieces.size(), pinyin, pinyinLength, 0, initials,
+                       initialsLength, 0);
+}
@@ -0,0 +1,77 @@
+#include "PagePrefetch.h"
+#include "Globals.h"
+
+// Declared by hand so the DLL still loads on Windows 7, where the function
+// does not exist.
+struct PrefetchRange
+{
+    PVOID VirtualAddress;
+    SIZE_T NumberOfBytes;
+};
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFn)(HANDLE, ULONG_PTR, PrefetchRange*, ULONG);
+
+ULONGLONG PrefetchFileRanges(const std::wstring& path, const std::vector<FileRange>& ranges)
+{
+    if (ranges.empty()) return 0;
+
+    HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                             OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        DebugLog(L"Prefetch: Cannot open %s, error=%d", path.c_str(), GetLastError());
+        return 0;
+    }
+
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    const BYTE* view = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+        mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) view = (const BYTE*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!view)
+    {
+        DebugLog(L"Prefetch: Cannot map %s, error=%d", path.c_str(), GetLastError());
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return 0;
+    }
+
+    // Clip to the file; a hot set recorded for a different build of the
+    // lexicon must not fault past the end of the view
+    std::vector<PrefetchRange> entries;
+    ULONGLONG covered = 0;
+    for (const FileRange& range : ranges)
+    {
+        if (range.offset >= (ULONGLONG)size.QuadPart) continue;
+        ULONGLONG available = (ULONGLONG)size.QuadPart - range.offset;
+        ULONGLONG length = range.length < available ? range.length : available;
+        PrefetchRange entry = { (PVOID)(view + range.offset), (SIZE_T)length };
+        entries.push_back(entry);
+        covered += length;
+    }
+
+    static PrefetchVirtualMemoryFn prefetch =
+        (PrefetchVirtualMemoryFn)GetProcAddress(GetModuleHandle(L"kernel32.dll"), "PrefetchVirtualMemory");
+    if (prefetch && !entries.empty())
+    {
+        prefetch(GetCurrentProcess(), entries.size(), entries.data(), 0);
+    }
+
+    // Touch one byte per page: waits for the prefetch where it ran, and does
+    // the reads where it did not
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    volatile BYTE sink = 0;
+    for (const PrefetchRange& entry : entries)
+    {
+        const BYTE* start = (const BYTE*)entry.VirtualAddress;
+        for (SIZE_T offset = 0; offset < entry.NumberOfBytes; offset += info.dwPageSize) sink ^= start[offset];
+    }
+
+    UnmapViewOfFile(view);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return covered;
+}
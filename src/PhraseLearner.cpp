@@ -0,0 +1,143 @@
+#include "PhraseLearner.h"
+#include "PinyinSyllables.h"
+#include <algorithm>
+
+// Characters in `text`, counting a surrogate pair once.
+static size_t CountChars(const std::wstring& text)
+{
+    size_t chars = 0;
+    for (wchar_t ch : text)
+    {
+        if (ch < 0xDC00 || ch > 0xDFFF) chars++;
+    }
+    return chars;
+}
+
+// True if `key` splits into exactly `count` complete syllables. "xian" can
+// be one syllable or two (xi'an), so this asks about a given count rather
+// than taking a single segmentation.
+static bool SplitsIntoSyllables(const std::string& key, size_t count)
+{
+    const size_t len = key.length();
+    if (count == 0 || count >= 64 || len == 0 || len > count * MAX_SYLLABLE_LENGTH) return false;
+
+    // reach[i] has bit n set when key[0..i) splits into n syllables
+    std::vector<unsigned long long> reach(len + 1, 0);
+    reach[0] = 1;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (!reach[i]) continue;
+        for (size_t n = 1; n <= MAX_SYLLABLE_LENGTH && i + n <= len; ++n)
+        {
+            if (IsPinyinSyllable(key.data() + i, n)) reach[i + n] |= reach[i] << 1;
+        }
+    }
+    return (reach[len] >> count) & 1;
+}
+
+CPhraseLearner::CPhraseLearner(const PhraseLearnerLimits& limits)
+    : _limits(limits), _lastCommitMs(0), _tick(0)
+{
+}
+
+void CPhraseLearner::Break()
+{
+    _run.clear();
+}
+
+size_t CPhraseLearner::Observe(const std::string& key, const std::wstring& text, unsigned long long nowMs,
+                               std::vector<LearnedPhrase>& promoted)
+{
+    Segment segment;
+    segment.key = key;
+    segment.text = text;
+    segment.chars = CountChars(text);
+
+    if (segment.chars == 0 || segment.chars >= _limits.maxChars || !SplitsIntoSyllables(key, segment.chars))
+    {
+        Break();
+        return 0;
+    }
+    if (!_run.empty() && nowMs - _lastCommitMs > _limits.maxGapMs) Break();
+    _lastCommitMs = nowMs;
+
+    _run.push_back(segment);
+    if (_run.size() > _limits.maxSegments) _run.erase(_run.begin());
+
+    if (++_tick % _limits.agingInterval == 0) _Age();
+
+    // Count every phrase that ends with this commit: the last two segments,
+    // the last three, ... while it stays within maxChars
+    size_t added = 0;
+    std::string joinedKey = segment.key;
+    std::wstring joinedText = segment.text;
+    size_t chars = segment.chars;
+    for (size_t i = _run.size() - 1; i-- > 0;)
+    {
+        chars += _run[i].chars;
+        if (chars > _limits.maxChars) break;
+        joinedKey.insert(0, _run[i].key);
+        joinedText.insert(0, _run[i].text);
+
+        auto it = _candidates.find(joinedText);
+        if (it == _candidates.end())
+        {
+            if (_candidates.size() >= _limits.capacity) _Evict();
+            Candidate candidate;
+            candidate.key = joinedKey;
+            candidate.count = 0;
+            it = _candidates.emplace(joinedText, candidate).first;
+        }
+        // The same text under another reading is a different phrase; keep
+        // the latest reading rather than mixing counts
+        else if (it->second.key != joinedKey)
+        {
+            it->second.key = joinedKey;
+            it->second.count = 0;
+        }
+
+        it->second.lastSeen = _tick;
+        if (++it->second.count >= _limits.promoteCount)
+        {
+            LearnedPhrase phrase;
+            phrase.key = joinedKey;
+            phrase.text = joinedText;
+            promoted.push_back(phrase);
+            _candidates.erase(it);
+            added++;
+        }
+    }
+    return added;
+}
+
+// Halve the count of every candidate not seen during the last interval,
+// dropping those that reach zero, so one-off sequences fade out.
+void CPhraseLearner::_Age()
+{
+    for (auto it = _candidates.begin(); it != _candidates.end();)
+    {
+        if (_tick - it->second.lastSeen > _limits.agingInterval) it->second.count /= 2;
+        if (it->second.count == 0) it = _candidates.erase(it);
+        else ++it;
+    }
+}
+
+// Make room when full: age first, then drop the least recently seen half.
+// Amortized over the insertions that refill the table.
+void CPhraseLearner::_Evict()
+{
+    _Age();
+    if (_candidates.size() < _limits.capacity) return;
+
+    std::vector<unsigned long long> seen;
+    seen.reserve(_candidates.size());
+    for (const auto& item : _candidates) seen.push_back(item.second.lastSeen);
+    std::nth_element(seen.begin(), seen.begin() + seen.size() / 2, seen.end());
+    const unsigned long long cutoff = seen[seen.size() / 2];
+
+    for (auto it = _candidates.begin(); it != _candidates.end();)
+    {
+        if (it->second.lastSeen <= cutoff) it = _candidates.erase(it);
+        else ++it;
+    }
+}
@@ -0,0 +1,327 @@
+#include "PinyinNormalizer.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define UTIME_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define UTIME_TARGET_AVX2
+#else
+#define UTIME_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// ---------------------------------------------------------
+// UTF-8 decoding
+// ---------------------------------------------------------
+
+// Sequence length indexed by lead byte (0 = invalid lead / continuation byte).
+static const unsigned char kUtf8Length[256] = {
+    // 0x00 - 0x7F: ASCII
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    // 0x80 - 0xBF: continuation bytes
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    // 0xC0 - 0xC1: overlong, 0xC2 - 0xDF: 2 bytes
+    0,0,2,2,2,2,2,2,2,2,2,2,2,2,2,2, 2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+    // 0xE0 - 0xEF: 3 bytes, 0xF0 - 0xF4: 4 bytes, rest invalid
+    3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3, 4,4,4,4,4,0,0,0,0,0,0,0,0,0,0,0
+};
+
+// Payload mask for the lead byte, indexed by sequence length.
+static const unsigned char kUtf8LeadMask[5] = { 0x00, 0x7F, 0x1F, 0x0F, 0x07 };
+
+size_t DecodeUtf8(const char* s, size_t len, char32_t& cp)
+{
+    if (len == 0)
+    {
+        cp = 0xFFFD;
+        return 0;
+    }
+
+    unsigned char lead = (unsigned char)s[0];
+    size_t n = kUtf8Length[lead];
+    if (n == 0 || n > len)
+    {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    char32_t value = lead & kUtf8LeadMask[n];
+    for (size_t i = 1; i < n; ++i)
+    {
+        unsigned char c = (unsigned char)s[i];
+        if ((c & 0xC0) != 0x80)
+        {
+            cp = 0xFFFD;
+            return 1;
+        }
+        value = (value << 6) | (c & 0x3F);
+    }
+
+    cp = value;
+    return n;
+}
+
+// ---------------------------------------------------------
+// Tone mark table
+// ---------------------------------------------------------
+
+struct ToneMarkEntry
+{
+    char32_t codePoint;
+    char ascii;
+};
+
+// Every tone-marked letter used in Hanyu Pinyin, both cases, including the
+// ü series, ê, and the syllabic m/n readings found in Unihan data.
+static constexpr ToneMarkEntry kToneMarks[] = {
+    // a
+    { 0x00C0, 'a' }, { 0x00C1, 'a' }, { 0x0100, 'a' }, { 0x01CD, 'a' },
+    { 0x00E0, 'a' }, { 0x00E1, 'a' }, { 0x0101, 'a' }, { 0x01CE, 'a' },
+    // e, ê
+    { 0x00C8, 'e' }, { 0x00C9, 'e' }, { 0x0112, 'e' }, { 0x011A, 'e' }, { 0x00CA, 'e' },
+    { 0x00E8, 'e' }, { 0x00E9, 'e' }, { 0x0113, 'e' }, { 0x011B, 'e' }, { 0x00EA, 'e' },
+    { 0x1EBE, 'e' }, { 0x1EBF, 'e' }, { 0x1EC0, 'e' }, { 0x1EC1, 'e' },
+    // i
+    { 0x00CC, 'i' }, { 0x00CD, 'i' }, { 0x012A, 'i' }, { 0x01CF, 'i' },
+    { 0x00EC, 'i' }, { 0x00ED, 'i' }, { 0x012B, 'i' }, { 0x01D0, 'i' },
+    // o
+    { 0x00D2, 'o' }, { 0x00D3, 'o' }, { 0x014C, 'o' }, { 0x01D1, 'o' },
+    { 0x00F2, 'o' }, { 0x00F3, 'o' }, { 0x014D, 'o' }, { 0x01D2, 'o' },
+    // u
+    { 0x00D9, 'u' }, { 0x00DA, 'u' }, { 0x016A, 'u' }, { 0x01D3, 'u' },
+    { 0x00F9, 'u' }, { 0x00FA, 'u' }, { 0x016B, 'u' }, { 0x01D4, 'u' },
+    // ü -> v
+    { 0x00DC, 'v' }, { 0x01D5, 'v' }, { 0x01D7, 'v' }, { 0x01D9, 'v' }, { 0x01DB, 'v' },
+    { 0x00FC, 'v' }, { 0x01D6, 'v' }, { 0x01D8, 'v' }, { 0x01DA, 'v' }, { 0x01DC, 'v' },
+    // syllabic m, n
+    { 0x1E3E, 'm' }, { 0x1E3F, 'm' },
+    { 0x0143, 'n' }, { 0x0144, 'n' }, { 0x0147, 'n' }, { 0x0148, 'n' }, { 0x01F8, 'n' }, { 0x01F9, 'n' },
+};
+
+// Almost all tone marks live in U+00C0..U+01FF; index them directly. The few
+// outside that block (ḿ, ế, ề) fall back to a scan of kToneMarks.
+static constexpr char32_t kDenseFirst = 0x00C0;
+static constexpr char32_t kDenseLast = 0x01FF;
+
+struct DenseToneTable
+{
+    char ascii[kDenseLast - kDenseFirst + 1];
+};
+
+static constexpr DenseToneTable BuildDenseToneTable()
+{
+    DenseToneTable table = {};
+    for (const ToneMarkEntry& entry : kToneMarks)
+    {
+        if (entry.codePoint >= kDenseFirst && entry.codePoint <= kDenseLast)
+        {
+            table.ascii[entry.codePoint - kDenseFirst] = entry.ascii;
+        }
+    }
+    return table;
+}
+
+static constexpr DenseToneTable kDenseTones = BuildDenseToneTable();
+
+static_assert(kDenseTones.ascii[0x01DC - kDenseFirst] == 'v', "ǜ must map to v");
+static_assert(kDenseTones.ascii[0x0100 - kDenseFirst] == 'a', "Ā must map to a");
+
+char ToneMarkToAscii(char32_t cp)
+{
+    if (cp < 0x80)
+    {
+        if (cp >= 'a' && cp <= 'z') return (char)cp;
+        if (cp >= 'A' && cp <= 'Z') return (char)(cp - 'A' + 'a');
+        return 0;
+    }
+    if (cp >= kDenseFirst && cp <= kDenseLast)
+    {
+        return kDenseTones.ascii[cp - kDenseFirst];
+    }
+    for (const ToneMarkEntry& entry : kToneMarks)
+    {
+        if (entry.codePoint == cp) return entry.ascii;
+    }
+    return 0;
+}
+
+static bool IsCombiningMark(char32_t cp)
+{
+    return cp >= 0x0300 && cp <= 0x036F;
+}
+
+ToneStripResult StripTones(const char* in, size_t len, char* out, size_t capacity)
+{
+    ToneStripResult result = { 0, 0, false };
+
+    size_t i = 0;
+    while (i < len)
+    {
+        unsigned char c = (unsigned char)in[i];
+        char ascii;
+        if (c < 0x80)
+        {
+            ascii = ToneMarkToAscii(c);
+            ++i;
+        }
+        else
+        {
+            char32_t cp;
+            i += DecodeUtf8(in + i, len - i, cp);
+            ascii = ToneMarkToAscii(cp);
+            if (!ascii && !IsCombiningMark(cp)) result.unknown++;
+        }
+
+        if (!ascii) continue;
+        if (result.length == capacity)
+        {
+            result.truncated = true;
+            break;
+        }
+        out[result.length++] = ascii;
+    }
+    return result;
+}
+
+std::string StripTones(const std::string& pinyin)
+{
+    // Stripping never grows the text, so the input length is a safe bound.
+    std::string result(pinyin.length(), '\0');
+    ToneStripResult r = StripTones(pinyin.data(), pinyin.length(), &result[0], result.length());
+    result.resize(r.length);
+    return result;
+}
+
+// ---------------------------------------------------------
+// Composition key normalization
+// ---------------------------------------------------------
+
+bool NormalizeKeyScalar(const char16_t* in, size_t len, char* out)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        char16_t c = in[i];
+        if (c >= 0x80) return false;
+        if (c >= 'A' && c <= 'Z') c = (char16_t)(c - 'A' + 'a');
+        out[i] = (char)c;
+    }
+    return true;
+}
+
+#ifdef UTIME_X86
+
+bool CpuHasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+    return true;    // Part of the x64 baseline
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2") != 0;
+#endif
+}
+
+bool CpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+    // The OS must save YMM state across context switches.
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+bool NormalizeKeySse2(const char16_t* in, size_t len, char* out)
+{
+    const __m128i highBits = _mm_set1_epi16((short)0xFF80);
+    const __m128i beforeA = _mm_set1_epi8('A' - 1);
+    const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(in + i + 8));
+
+        // Any bit above 0x7F in either half means a non-ASCII code unit.
+        __m128i nonAscii = _mm_and_si128(_mm_or_si128(lo, hi), highBits);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, _mm_setzero_si128())) != 0xFFFF) return false;
+
+        // All values are < 0x80, so packing cannot saturate and signed byte
+        // compares are safe for the A-Z range check.
+        __m128i bytes = _mm_packus_epi16(lo, hi);
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, beforeA), _mm_cmplt_epi8(bytes, afterZ));
+        bytes = _mm_add_epi8(bytes, _mm_and_si128(upper, caseBit));
+        _mm_storeu_si128((__m128i*)(out + i), bytes);
+    }
+    return NormalizeKeyScalar(in + i, len - i, out + i);
+}
+
+UTIME_TARGET_AVX2 bool NormalizeKeyAvx2(const char16_t* in, size_t len, char* out)
+{
+    const __m256i highBits = _mm256_set1_epi16((short)0xFF80);
+    const __m256i beforeA = _mm256_set1_epi8('A' - 1);
+    const __m256i afterZ = _mm256_set1_epi8('Z' + 1);
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(in + i + 16));
+        if (!_mm256_testz_si256(_mm256_or_si256(lo, hi), highBits)) return false;
+
+        // packus works per 128-bit lane; restore the original order afterwards.
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, beforeA), _mm256_cmpgt_epi8(afterZ, bytes));
+        bytes = _mm256_add_epi8(bytes, _mm256_and_si256(upper, caseBit));
+        _mm256_storeu_si256((__m256i*)(out + i), bytes);
+    }
+    return NormalizeKeySse2(in + i, len - i, out + i);
+}
+
+#else
+
+bool CpuHasSse2() { return false; }
+bool CpuHasAvx2() { return false; }
+bool NormalizeKeySse2(const char16_t* in, size_t len, char* out) { return NormalizeKeyScalar(in, len, out); }
+bool NormalizeKeyAvx2(const char16_t* in, size_t len, char* out) { return NormalizeKeyScalar(in, len, out); }
+
+#endif
+
+typedef bool (*NormalizeKeyKernel)(const char16_t* in, size_t len, char* out);
+
+static NormalizeKeyKernel SelectNormalizeKeyKernel()
+{
+    if (CpuHasSse2()) return NormalizeKeySse2;
+    return NormalizeKeyScalar;
+}
+
+KeyNormalizeResult NormalizeKey(const char16_t* in, size_t len, char* out, size_t capacity)
+{
+    static const NormalizeKeyKernel kernel = SelectNormalizeKeyKernel();
+
+    KeyNormalizeResult result = { 0, false };
+    if (len > capacity) return result;
+    if (!kernel(in, len, out)) return result;
+    result.length = len;
+    result.ok = true;
+    return result;
+}
@@ -0,0 +1,257 @@
+#include "PinyinSyllables.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// ---------------------------------------------------------
+// Syllable inventory
+// ---------------------------------------------------------
+
+// Sorted in byte order for readability. Interjections made
+// only of consonants (m, n, ng, hm, hng) are left out on purpose: they
+// would let almost any consonant start a "syllable" and break splitting.
+static const char* const kSyllables[] = {
+    "a", "ai", "an", "ang", "ao",
+    "ba", "bai", "ban", "bang", "bao", "bei", "ben", "beng", "bi", "bian", "biao", "bie", "bin", "bing", "bo", "bu",
+    "ca", "cai", "can", "cang", "cao", "ce", "cen", "ceng",
+    "cha", "chai", "chan", "chang", "chao", "che", "chen", "cheng", "chi", "chong", "chou", "chu", "chua", "chuai",
+    "chuan", "chuang", "chui", "chun", "chuo",
+    "ci", "cong", "cou", "cu", "cuan", "cui", "cun", "cuo",
+    "da", "dai", "dan", "dang", "dao", "de", "dei", "den", "deng", "di", "dia", "dian", "diao", "die", "ding", "diu",
+    "dong", "dou", "du", "duan", "dui", "dun", "duo",
+    "e", "ei", "en", "eng", "er",
+    "fa", "fan", "fang", "fei", "fen", "feng", "fo", "fou", "fu",
+    "ga", "gai", "gan", "gang", "gao", "ge", "gei", "gen", "geng", "gong", "gou", "gu", "gua", "guai", "guan", "guang",
+    "gui", "gun", "guo",
+    "ha", "hai", "han", "hang", "hao", "he", "hei", "hen", "heng", "hong", "hou", "hu", "hua", "huai", "huan", "huang",
+    "hui", "hun", "huo",
+    "ji", "jia", "jian", "jiang", "jiao", "jie", "jin", "jing", "jiong", "jiu", "ju", "juan", "jue", "jun",
+    "ka", "kai", "kan", "kang", "kao", "ke", "kei", "ken", "keng", "kong", "kou", "ku", "kua", "kuai", "kuan", "kuang",
+    "kui", "kun", "kuo",
+    "la", "lai", "lan", "lang", "lao", "le", "lei", "leng", "li", "lia", "lian", "liang", "liao", "lie", "lin", "ling",
+    "liu", "lo", "long", "lou", "lu", "luan", "lun", "luo", "lv", "lve",
+    "ma", "mai", "man", "mang", "mao", "me", "mei", "men", "meng", "mi", "mian", "miao", "mie", "min", "ming", "miu",
+    "mo", "mou", "mu",
+    "na", "nai", "nan", "nang", "nao", "ne", "nei", "nen", "neng", "ni", "nian", "niang", "niao", "nie", "nin", "ning",
+    "niu", "nong", "nou", "nu", "nuan", "nuo", "nv", "nve",
+    "o", "ou",
+    "pa", "pai", "pan", "pang", "pao", "pei", "pen", "peng", "pi", "pian", "piao", "pie", "pin", "ping", "po", "pou", "pu",
+    "qi", "qia", "qian", "qiang", "qiao", "qie", "qin", "qing", "qiong", "qiu", "qu", "quan", "que", "qun",
+    "ran", "rang", "rao", "re", "ren", "reng", "ri", "rong", "rou", "ru", "rua", "ruan", "rui", "run", "ruo",
+    "sa", "sai", "san", "sang", "sao", "se", "sen", "seng",
+    "sha", "shai", "shan", "shang", "shao", "she", "shei", "shen", "sheng", "shi", "shou", "shu", "shua", "shuai",
+    "shuan", "shuang", "shui", "shun", "shuo",
+    "si", "song", "sou", "su", "suan", "sui", "sun", "suo",
+    "ta", "tai", "tan", "tang", "tao", "te", "tei", "teng", "ti", "tian", "tiao", "tie", "ting", "tong", "tou", "tu",
+    "tuan", "tui", "tun", "tuo",
+    "wa", "wai", "wan", "wang", "wei", "wen", "weng", "wo", "wu",
+    "xi", "xia", "xian", "xiang", "xiao", "xie", "xin", "xing", "xiong", "xiu", "xu", "xuan", "xue", "xun",
+    "ya", "yan", "yang", "yao", "ye", "yi", "yin", "ying", "yo", "yong", "you", "yu", "yuan", "yue", "yun",
+    "za", "zai", "zan", "zang", "zao", "ze", "zei", "zen", "zeng",
+    "zha", "zhai", "zhan", "zhang", "zhao", "zhe", "zhei", "zhen", "zheng", "zhi", "zhong", "zhou", "zhu", "zhua",
+    "zhuai", "zhuan", "zhuang", "zhui", "zhun", "zhuo",
+    "zi", "zong", "zou", "zu", "zuan", "zui", "zun", "zuo"
+};
+
+static const size_t kSyllableCount = sizeof(kSyllables) / sizeof(kSyllables[0]);
+
+// ---------------------------------------------------------
+// Lookup trie
+// ---------------------------------------------------------
+
+// Dense 26-way trie over the table, built once. Node 0 is the root and is
+// never a child, so 0 doubles as "no edge".
+struct SyllableTrie
+{
+    std::vector<unsigned short> next;    // node * 26 + letter
+    std::vector<unsigned char> terminal; // 1 if the path to the node is a syllable
+
+    SyllableTrie() : next(26, 0), terminal(1, 0)
+    {
+        for (size_t i = 0; i < kSyllableCount; ++i)
+        {
+            size_t node = 0;
+            for (const char* p = kSyllables[i]; *p; ++p)
+            {
+                size_t slot = node * 26 + (*p - 'a');
+                if (next[slot] == 0)
+                {
+                    next[slot] = (unsigned short)terminal.size();
+                    next.resize(next.size() + 26, 0);
+                    terminal.push_back(0);
+                }
+                node = next[slot];
+            }
+            terminal[node] = 1;
+        }
+    }
+
+    // Follow one letter; returns 0 if no syllable continues this way.
+    size_t Step(size_t node, char c) const
+    {
+        if (c < 'a' || c > 'z') return 0;
+        return next[node * 26 + (c - 'a')];
+    }
+};
+
+static const SyllableTrie& GetSyllableTrie()
+{
+    static const SyllableTrie trie;
+    return trie;
+}
+
+size_t SyllableTrieStep(size_t node, char c)
+{
+    return GetSyllableTrie().Step(node, c);
+}
+
+bool SyllableTrieIsTerminal(size_t node)
+{
+    return GetSyllableTrie().terminal[node] != 0;
+}
+
+size_t SyllableTrieChildren(size_t node, char* letters, size_t* children)
+{
+    const unsigned short* slots = &GetSyllableTrie().next[node * 26];
+    size_t count = 0;
+    for (int i = 0; i < 26; ++i)
+    {
+        if (slots[i] == 0) continue;
+        letters[count] = (char)('a' + i);
+        children[count] = slots[i];
+        count++;
+    }
+    return count;
+}
+
+// Walk s through the trie. Returns the length of the longest complete
+// syllable at s (0 if none) and the longest valid prefix in *prefixLength.
+static size_t LongestSyllable(const char* s, size_t len, size_t* prefixLength)
+{
+    const SyllableTrie& trie = GetSyllableTrie();
+    size_t limit = std::min(len, MAX_SYLLABLE_LENGTH);
+    size_t node = 0;
+    size_t best = 0;
+    size_t n = 0;
+
+    while (n < limit)
+    {
+        node = trie.Step(node, s[n]);
+        if (node == 0) break;
+        n++;
+        if (trie.terminal[node]) best = n;
+    }
+
+    *prefixLength = n;
+    return best;
+}
+
+bool IsPinyinSyllable(const char* s, size_t len)
+{
+    if (len == 0 || len > MAX_SYLLABLE_LENGTH) return false;
+    size_t prefix;
+    size_t best = LongestSyllable(s, len, &prefix);
+    return prefix == len && best == len;
+}
+
+bool IsPinyinSyllablePrefix(const char* s, size_t len)
+{
+    if (len > MAX_SYLLABLE_LENGTH) return false;
+    size_t prefix;
+    LongestSyllable(s, len, &prefix);
+    return prefix == len;
+}
+
+size_t PinyinInitialLength(const char* s, size_t len)
+{
+    if (len == 0) return 0;
+    if (len >= 2 && s[1] == 'h' && (s[0] == 'z' || s[0] == 'c' || s[0] == 's')) return 2;
+    return strchr("bpmfdtnlgkhjqxrzcsyw", s[0]) != nullptr && s[0] != '\0' ? 1 : 0;
+}
+
+void MarkSyllableStarts(const char* s, size_t len, unsigned char* starts)
+{
+    memset(starts, 0, len + 1);
+    starts[len] = 1;
+
+    size_t i = 0;
+    while (i < len)
+    {
+        starts[i] = 1;
+
+        // Longest complete syllable first, otherwise the longest run that
+        // could still become a syllable (at least one letter)
+        size_t prefix;
+        size_t step = LongestSyllable(s + i, len - i, &prefix);
+        if (step == 0) step = prefix > 0 ? prefix : 1;
+        i += step;
+    }
+}
+
+std::string SyllableInitials(const char* s, size_t len)
+{
+    std::vector<unsigned char> starts(len + 1);
+    MarkSyllableStarts(s, len, starts.data());
+    std::string initials;
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (starts[i]) initials += s[i];
+    }
+    return initials;
+}
+
+// Most zh/ch/sh in one key whose readings are enumerated; later ones read
+// as one initial only
+static const size_t kMaxDigraphs = 8;
+
+size_t GetInitialsKeys(const std::string& key, std::vector<std::string>& keys, size_t max)
+{
+    const size_t len = key.length();
+    if (len <= PinyinInitialLength(key.data(), len)) return 0;
+
+    size_t digraphAt[kMaxDigraphs];
+    size_t digraphs = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        size_t initial = PinyinInitialLength(key.data() + i, len - i);
+        if (initial == 0) return 0;
+        if (initial == 2)
+        {
+            if (digraphs < kMaxDigraphs) digraphAt[digraphs++] = i;
+            i++;
+        }
+    }
+
+    // Fewest digraphs split first: "zhg" is likelier zhong guo than z h g
+    size_t count = 0;
+    for (size_t splits = 0; splits <= digraphs && count < max; ++splits)
+    {
+        for (size_t mask = 0; mask < ((size_t)1 << digraphs) && count < max; ++mask)
+        {
+            size_t bits = 0;
+            for (size_t m = mask; m; m >>= 1) bits += m & 1;
+            if (bits != splits) continue;
+
+            if (keys.size() <= count) keys.resize(count + 1);
+            std::string& initials = keys[count++];
+            initials.clear();
+            size_t next = 0;
+            for (size_t i = 0; i < len; ++i)
+            {
+                initials += key[i];
+                if (next < digraphs && digraphAt[next] == i)
+                {
+                    // The h is kept only when the digraph reads as two initials
+                    if (mask & ((size_t)1 << next)) initials += key[i + 1];
+                    next++;
+                    i++;
+                }
+                else if (i + 1 < len && key[i + 1] == 'h' && PinyinInitialLength(key.data() + i, len - i) == 2)
+                {
+                    i++;    // Past kMaxDigraphs: one initial
+                }
+            }
+        }
+    }
+    return count;
+}
@@ -1,6 +1,5 @@
 #include "TextService.h"
 #include "EditSession.h"
-#include "GetTextExtEditSession.h"
 #include "DictionaryEngine.h"
 #include "Config.h"
 #include <fstream>
@@ -8,16 +7,19 @@
 
 // Enhanced DebugLog with timestamp and thread safety
 static CRITICAL_SECTION g_LogCS;
-static bool g_LogCSInitialized = false;
+static INIT_ONCE g_LogCSInit = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK InitLogCS(PINIT_ONCE, PVOID, PVOID*)
+{
+    InitializeCriticalSection(&g_LogCS);
+    return TRUE;
+}
 
 void DebugLog(const wchar_t* format, ...)
 {
-    // Initialize critical section on first use
-    if (!g_LogCSInitialized)
-    {
-        InitializeCriticalSection(&g_LogCS);
-        g_LogCSInitialized = true;
-    }
+    // Background threads (the user data writer) log too, so the first call
+    // may come from any thread
+    InitOnceExecuteOnce(&g_LogCSInit, InitLogCS, NULL, NULL);
     
     EnterCriticalSection(&g_LogCS);
     
@@ -63,16 +65,26 @@ CTextService::CTextService()
       _tfClientId(TF_CLIENTID_NULL), 
       _dwCookieKey(TF_INVALID_COOKIE),
       _pComposition(NULL),
+      _pPendingUpdate(NULL),
+      _coalescedUpdates(0),
+      _composer([this](const std::wstring& composition, bool more, CCandidateList& candidates) {
+          CDictionaryEngine& dictionary = CDictionaryEngine::Instance();
+          return more ? dictionary.QueryMore(_queryCursor, candidates)
+                      : dictionary.Query(composition, _queryCursor, candidates);
+      }, Config::CandidateWindow::PAGE_SIZE,
+      [](const std::wstring& committed, CCandidateList& predictions) {
+          CDictionaryEngine::Instance().Predict(committed, predictions);
+      }),
       _pCandidateWindow(NULL),
-      _selectedCandidateIndex(0),
-      _lastCandidateX(0),
-      _lastCandidateY(0)
+      _caretLocator(Config::CaretPosition::MOUSE_RECHECK_INTERVAL),
+      _caretLocates(0)
 {
     DllAddRef();
     _pCandidateWindow = new CCandidateWindow();
     
-    // Initialize Dictionary
-    CDictionaryEngine::Instance().Initialize();
+    // Load the dictionary off the host's thread; the first keys are served
+    // from the hot-word table until it is ready
+    CDictionaryEngine::Instance().InitializeAsync();
 }
 
 CTextService::~CTextService()
@@ -82,6 +94,7 @@ CTextService::~CTextService()
         delete _pCandidateWindow;
         _pCandidateWindow = NULL;
     }
+    _CancelPendingUpdate();
     if (_pComposition)
     {
         _pComposition->Release();
@@ -149,6 +162,11 @@ STDMETHODIMP CTextService::Activate(ITfThreadMgr *ptim, TfClientId tid)
 STDMETHODIMP CTextService::Deactivate()
 {
     _UninitKeyEventSink();
+    _CancelPendingUpdate();
+
+    // Not a key path: wait for pending learning data to reach disk
+    CDictionaryEngine::Instance().EndCommitRun();
+    CDictionaryEngine::Instance().FlushUserData();
 
     if (_pCandidateWindow)
     {
@@ -168,169 +186,73 @@ STDMETHODIMP CTextService::Deactivate()
 // ITfKeyEventSink Implementation
 STDMETHODIMP CTextService::OnSetFocus(BOOL fForeground)
 {
+    CDictionaryEngine::Instance().EndCommitRun();
+    _caretLocator.Clear();
+
+    // Predictions belong to the text they would follow
+    if (_composer.Predicting())
+    {
+        _composer.Reset();
+        if (_pCandidateWindow) _pCandidateWindow->Hide();
+    }
     return S_OK;
 }
 
-STDMETHODIMP CTextService::OnTestKeyDown(ITfContext *pic, WPARAM wParam, LPARAM lParam, BOOL *pfEaten)
+// Map a virtual key to the composition engine's keys. Chords with Ctrl or
+// Alt belong to the application.
+static CompositionKey TranslateKey(WPARAM wParam)
 {
-    *pfEaten = FALSE;
-    
-    // Don't eat if Ctrl or Alt is pressed
-    if ((GetKeyState(VK_CONTROL) & 0x8000) || (GetKeyState(VK_MENU) & 0x8000)) {
-        return S_OK;
+    CompositionKey key = { COMP_KEY_OTHER, 0 };
+    if (wParam == VK_SHIFT || wParam == VK_CONTROL || wParam == VK_MENU)
+    {
+        key.code = COMP_KEY_MODIFIER;
     }
-
-    // Simple logic: if 'a'-'z', eat it.
-    if ((wParam >= 'A' && wParam <= 'Z')) {
-        *pfEaten = TRUE;
+    else if ((GetKeyState(VK_CONTROL) & 0x8000) || (GetKeyState(VK_MENU) & 0x8000))
+    {
+        key.code = COMP_KEY_OTHER;
     }
-    // If composition is active, eat Space/Enter/Esc/Back, number keys, and up/down arrow keys
-    if (_sComposition.length() > 0) {
-        if (wParam == VK_SPACE || wParam == VK_RETURN || wParam == VK_ESCAPE || wParam == VK_BACK) {
-            *pfEaten = TRUE;
-        }
-        // Eat number keys 1-9 when composition is active
-        if (wParam >= '1' && wParam <= '9') {
-            *pfEaten = TRUE;
-        }
-        // Eat up/down arrow keys for candidate navigation
-        if (wParam == VK_UP || wParam == VK_DOWN) {
-            *pfEaten = TRUE;
-        }
+    else if (wParam >= 'A' && wParam <= 'Z')
+    {
+        key.code = COMP_KEY_LETTER;
+        key.ch = (wchar_t)(wParam - 'A' + 'a');
     }
+    else if (wParam >= '1' && wParam <= '9')
+    {
+        key.code = COMP_KEY_DIGIT;
+        key.ch = (wchar_t)wParam;
+    }
+    else if (wParam == VK_BACK) key.code = COMP_KEY_BACKSPACE;
+    else if (wParam == VK_SPACE) key.code = COMP_KEY_SPACE;
+    else if (wParam == VK_RETURN) key.code = COMP_KEY_ENTER;
+    else if (wParam == VK_UP) key.code = COMP_KEY_UP;
+    else if (wParam == VK_DOWN) key.code = COMP_KEY_DOWN;
+    else if (wParam == VK_PRIOR) key.code = COMP_KEY_PAGE_UP;
+    else if (wParam == VK_NEXT) key.code = COMP_KEY_PAGE_DOWN;
+    else if ((wParam == VK_OEM_MINUS || wParam == VK_OEM_PLUS) && !(GetKeyState(VK_SHIFT) & 0x8000))
+    {
+        // '-' and '=' unshifted; '_' and '+' stay with the application
+        key.code = wParam == VK_OEM_MINUS ? COMP_KEY_PAGE_UP : COMP_KEY_PAGE_DOWN;
+    }
+    else if (wParam == VK_ESCAPE) key.code = COMP_KEY_ESCAPE;
+    return key;
+}
+
+STDMETHODIMP CTextService::OnTestKeyDown(ITfContext *pic, WPARAM wParam, LPARAM lParam, BOOL *pfEaten)
+{
+    *pfEaten = _composer.WouldEat(TranslateKey(wParam)) ? TRUE : FALSE;
     return S_OK;
 }
 
 STDMETHODIMP CTextService::OnKeyDown(ITfContext *pic, WPARAM wParam, LPARAM lParam, BOOL *pfEaten)
 {
-    *pfEaten = FALSE;
-    
-    BOOL fTestEaten = FALSE;
-    OnTestKeyDown(pic, wParam, lParam, &fTestEaten);
-    if (!fTestEaten) return S_OK;
-
-    *pfEaten = TRUE;
-    
-    DebugLog(L"OnKeyDown: wParam=%X", wParam);
-
-    if (wParam >= 'A' && wParam <= 'Z') {
-        // Simple lowercase mapping
-        wchar_t ch = (wchar_t)(wParam - 'A' + 'a');
-        _sComposition += ch;
-        _selectedCandidateIndex = 0;  // Reset selection when composition changes
-        _UpdateComposition(pic);
-        _UpdateCandidateWindow(pic);
-    }
-    else if (wParam == VK_BACK) {
-        if (!_sComposition.empty()) {
-            _sComposition.pop_back();
-            _selectedCandidateIndex = 0;  // Reset selection when composition changes
-            if (_sComposition.empty()) 
-            {
-                _EndComposition(pic);
-                if (_pCandidateWindow) _pCandidateWindow->Hide();
-            }
-            else 
-            {
-                _UpdateComposition(pic);
-                _UpdateCandidateWindow(pic);
-            }
-        }
-    }
-    else if (wParam >= '1' && wParam <= '9') {
-        // Handle number key to select candidate
-        if (!_sComposition.empty() && _candidateList.size() > 0) {
-            int index = (int)(wParam - '1'); // 1 -> 0, 2 -> 1, etc.
-            
-            if (index < (int)_candidateList.size()) {
-                std::wstring commitText = _candidateList[index];
-                DebugLog(L"OnKeyDown Number Key %d: Committing candidate='%s'", index + 1, commitText.c_str());
-                
-                // Use helper method to commit
-                _CommitCandidateText(pic, commitText);
-            }
-            else
-            {
-                DebugLog(L"OnKeyDown Number: Index %d out of range (size=%d)", index, _candidateList.size());
-            }
-        }
-    }
-    else if (wParam == VK_SPACE) {
-        if (!_sComposition.empty()) {
-            // Commit selected candidate or raw pinyin
-            std::wstring commitText = _sComposition; // Default: commit raw pinyin
-            
-            if (_candidateList.size() > 0 && _selectedCandidateIndex >= 0 && _selectedCandidateIndex < (int)_candidateList.size())
-            {
-                // Use selected candidate
-                commitText = _candidateList[_selectedCandidateIndex];
-            }
-            
-            DebugLog(L"OnKeyDown VK_SPACE: Committing text='%s', selectedIndex=%d", commitText.c_str(), _selectedCandidateIndex);
-            
-            // Use helper method to commit
-            _CommitCandidateText(pic, commitText);
-        }
-        else
-        {
-            // Pass space to application
-            *pfEaten = FALSE;
-        }
-    }
-    else if (wParam == VK_RETURN) {
-        if (!_sComposition.empty()) {
-            // Commit pinyin raw text (not candidate)
-            std::wstring commitText = _sComposition;
-            
-            DebugLog(L"OnKeyDown VK_RETURN: Committing raw text='%s'", commitText.c_str());
-            
-            // Use helper method to commit
-            _CommitCandidateText(pic, commitText);
-        }
-        else
-        {
-            // Pass enter to application
-            *pfEaten = FALSE;
-        }
-    }
-    else if (wParam == VK_UP) {
-        // Navigate up in candidate list
-        if (!_sComposition.empty() && _candidateList.size() > 0) {
-            if (_selectedCandidateIndex == 0) {
-                _selectedCandidateIndex = (int)_candidateList.size() - 1;
-            } else {
-                _selectedCandidateIndex--;
-            }
-            
-            DebugLog(L"OnKeyDown VK_UP: selectedIndex=%d", _selectedCandidateIndex);
-            
-            // Refresh candidate window with new selection
-            if (_pCandidateWindow && _pCandidateWindow->IsVisible()) {
-                _pCandidateWindow->Show(_lastCandidateX, _lastCandidateY, _candidateList, _selectedCandidateIndex);
-            }
-        }
-    }
-    else if (wParam == VK_DOWN) {
-        // Navigate down in candidate list
-        if (!_sComposition.empty() && _candidateList.size() > 0) {
-            _selectedCandidateIndex = (_selectedCandidateIndex + 1) % _candidateList.size();
-            
-            DebugLog(L"OnKeyDown VK_DOWN: selectedIndex=%d", _selectedCandidateIndex);
-            
-            // Refresh candidate window with new selection
-            if (_pCandidateWindow && _pCandidateWindow->IsVisible()) {
-                _pCandidateWindow->Show(_lastCandidateX, _lastCandidateY, _candidateList, _selectedCandidateIndex);
-            }
-        }
-    }
-    else if (wParam == VK_ESCAPE) {
-        _sComposition.clear();
-        _candidateList.clear();
-        _selectedCandidateIndex = 0;
-        _EndComposition(pic);
-        if (_pCandidateWindow) _pCandidateWindow->Hide();
+    CompositionResult result = _composer.OnKey(TranslateKey(wParam));
+    *pfEaten = result.eaten ? TRUE : FALSE;
+    if (result.eaten)
+    {
+        DebugTrace(L"OnKeyDown: wParam=%X, actions=%X", wParam, result.actions);
     }
-    
+
+    _ApplyResult(pic, result);
     return S_OK;
 }
 
@@ -359,7 +281,26 @@ STDMETHODIMP CTextService::OnCompositionTerminated(TfEditCookie ecWrite, ITfComp
         _pComposition->Release();
         _pComposition = NULL;
     }
-    _sComposition.clear();
+    _CancelPendingUpdate();
+    _composer.Reset();
+    CDictionaryEngine::Instance().EndComposition(_queryCursor);
+
+    // The application took the composition back; its document may have
+    // changed under us, so find the caret afresh in this window
+    bool invalidated = false;
+    ITfRange *pRange = NULL;
+    if (pComposition && SUCCEEDED(pComposition->GetRange(&pRange)))
+    {
+        ITfContext *pContext = NULL;
+        if (SUCCEEDED(pRange->GetContext(&pContext)))
+        {
+            _caretLocator.Invalidate(_CaretWindowKey(pContext, NULL));
+            invalidated = true;
+            pContext->Release();
+        }
+        pRange->Release();
+    }
+    if (!invalidated) _caretLocator.Clear();
     return S_OK;
 }
 
@@ -386,27 +327,63 @@ void CTextService::_UninitKeyEventSink()
     }
 }
 
+// Show the current composition and place the candidate window under it.
+// While the application holds its document lock the session is queued;
+// keys typed until it runs reuse it, since it reads the composition text
+// only when it runs.
 HRESULT CTextService::_UpdateComposition(ITfContext *pContext)
 {
-    CUpdateCompositionEditSession *pEditSession = new CUpdateCompositionEditSession(this, pContext, _sComposition);
-    HRESULT hr = pContext->RequestEditSession(_tfClientId, pEditSession, TF_ES_ASYNCDONTCARE | TF_ES_READWRITE, NULL);
+    if (_pPendingUpdate && _pPendingUpdate->IsFor(pContext))
+    {
+        _coalescedUpdates++;
+        return S_OK;
+    }
+    _CancelPendingUpdate();
+
+    CUpdateCompositionEditSession *pEditSession = new CUpdateCompositionEditSession(this, pContext);
+    _pPendingUpdate = pEditSession;
+    _pPendingUpdate->AddRef();
+
+    HRESULT hrSession;
+    HRESULT hr = pContext->RequestEditSession(_tfClientId, pEditSession, TF_ES_ASYNCDONTCARE | TF_ES_READWRITE, &hrSession);
+    if (FAILED(hr))
+    {
+        DebugLog(L"_UpdateComposition: RequestEditSession failed, hr=0x%08X", hr);
+        _CancelPendingUpdate();
+    }
     pEditSession->Release();
     return hr;
 }
 
+// Forget the queued update session; it does nothing if it runs later.
+void CTextService::_CancelPendingUpdate()
+{
+    if (_pPendingUpdate)
+    {
+        _pPendingUpdate->Release();
+        _pPendingUpdate = NULL;
+    }
+    _coalescedUpdates = 0;
+}
+
 HRESULT CTextService::_EndComposition(ITfContext *pContext)
 {
+    // A queued update must not run after this session and restart the
+    // composition; keys typed from now on request a new one
+    _CancelPendingUpdate();
+
     CEndCompositionEditSession *pEditSession = new CEndCompositionEditSession(this, pContext);
     HRESULT hr = pContext->RequestEditSession(_tfClientId, pEditSession, TF_ES_ASYNCDONTCARE | TF_ES_READWRITE, NULL);
     pEditSession->Release();
     return hr;
 }
 
-// Helper method to commit candidate text (extracted common logic from number/space/enter key handlers)
+// Insert text into the document, ending the composition
 HRESULT CTextService::_CommitCandidateText(ITfContext *pContext, const std::wstring& text)
 {
     DebugLog(L"_CommitCandidateText: Committing text='%s'", text.c_str());
-    
+    _CancelPendingUpdate();
+
     // Create commit session
     CCommitCompositionEditSession *pCommit = new CCommitCompositionEditSession(this, pContext, text);
     HRESULT hrSession;
@@ -428,224 +405,202 @@ HRESULT CTextService::_CommitCandidateText(ITfContext *pContext, const std::wstr
     }
     
     pCommit->Release();
-    
-    // Clear state after successful commit
-    _sComposition.clear();
-    _candidateList.clear();
-    _selectedCandidateIndex = 0;
-    if (_pCandidateWindow) _pCandidateWindow->Hide();
-    
     return hr;
 }
 
-void CTextService::_UpdateCandidateWindow(ITfContext *pContext)
+void CTextService::_ApplyResult(ITfContext *pContext, const CompositionResult& result)
 {
-    if (!_pCandidateWindow) return;
+    CDictionaryEngine& dictionary = CDictionaryEngine::Instance();
+    if (result.actions & ACTION_LEARN)
+    {
+        dictionary.RecordCommit(_composer.CommitKey(), _composer.CommitText());
+    }
+    if (result.actions & ACTION_END_COMMIT_RUN)
+    {
+        dictionary.EndCommitRun();
+    }
+    if (result.actions & ACTION_COMMIT)
+    {
+        _CommitCandidateText(pContext, _composer.CommitText());
+    }
+    if (result.actions & ACTION_UPDATE_PREEDIT)
+    {
+        _UpdateComposition(pContext);
+    }
+    if (result.actions & ACTION_END_COMPOSITION)
+    {
+        _EndComposition(pContext);
+    }
+    if (result.actions & (ACTION_COMMIT | ACTION_END_COMPOSITION))
+    {
+        dictionary.EndComposition(_queryCursor);
+    }
+    if ((result.actions & ACTION_SHOW_CANDIDATES) && !(result.actions & ACTION_UPDATE_PREEDIT))
+    {
+        // No composition after a commit, so no extent to measure
+        _UpdateCandidateWindow(pContext, NULL);
+    }
+    else if ((result.actions & ACTION_MOVE_SELECTION) && _pCandidateWindow && _pCandidateWindow->IsVisible())
+    {
+        DebugTrace(L"_ApplyResult: selectedIndex=%d", _composer.Selection());
+        _pCandidateWindow->SetSelection(_composer.Selection());
+    }
+    else if ((result.actions & ACTION_SHOW_PAGE) && _pCandidateWindow && _pCandidateWindow->IsVisible())
+    {
+        DebugTrace(L"_ApplyResult: page=%d, selectedIndex=%d", _composer.Page(), _composer.Selection());
+        _pCandidateWindow->SetCandidates(_composer.Candidates(), _composer.PageStart(), _composer.PageLength(),
+                                         _composer.Selection());
+    }
+    if ((result.actions & ACTION_HIDE_CANDIDATES) && _pCandidateWindow)
+    {
+        _pCandidateWindow->Hide();
+    }
+}
 
-    DebugLog(L"_UpdateCandidateWindow: Composition=%s", _sComposition.c_str());
+// Screen rect of the caret GetGUIThreadInfo reports for `threadId`.
+static bool GetThreadCaret(DWORD threadId, CaretRect& rc)
+{
+    GUITHREADINFO gti = {0};
+    gti.cbSize = sizeof(gti);
+    if (threadId == 0 || !GetGUIThreadInfo(threadId, &gti) || gti.hwndFocus == NULL)
+    {
+        return false;
+    }
 
-    // 1. Query candidates from DB
-    _candidateList = CDictionaryEngine::Instance().Query(_sComposition);
-    
-    // Reset selection index when candidate list changes
-    _selectedCandidateIndex = 0;
-    
-    DebugLog(L"_UpdateCandidateWindow: Query returned %d candidates", _candidateList.size());
+    // rcCaret is in client coordinates of the focus window, convert to screen
+    POINT ptTopLeft = { gti.rcCaret.left, gti.rcCaret.top };
+    POINT ptBottomRight = { gti.rcCaret.right, gti.rcCaret.bottom };
+    if (!ClientToScreen(gti.hwndFocus, &ptTopLeft) || !ClientToScreen(gti.hwndFocus, &ptBottomRight))
+    {
+        return false;
+    }
+    rc.left = ptTopLeft.x;
+    rc.top = ptTopLeft.y;
+    rc.right = ptBottomRight.x;
+    rc.bottom = ptBottomRight.y;
+    return !(rc.left == 0 && rc.top == 0 && rc.right == 0 && rc.bottom == 0);
+}
 
-    // Fallback if no result
-    if (_candidateList.empty()) {
-        _candidateList.push_back(_sComposition);
-        DebugLog(L"_UpdateCandidateWindow: Added fallback candidate");
+// One caret strategy for CCaretLocator. `hwndView` may be NULL.
+static bool ProbeCaret(CaretStrategy strategy, HWND hwndView, const RECT& rcText, CaretRect& rc)
+{
+    switch (strategy)
+    {
+    case CARET_TEXT_EXT:
+        // Measured by the edit session that set the composition text
+        rc.left = rcText.left;
+        rc.top = rcText.top;
+        rc.right = rcText.right;
+        rc.bottom = rcText.bottom;
+        return !(rc.left == 0 && rc.top == 0 && rc.right == 0 && rc.bottom == 0);
+
+    case CARET_VIEW_THREAD:
+        return hwndView != NULL && GetThreadCaret(GetWindowThreadProcessId(hwndView, NULL), rc);
+
+    case CARET_FOREGROUND_THREAD:
+    {
+        HWND hwndFG = GetForegroundWindow();
+        return hwndFG != NULL && GetThreadCaret(GetWindowThreadProcessId(hwndFG, NULL), rc);
     }
 
-    // 2. Get cursor position using multiple strategies
-    RECT rc = {0, 0, 0, 0};
-    ITfContextView *pView;
-    
-    if (SUCCEEDED(pContext->GetActiveView(&pView)))
+    case CARET_CARET_POS:
     {
-        DebugLog(L"_UpdateCandidateWindow: Got active view");
-        
-        // Strategy 1: Try GetTextExt with synchronous session
-        CGetTextExtEditSession *pSession = new CGetTextExtEditSession(this, pContext, pView);
-        HRESULT hrSession;
-        HRESULT hr = pContext->RequestEditSession(_tfClientId, pSession, TF_ES_SYNC | TF_ES_READ, &hrSession);
-        
-        if (hr == TF_E_SYNCHRONOUS)
-        {
-            DebugLog(L"_UpdateCandidateWindow: Sync request rejected, trying async");
-            hr = pContext->RequestEditSession(_tfClientId, pSession, TF_ES_ASYNCDONTCARE | TF_ES_READ, NULL);
-        }
-        
-        if (SUCCEEDED(hr))
-        {
-            rc = pSession->GetRect();
-            DebugLog(L"_UpdateCandidateWindow: GetTextExt returned rect: (%d, %d, %d, %d)", 
-                rc.left, rc.top, rc.right, rc.bottom);
-        }
-        else
+        POINT ptCaret;
+        HWND hwndFocus = GetFocus();
+        if (!GetCaretPos(&ptCaret) || hwndFocus == NULL || !ClientToScreen(hwndFocus, &ptCaret))
         {
-            DebugLog(L"_UpdateCandidateWindow: RequestEditSession failed, hr=0x%08X", hr);
+            return false;
         }
-        
-        pSession->Release();
-        
-        // Strategy 2: If rect is still empty, try GetGUIThreadInfo
-        if (rc.left == 0 && rc.top == 0 && rc.right == 0 && rc.bottom == 0)
+        rc.left = ptCaret.x;
+        rc.top = ptCaret.y;
+        rc.right = rc.left + Config::CaretPosition::FALLBACK_WIDTH;
+        rc.bottom = rc.top + Config::CaretPosition::FALLBACK_HEIGHT;
+        return true;
+    }
+
+    case CARET_MOUSE:
+    {
+        // Below the pointer, to avoid covering the text under it
+        POINT pt;
+        if (!GetCursorPos(&pt))
         {
-            DebugLog(L"_UpdateCandidateWindow: GetTextExt failed, trying GetGUIThreadInfo");
-            
-            HWND hwnd = NULL;
-            HRESULT hrGetWnd = pView->GetWnd(&hwnd);
-            
-            if (SUCCEEDED(hrGetWnd) && hwnd != NULL)
-            {
-                DebugLog(L"_UpdateCandidateWindow: pView->GetWnd returned hwnd=0x%p", hwnd);
-                
-                DWORD threadId = GetWindowThreadProcessId(hwnd, NULL);
-                DebugLog(L"_UpdateCandidateWindow: Target window threadId=%d", threadId);
-                
-                GUITHREADINFO gti = {0};
-                gti.cbSize = sizeof(gti);
-                BOOL gtiRes = FALSE;
-                
-                if (threadId != 0)
-                {
-                    gtiRes = GetGUIThreadInfo(threadId, &gti);
-                }
-                
-                DebugLog(L"_UpdateCandidateWindow: GetGUIThreadInfo returned %d, lastError=%d", gtiRes, GetLastError());
-                
-                if (gtiRes && gti.hwndFocus != NULL)
-                {
-                    // rcCaret is in client coordinates, convert to screen
-                    POINT ptTopLeft = { gti.rcCaret.left, gti.rcCaret.top };
-                    POINT ptBottomRight = { gti.rcCaret.right, gti.rcCaret.bottom };
-                    
-                    // Use focus window instead of hwnd for coordinate conversion
-                    if (ClientToScreen(gti.hwndFocus, &ptTopLeft) && ClientToScreen(gti.hwndFocus, &ptBottomRight))
-                    {
-                        rc.left = ptTopLeft.x;
-                        rc.top = ptTopLeft.y;
-                        rc.right = ptBottomRight.x;
-                        rc.bottom = ptBottomRight.y;
-                        
-                        DebugLog(L"_UpdateCandidateWindow: Used GetGUIThreadInfo caret (screen): (%d, %d, %d, %d)", 
-                            rc.left, rc.top, rc.right, rc.bottom);
-                    }
-                    else
-                    {
-                        DebugLog(L"_UpdateCandidateWindow: ClientToScreen failed, error=%d", GetLastError());
-                    }
-                }
-            }
-            else
-            {
-                DebugLog(L"_UpdateCandidateWindow: pView->GetWnd failed or returned NULL, hr=0x%08X", hrGetWnd);
-            }
-            
-            // Strategy 3: Try using foreground window if we still don't have position
-            if (rc.left == 0 && rc.top == 0 && rc.right == 0 && rc.bottom == 0)
-            {
-                DebugLog(L"_UpdateCandidateWindow: Trying foreground window");
-                
-                HWND hwndFG = GetForegroundWindow();
-                if (hwndFG != NULL)
-                {
-                    DWORD threadId = GetWindowThreadProcessId(hwndFG, NULL);
-                    GUITHREADINFO gti = {0};
-                    gti.cbSize = sizeof(gti);
-                    
-                    if (GetGUIThreadInfo(threadId, &gti) && gti.hwndFocus != NULL)
-                    {
-                        POINT ptTopLeft = { gti.rcCaret.left, gti.rcCaret.top };
-                        POINT ptBottomRight = { gti.rcCaret.right, gti.rcCaret.bottom };
-                        
-                        if (ClientToScreen(gti.hwndFocus, &ptTopLeft) && ClientToScreen(gti.hwndFocus, &ptBottomRight))
-                        {
-                            rc.left = ptTopLeft.x;
-                            rc.top = ptTopLeft.y;
-                            rc.right = ptBottomRight.x;
-                            rc.bottom = ptBottomRight.y;
-                            
-                            DebugLog(L"_UpdateCandidateWindow: Used foreground window caret: (%d, %d, %d, %d)", 
-                                rc.left, rc.top, rc.right, rc.bottom);
-                        }
-                    }
-                }
-            }
-            
-            // Strategy 4: Try GetCaretPos as last resort before mouse fallback
-            if (rc.left == 0 && rc.top == 0 && rc.right == 0 && rc.bottom == 0)
-            {
-                DebugLog(L"_UpdateCandidateWindow: Trying GetCaretPos");
-                
-                POINT ptCaret;
-                if (GetCaretPos(&ptCaret))
-                {
-                    HWND hwndFocus = GetFocus();
-                    if (hwndFocus != NULL && ClientToScreen(hwndFocus, &ptCaret))
-                    {
-                        rc.left = ptCaret.x;
-                        rc.top = ptCaret.y;
-                        rc.right = rc.left + Config::CaretPosition::FALLBACK_WIDTH;
-                        rc.bottom = rc.top + Config::CaretPosition::FALLBACK_HEIGHT;
-                        DebugLog(L"_UpdateCandidateWindow: Used GetCaretPos: (%d, %d)", rc.left, rc.top);
-                    }
-                }
-                else
-                {
-                    DebugLog(L"_UpdateCandidateWindow: GetCaretPos failed, lastError=%d", GetLastError());
-                }
-            }
+            return false;
         }
-        
-        pView->Release();
+        rc.left = rc.right = pt.x;
+        rc.top = rc.bottom = pt.y + Config::CaretPosition::MOUSE_FALLBACK_Y_OFFSET;
+        return true;
     }
-    else
+
+    default:
+        return false;
+    }
+}
+
+// The key CCaretLocator remembers a strategy under: the context's view
+// window, or the context itself if it has none. The view window is also
+// returned through `phwndView` if given.
+uintptr_t CTextService::_CaretWindowKey(ITfContext *pContext, HWND *phwndView)
+{
+    HWND hwndView = NULL;
+    ITfContextView *pView;
+    if (SUCCEEDED(pContext->GetActiveView(&pView)))
     {
-        DebugLog(L"_UpdateCandidateWindow: GetActiveView failed");
+        pView->GetWnd(&hwndView);
+        pView->Release();
     }
-    
-    DebugLog(L"_UpdateCandidateWindow: Final cursor rect: (%d, %d, %d, %d)", rc.left, rc.top, rc.right, rc.bottom);
+    if (phwndView) *phwndView = hwndView;
+    return hwndView ? (uintptr_t)hwndView : (uintptr_t)pContext;
+}
+
+void CTextService::_UpdateCandidateWindow(ITfContext *pContext, const RECT *prcText)
+{
+    if (!_pCandidateWindow) return;
+
+    // 1. The composition engine has queried the candidates already
+
+    // 2. Find the caret, starting with the strategy that worked last time
+    // in this window
+    HWND hwndView = NULL;
+    uintptr_t window = _CaretWindowKey(pContext, &hwndView);
+
+    // Without an extent, CARET_TEXT_EXT cannot answer and must not make
+    // the locator forget that it works in this window
+    RECT rcText = {0, 0, 0, 0};
+    if (prcText) rcText = *prcText;
+    CaretRect rc = {0, 0, 0, 0};
+    CaretStrategy strategy = _caretLocator.Locate(window, [&](CaretStrategy s, CaretRect& out) {
+        return ProbeCaret(s, hwndView, rcText, out);
+    }, rc, prcText != NULL);
 
-    // 3. Prepare show coordinates with fallback
-    bool valid = !(rc.left == 0 && rc.top == 0 && rc.right == 0 && rc.bottom == 0);
+    // 3. Prepare show coordinates: below the caret
     POINT showPt = {0, 0};
-    
-    if (valid)
+    if (strategy != CARET_NONE)
     {
-        // Prefer bottom-left of caret so candidate window appears below the caret
         showPt.x = rc.left;
         showPt.y = (rc.bottom != 0) ? rc.bottom : rc.top;
-        DebugLog(L"_UpdateCandidateWindow: Using caret position: (%d, %d)", showPt.x, showPt.y);
     }
     else
     {
-        // Strategy 5: Fallback to mouse cursor position
-        POINT pt;
-        if (GetCursorPos(&pt))
-        {
-            showPt = pt;
-            showPt.y += Config::CaretPosition::MOUSE_FALLBACK_Y_OFFSET; // offset to avoid covering text
-            DebugLog(L"_UpdateCandidateWindow: Falling back to mouse position: (%d, %d)", showPt.x, showPt.y);
-        }
-        else
+        // Last resort: small offset from (0,0) to avoid top-left
+        showPt.x = Config::CaretPosition::DEFAULT_POSITION_X;
+        showPt.y = Config::CaretPosition::DEFAULT_POSITION_Y;
+    }
+
+    DebugTrace(L"_UpdateCandidateWindow: Composition=%s, %d candidates at (%d, %d) via %S",
+        _composer.Composition().c_str(), _composer.PageLength(), showPt.x, showPt.y,
+        CCaretLocator::StrategyName(strategy));
+    if (++_caretLocates % Config::CaretPosition::STATS_LOG_INTERVAL == 0)
+    {
+        for (int i = 0; i < CARET_STRATEGY_COUNT; ++i)
         {
-            // Last resort: small offset from (0,0) to avoid top-left
-            showPt.x = Config::CaretPosition::DEFAULT_POSITION_X;
-            showPt.y = Config::CaretPosition::DEFAULT_POSITION_Y;
-            DebugLog(L"_UpdateCandidateWindow: GetCursorPos failed, using default position: (%d, %d)", showPt.x, showPt.y);
+            const CaretStrategyStats& stats = _caretLocator.Stats((CaretStrategy)i);
+            DebugLog(L"Caret strategy %S: %llu hits of %llu attempts, %llu us total",
+                CCaretLocator::StrategyName((CaretStrategy)i), stats.hits, stats.attempts, stats.totalNs / 1000);
         }
     }
-
-    DebugLog(L"_UpdateCandidateWindow: Final candidate window position: (%d, %d)", showPt.x, showPt.y);
     
-    // Cache position for up/down key navigation
-    _lastCandidateX = showPt.x;
-    _lastCandidateY = showPt.y;
-    
-    _pCandidateWindow->Show(showPt.x, showPt.y, _candidateList, _selectedCandidateIndex);
+    _pCandidateWindow->Show(showPt.x, showPt.y, _composer.Candidates(), _composer.PageStart(), _composer.PageLength(),
+                            _composer.Selection());
 }
 
 // Public method for candidate window callback
@@ -654,19 +609,19 @@ void CTextService::CommitCandidate(ITfContext *pContext, int index)
     DebugLog(L"CommitCandidate: index=%d", index);
     
     // Validate parameters
-    if (!pContext || index < 0 || index >= (int)_candidateList.size())
+    if (!pContext)
     {
-        DebugLog(L"CommitCandidate: Invalid parameters, context=%p, index=%d, candidateList.size=%d", 
-            pContext, index, _candidateList.size());
+        DebugLog(L"CommitCandidate: No context");
         return;
     }
-    
-    // Get the candidate text
-    std::wstring commitText = _candidateList[index];
-    DebugLog(L"CommitCandidate: Committing candidate='%s'", commitText.c_str());
-    
-    // Use helper method to commit
-    _CommitCandidateText(pContext, commitText);
+
+    CompositionResult result = _composer.SelectCandidate(index);
+    if (!result.eaten)
+    {
+        DebugLog(L"CommitCandidate: Invalid index=%d, page size=%d", index, _composer.PageLength());
+        return;
+    }
+    _ApplyResult(pContext, result);
 }
 
 // Get current active context
@@ -0,0 +1,218 @@
+#include "TypoCorrector.h"
+#include "PinyinSyllables.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+static const int kAdjacentCost = 1;
+static const int kIndelCost = 2;
+static const int kTransposeCost = 2;
+static const int kSubstituteCost = 3;
+
+// ---------------------------------------------------------
+// QWERTY adjacency
+// ---------------------------------------------------------
+
+// Letters are neighbours when they share a row and touch, or sit on
+// adjacent rows less than one key apart once row stagger is applied.
+struct KeyboardAdjacency
+{
+    bool adjacent[26][26];
+
+    KeyboardAdjacency()
+    {
+        static const char* const rows[] = { "qwertyuiop", "asdfghjkl", "zxcvbnm" };
+        static const double stagger[] = { 0.0, 0.25, 0.75 };
+
+        double x[26] = {};
+        int row[26] = {};
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int i = 0; rows[r][i]; ++i)
+            {
+                x[rows[r][i] - 'a'] = stagger[r] + i;
+                row[rows[r][i] - 'a'] = r;
+            }
+        }
+
+        for (int a = 0; a < 26; ++a)
+        {
+            for (int b = 0; b < 26; ++b)
+            {
+                double dx = std::fabs(x[a] - x[b]);
+                int dr = std::abs(row[a] - row[b]);
+                adjacent[a][b] = a != b && ((dr == 0 && dx <= 1.0) || (dr == 1 && dx < 1.0));
+            }
+        }
+    }
+};
+
+int TypoSubstitutionCost(char intended, char typed)
+{
+    static const KeyboardAdjacency keyboard;
+    if (intended == typed) return 0;
+    if (intended < 'a' || intended > 'z' || typed < 'a' || typed > 'z') return kSubstituteCost;
+    return keyboard.adjacent[intended - 'a'][typed - 'a'] ? kAdjacentCost : kSubstituteCost;
+}
+
+// ---------------------------------------------------------
+// Bounded trie walk
+// ---------------------------------------------------------
+
+// Depth-first walk over syllable sequences, carrying one weighted
+// Damerau-Levenshtein row per depth: rows[d][j] is the cost of turning the
+// first j typed letters into the d-letter path. A cell with |d - j| letters
+// of length mismatch costs at least that many indels, so only the diagonal
+// band of width maxCost / kIndelCost is computed and each row is O(1).
+// Branches whose best cell exceeds maxCost are pruned; every row computed
+// counts against the budget.
+class CTypoSearch
+{
+public:
+    CTypoSearch(const char* key, size_t len, const TypoSearchLimits& limits, std::pmr::vector<TypoCandidate>& out)
+        : _key(key), _len(len), _limits(limits), _out(out), _memory(out.get_allocator().resource()),
+          _work(0), _exhausted(false), _rows(_memory), _path(_memory), _index(_memory)
+    {
+        _band = limits.maxCost / kIndelCost;
+        _infinity = limits.maxCost + 1;
+        _maxDepth = len + _band;
+        _width = len + 1;
+        _rows.assign((_maxDepth + 1) * _width, _infinity);
+        _path.assign(_maxDepth, '\0');
+        for (size_t j = 0; j <= std::min(len, _band); ++j) _rows[j] = (int)j * kIndelCost;
+    }
+
+    TypoSearchResult Run()
+    {
+        _Visit(0, 0, 0);
+        return { _work, _exhausted };
+    }
+
+private:
+    int* _Row(size_t depth) { return &_rows[depth * _width]; }
+
+    size_t _BandLow(size_t depth) const { return depth > _band ? depth - _band : 0; }
+    size_t _BandHigh(size_t depth) const { return std::min(_len, depth + _band); }
+
+    void _Visit(size_t depth, size_t node, int syllables)
+    {
+        const int* row = _Row(depth);
+        size_t low = _BandLow(depth);
+        size_t high = _BandHigh(depth);
+        if (depth > 0 && high == _len)
+        {
+            int cost = row[_len];
+            if (cost > 0 && cost <= _limits.maxCost) _Record(depth, cost, SyllableTrieIsTerminal(node), syllables);
+        }
+        if (depth == _maxDepth || low > high) return;
+        if (*std::min_element(row + low, row + high + 1) > _limits.maxCost) return;
+
+        // Letters continuing the current syllable, and after a full syllable
+        // letters starting the next one. The typed letter goes first so cheap
+        // paths are found before the budget runs out.
+        char letters[2][26];
+        size_t children[2][26];
+        size_t counts[2] = { SyllableTrieChildren(node, letters[0], children[0]), 0 };
+        if (node != 0 && SyllableTrieIsTerminal(node))
+            counts[1] = SyllableTrieChildren(0, letters[1], children[1]);
+        char preferred = depth < _len ? _key[depth] : '\0';
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (int source = 0; source < 2; ++source)
+            {
+                for (size_t k = 0; k < counts[source]; ++k)
+                {
+                    char c = letters[source][k];
+                    if ((pass == 0) != (c == preferred)) continue;
+                    if (_work >= _limits.workBudget)
+                    {
+                        _exhausted = true;
+                        return;
+                    }
+                    _Extend(depth, c);
+                    _Visit(depth + 1, children[source][k], source == 1 || node == 0 ? syllables + 1 : syllables);
+                    if (_exhausted) return;
+                }
+            }
+        }
+    }
+
+    void _Extend(size_t depth, char c)
+    {
+        _work++;
+        _path[depth] = c;
+        const int* prev = _Row(depth);
+        int* row = _Row(depth + 1);
+
+        // Cells just outside the band read as infinity for this row and the next
+        size_t low = _BandLow(depth + 1);
+        size_t high = _BandHigh(depth + 1);
+        if (low > 0) row[low - 1] = _infinity;
+        if (high < _len) row[high + 1] = _infinity;
+
+        for (size_t j = low; j <= high; ++j)
+        {
+            int best = prev[j] + kIndelCost;                    // Letter missing from the input
+            if (j > 0)
+            {
+                best = std::min(best, prev[j - 1] + TypoSubstitutionCost(c, _key[j - 1]));
+                best = std::min(best, row[j - 1] + kIndelCost); // Extra letter in the input
+            }
+            if (depth > 0 && j > 1 && c == _key[j - 2] && _path[depth - 1] == _key[j - 1])
+                best = std::min(best, _Row(depth - 1)[j - 2] + kTransposeCost);
+            row[j] = std::min(best, _infinity);
+        }
+    }
+
+    void _Record(size_t depth, int cost, bool complete, int syllables)
+    {
+        std::pmr::string key(_path.data(), depth, _memory);
+        auto it = _index.find(key);
+        if (it != _index.end())
+        {
+            // Same letters reached through a different syllable split
+            TypoCandidate& existing = _out[it->second];
+            existing.cost = std::min(existing.cost, cost);
+            existing.complete = existing.complete || complete;
+            existing.syllables = std::min(existing.syllables, syllables);
+            return;
+        }
+        _index.emplace(key, _out.size());
+        _out.push_back({ std::move(key), cost, complete, syllables });
+    }
+
+    const char* _key;
+    size_t _len;
+    const TypoSearchLimits& _limits;
+    std::pmr::vector<TypoCandidate>& _out;
+    std::pmr::memory_resource* _memory;
+    size_t _work;
+    bool _exhausted;
+    size_t _band;
+    int _infinity;
+    size_t _maxDepth;
+    size_t _width;
+    std::pmr::vector<int> _rows;
+    std::pmr::vector<char> _path;
+    std::pmr::unordered_map<std::pmr::string, size_t> _index;
+};
+
+TypoSearchResult FindTypoCorrections(const char* key, size_t len, const TypoSearchLimits& limits,
+                                     std::pmr::vector<TypoCandidate>& out)
+{
+    out.clear();
+    if (len == 0) return { 0, false };
+
+    CTypoSearch search(key, len, limits, out);
+    TypoSearchResult result = search.Run();
+
+    std::sort(out.begin(), out.end(), [](const TypoCandidate& a, const TypoCandidate& b) {
+        if (a.cost != b.cost) return a.cost < b.cost;
+        if (a.complete != b.complete) return a.complete;
+        if (a.syllables != b.syllables) return a.syllables < b.syllables;
+        return a.key < b.key;
+    });
+    if (out.size() > limits.maxResults) out.resize(limits.maxResults);
+    return result;
+}
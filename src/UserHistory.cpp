@@ -0,0 +1,720 @@
+#include "UserHistory.h"
+#include "Globals.h"
+#include "Config.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+static std::string ToUtf8(const std::wstring& text)
+{
+    if (text.empty()) return std::string();
+    int size = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.length(), NULL, 0, NULL, NULL);
+    std::string result(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.length(), &result[0], size, NULL, NULL);
+    return result;
+}
+
+static std::wstring FromUtf8(const char* text)
+{
+    int size = MultiByteToWideChar(CP_UTF8, 0, text, -1, NULL, 0);
+    if (size <= 1) return std::wstring();
+    std::wstring result(size - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text, -1, &result[0], size);
+    return result;
+}
+
+// ---------------------------------------------------------
+// Journal records
+// ---------------------------------------------------------
+
+// Records carry the resulting state rather than the change, so replaying
+// one that user.db already contains is harmless:
+//   'R' key hanzi count lastUsed            (selection count)
+//   'W' key initials hanzi priority created (overlay word)
+//   'S' word next count lastUsed            (next word)
+// Strings are a u16 length and UTF-8 bytes, integers 8 bytes little-endian.
+
+static void PutString(std::string& out, const std::string& value)
+{
+    size_t len = value.length() < 0xFFFF ? value.length() : 0xFFFF;
+    out += (char)(len & 0xFF);
+    out += (char)(len >> 8);
+    out.append(value, 0, len);
+}
+
+static void PutInt(std::string& out, long long value)
+{
+    for (int i = 0; i < 8; ++i) out += (char)((unsigned long long)value >> (i * 8));
+}
+
+struct RecordReader
+{
+    const unsigned char* data;
+    size_t left;
+
+    bool String(std::string& value)
+    {
+        if (left < 2) return false;
+        size_t len = data[0] | (data[1] << 8);
+        if (left - 2 < len) return false;
+        value.assign((const char*)data + 2, len);
+        data += 2 + len;
+        left -= 2 + len;
+        return true;
+    }
+
+    bool Int(long long& value)
+    {
+        if (left < 8) return false;
+        unsigned long long bits = 0;
+        for (int i = 7; i >= 0; --i) bits = (bits << 8) | data[i];
+        value = (long long)bits;
+        data += 8;
+        left -= 8;
+        return true;
+    }
+};
+
+CUserHistory::CUserHistory() : _db(NULL), _journalPending(false), _stopping(false)
+{
+}
+
+CUserHistory::~CUserHistory()
+{
+    // Destroyed as a static at DLL detach, under the loader lock, where
+    // joining a thread can deadlock. Deactivate and DllCanUnloadNow flush,
+    // so the writer has normally exited by now. If it has not (the host
+    // skipped both, or process exit killed it mid-write), abandon it and
+    // leave the files it may be using alone; the journal replays on the
+    // next Open.
+    if (_writer.joinable())
+    {
+        _writer.detach();
+        return;
+    }
+    _journal.Close();
+    if (_db)
+    {
+        sqlite3_close(_db);
+        _db = NULL;
+    }
+}
+
+std::wstring CUserHistory::_MakeId(const std::string& key, const std::wstring& hanzi)
+{
+    std::wstring id(key.begin(), key.end());    // Keys are ASCII
+    id += L'\t';
+    id += hanzi;
+    return id;
+}
+
+bool CUserHistory::Open(const std::wstring& path)
+{
+    if (_db) return true;
+
+    if (sqlite3_open16(path.c_str(), &_db) != SQLITE_OK)
+    {
+        DebugLog(L"UserHistory: Failed to open %s: %S", path.c_str(), sqlite3_errmsg(_db));
+        sqlite3_close(_db);
+        _db = NULL;
+        return false;
+    }
+
+    const char* schema =
+        "PRAGMA journal_mode=WAL;"
+        "PRAGMA synchronous=NORMAL;"
+        "CREATE TABLE IF NOT EXISTS user_history ("
+        "  pinyin TEXT NOT NULL,"
+        "  hanzi TEXT NOT NULL,"
+        "  count INTEGER NOT NULL,"
+        "  last_used INTEGER NOT NULL,"
+        "  PRIMARY KEY (pinyin, hanzi)"
+        ") WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS user_lexicon ("
+        "  pinyin_clean TEXT NOT NULL,"
+        "  initials TEXT NOT NULL,"
+        "  hanzi TEXT NOT NULL,"
+        "  priority INTEGER NOT NULL,"
+        "  created INTEGER NOT NULL,"
+        "  PRIMARY KEY (pinyin_clean, hanzi)"
+        ") WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS user_successors ("
+        "  word TEXT NOT NULL,"
+        "  next TEXT NOT NULL,"
+        "  count INTEGER NOT NULL,"
+        "  last_used INTEGER NOT NULL,"
+        "  PRIMARY KEY (word, next)"
+        ") WITHOUT ROWID;";
+    char* error = NULL;
+    if (sqlite3_exec(_db, schema, NULL, NULL, &error) != SQLITE_OK)
+    {
+        DebugLog(L"UserHistory: Schema setup failed: %S", error ? error : "unknown");
+        sqlite3_free(error);
+        sqlite3_close(_db);
+        _db = NULL;
+        return false;
+    }
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(_db, "SELECT pinyin, hanzi, count, last_used FROM user_history;", -1, &stmt, 0) == SQLITE_OK)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const unsigned char* pinyin = sqlite3_column_text(stmt, 0);
+            const unsigned char* hanzi = sqlite3_column_text(stmt, 1);
+            if (!pinyin || !hanzi) continue;
+
+            Entry entry;
+            entry.count = sqlite3_column_int(stmt, 2);
+            entry.lastUsed = sqlite3_column_int64(stmt, 3);
+            _entries[_MakeId((const char*)pinyin, FromUtf8((const char*)hanzi))] = entry;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    const char* loadWords = "SELECT pinyin_clean, initials, hanzi, priority, created FROM user_lexicon ORDER BY pinyin_clean;";
+    if (sqlite3_prepare_v2(_db, loadWords, -1, &stmt, 0) == SQLITE_OK)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const unsigned char* key = sqlite3_column_text(stmt, 0);
+            const unsigned char* initials = sqlite3_column_text(stmt, 1);
+            const unsigned char* hanzi = sqlite3_column_text(stmt, 2);
+            if (!key || !initials || !hanzi) continue;
+
+            UserWord word;
+            word.key = (const char*)key;
+            word.initials = (const char*)initials;
+            word.hanzi = FromUtf8((const char*)hanzi);
+            word.priority = sqlite3_column_int(stmt, 3);
+            word.created = sqlite3_column_int64(stmt, 4);
+            _words.push_back(word);
+        }
+        sqlite3_finalize(stmt);
+        _IndexInitials();
+    }
+
+    if (sqlite3_prepare_v2(_db, "SELECT word, next, count, last_used FROM user_successors;", -1, &stmt, 0) == SQLITE_OK)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const unsigned char* word = sqlite3_column_text(stmt, 0);
+            const unsigned char* next = sqlite3_column_text(stmt, 1);
+            if (!word || !next) continue;
+
+            Successor successor;
+            successor.next = FromUtf8((const char*)next);
+            successor.count = sqlite3_column_int(stmt, 2);
+            successor.lastUsed = sqlite3_column_int64(stmt, 3);
+            _MergeSuccessor(FromUtf8((const char*)word), successor);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    DebugLog(L"UserHistory: Loaded %d entries, %d user words and next words for %d words from %s", _entries.size(),
+             _words.size(), _successors.size(), path.c_str());
+
+    // Learning that had not reached user.db when the host last exited, in
+    // user.journal next to it
+    std::wstring journalPath = path;
+    size_t dot = journalPath.find_last_of(L'.');
+    if (dot != std::wstring::npos && dot > journalPath.find_last_of(L"\\/") + 1) journalPath.erase(dot);
+    journalPath += L".journal";
+    std::lock_guard<std::mutex> guard(_lock);
+    long replayed = _journal.Open(journalPath, [this](const char* payload, size_t len) { _Replay(payload, len); });
+    if (replayed < 0)
+    {
+        DebugLog(L"UserHistory: Cannot open journal %s; learning is kept until the next batch only", journalPath.c_str());
+    }
+    else if (replayed > 0)
+    {
+        DebugLog(L"UserHistory: Replayed %d journal records", replayed);
+        _StartWriter();
+    }
+    return true;
+}
+
+// Called with _lock held.
+void CUserHistory::_Replay(const char* payload, size_t len)
+{
+    RecordReader reader = { (const unsigned char*)payload, len };
+    if (reader.left < 1) return;
+    char type = (char)*reader.data;
+    reader.data++;
+    reader.left--;
+
+    std::string key;
+    std::string hanzi;
+    if (type == 'R')
+    {
+        long long count, lastUsed;
+        if (!reader.String(key) || !reader.String(hanzi) || !reader.Int(count) || !reader.Int(lastUsed)) return;
+
+        std::wstring id = _MakeId(key, FromUtf8(hanzi.c_str()));
+        Entry& entry = _entries[id];
+        entry.count = (int)count;
+        entry.lastUsed = lastUsed;
+        _dirty.insert(id);
+    }
+    else if (type == 'W')
+    {
+        UserWord word;
+        long long priority;
+        if (!reader.String(word.key) || !reader.String(word.initials) || !reader.String(hanzi) ||
+            !reader.Int(priority) || !reader.Int(word.created)) return;
+
+        word.hanzi = FromUtf8(hanzi.c_str());
+        word.priority = (int)priority;
+        if (_MergeWord(word)) _pendingWords.push_back(word);
+    }
+    else if (type == 'S')
+    {
+        SuccessorUpdate update;
+        long long count;
+        if (!reader.String(key) || !reader.String(hanzi) || !reader.Int(count) ||
+            !reader.Int(update.successor.lastUsed)) return;
+
+        update.word = FromUtf8(key.c_str());
+        update.successor.next = FromUtf8(hanzi.c_str());
+        update.successor.count = (int)count;
+        if (_MergeSuccessor(update.word, update.successor)) _pendingSuccessors.push_back(update);
+    }
+}
+
+void CUserHistory::Record(const std::string& key, const std::wstring& hanzi)
+{
+    if (key.empty() || hanzi.empty()) return;
+
+    std::lock_guard<std::mutex> guard(_lock);
+    std::wstring id = _MakeId(key, hanzi);
+    Entry& entry = _entries[id];
+    entry.count++;
+    entry.lastUsed = (long long)time(NULL);
+
+    if (!_db) return;   // Learning still works in memory for this session
+
+    std::string record(1, 'R');
+    PutString(record, key);
+    PutString(record, ToUtf8(hanzi));
+    PutInt(record, entry.count);
+    PutInt(record, entry.lastUsed);
+    _journal.Append(record);
+    _journalPending = true;
+
+    _dirty.insert(id);
+    if (!_writer.joinable()) _StartWriter();
+    _wake.notify_one();
+}
+
+void CUserHistory::GetCounts(const std::string& key, const CCandidateList& candidates, size_t first,
+                             std::pmr::vector<int>& counts) const
+{
+    counts.assign(candidates.Size() - first, 0);
+
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_entries.empty()) return;
+
+    // Same layout as _MakeId
+    _lookupId.assign(key.begin(), key.end());
+    _lookupId += L'\t';
+    size_t prefix = _lookupId.length();
+    for (size_t i = first; i < candidates.Size(); ++i)
+    {
+        _lookupId.resize(prefix);
+        _lookupId.append(candidates.Text(i), candidates.Length(i));
+        auto it = _entries.find(_lookupId);
+        if (it != _entries.end()) counts[i - first] = it->second.count;
+    }
+}
+
+void CUserHistory::AddWord(const std::string& key, const std::string& initials, const std::wstring& hanzi, int priority)
+{
+    if (key.empty() || hanzi.empty()) return;
+
+    UserWord word;
+    word.key = key;
+    word.initials = initials;
+    word.hanzi = hanzi;
+    word.priority = priority;
+    word.created = (long long)time(NULL);
+
+    std::lock_guard<std::mutex> guard(_lock);
+    if (!_MergeWord(word) || !_db) return;
+
+    std::string record(1, 'W');
+    PutString(record, word.key);
+    PutString(record, word.initials);
+    PutString(record, ToUtf8(word.hanzi));
+    PutInt(record, word.priority);
+    PutInt(record, word.created);
+    _journal.Append(record);
+    _journalPending = true;
+
+    _pendingWords.push_back(word);
+    if (!_writer.joinable()) _StartWriter();
+    _wake.notify_one();
+}
+
+// Called with _lock held. Inserts `word` into the overlay, or raises the
+// priority of the existing entry; false if nothing changed.
+bool CUserHistory::_MergeWord(const UserWord& word)
+{
+    auto it = std::lower_bound(_words.begin(), _words.end(), word.key,
+        [](const UserWord& entry, const std::string& k) { return entry.key < k; });
+    for (auto scan = it; scan != _words.end() && scan->key == word.key; ++scan)
+    {
+        if (scan->hanzi == word.hanzi)
+        {
+            if (scan->priority >= word.priority) return false;
+            scan->priority = word.priority;
+            return true;
+        }
+    }
+
+    if (_words.size() >= (size_t)Config::UserHistory::MAX_USER_WORDS)
+    {
+        DebugLog(L"UserHistory: Overlay full, not adding '%s'", word.hanzi.c_str());
+        return false;
+    }
+    // Positions at and after the new word move up by one
+    uint32_t position = (uint32_t)(it - _words.begin());
+    _words.insert(it, word);
+    for (uint32_t& index : _byInitials)
+    {
+        if (index >= position) index++;
+    }
+    auto at = std::upper_bound(_byInitials.begin(), _byInitials.end(), word.initials,
+        [this](const std::string& i, uint32_t entry) { return i < _words[entry].initials; });
+    _byInitials.insert(at, position);
+    return true;
+}
+
+// Called with _lock held. Rebuilds the initials order of the whole overlay.
+void CUserHistory::_IndexInitials()
+{
+    _byInitials.resize(_words.size());
+    for (size_t i = 0; i < _words.size(); ++i) _byInitials[i] = (uint32_t)i;
+    std::sort(_byInitials.begin(), _byInitials.end(),
+        [this](uint32_t a, uint32_t b) { return _words[a].initials < _words[b].initials; });
+}
+
+void CUserHistory::FindWords(const std::string& prefix, bool initials, RankedStream& stream) const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+
+    if (!initials)
+    {
+        // The overlay is sorted by key, so pinyin matches are one run
+        auto it = std::lower_bound(_words.begin(), _words.end(), prefix,
+            [](const UserWord& entry, const std::string& p) { return entry.key < p; });
+        for (; it != _words.end() && it->key.compare(0, prefix.length(), prefix) == 0; ++it)
+        {
+            stream.Add(it->hanzi.data(), it->hanzi.length(), (int)it->key.length(), it->priority);
+        }
+        return;
+    }
+
+    // Initials matches are one run of the initials order
+    auto it = std::lower_bound(_byInitials.begin(), _byInitials.end(), prefix,
+        [this](uint32_t entry, const std::string& p) { return _words[entry].initials < p; });
+    for (; it != _byInitials.end() && _words[*it].initials.compare(0, prefix.length(), prefix) == 0; ++it)
+    {
+        const UserWord& word = _words[*it];
+        stream.Add(word.hanzi.data(), word.hanzi.length(), (int)word.initials.length(), word.priority);
+    }
+}
+
+void CUserHistory::FindMixedWords(const std::string& key, const MixedReading* readings, size_t count, RankedStream& stream) const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+
+    for (const UserWord& word : _words)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (MatchesMixedReading(key.data(), readings[i], word.key.data(), word.key.length(), word.initials.data(),
+                                    word.initials.length()))
+            {
+                stream.Add(word.hanzi.data(), word.hanzi.length(), (int)word.initials.length(), word.priority);
+                break;
+            }
+        }
+    }
+}
+
+size_t CUserHistory::WordCount() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _words.size();
+}
+
+void CUserHistory::RecordSuccessor(const std::wstring& word, const std::wstring& next)
+{
+    if (word.empty() || next.empty()) return;
+
+    std::lock_guard<std::mutex> guard(_lock);
+    SuccessorUpdate update;
+    update.word = word;
+    update.successor.next = next;
+    update.successor.count = 1;
+    update.successor.lastUsed = (long long)time(NULL);
+    auto it = _successors.find(word);
+    if (it != _successors.end())
+    {
+        for (const Successor& successor : it->second)
+        {
+            if (successor.next == next) update.successor.count = successor.count + 1;
+        }
+    }
+    if (!_MergeSuccessor(word, update.successor) || !_db) return;
+
+    std::string record(1, 'S');
+    PutString(record, ToUtf8(update.word));
+    PutString(record, ToUtf8(update.successor.next));
+    PutInt(record, update.successor.count);
+    PutInt(record, update.successor.lastUsed);
+    _journal.Append(record);
+    _journalPending = true;
+
+    _pendingSuccessors.push_back(update);
+    if (!_writer.joinable()) _StartWriter();
+    _wake.notify_one();
+}
+
+// Called with _lock held. Sets the count of `successor` after `word`,
+// keeping the list most used (then most recent) first and at most
+// MAX_SUCCESSORS long; false if it did not make the list.
+bool CUserHistory::_MergeSuccessor(const std::wstring& word, const Successor& successor)
+{
+    auto it = _successors.find(word);
+    if (it == _successors.end())
+    {
+        if (_successors.size() >= (size_t)Config::UserHistory::MAX_SUCCESSOR_WORDS)
+        {
+            DebugLog(L"UserHistory: Next words full, not learning after '%s'", word.c_str());
+            return false;
+        }
+        it = _successors.emplace(word, std::vector<Successor>()).first;
+    }
+
+    std::vector<Successor>& list = it->second;
+    auto existing = std::find_if(list.begin(), list.end(),
+        [&successor](const Successor& s) { return s.next == successor.next; });
+    if (existing != list.end()) list.erase(existing);
+
+    auto at = std::find_if(list.begin(), list.end(), [&successor](const Successor& s) {
+        return s.count < successor.count || (s.count == successor.count && s.lastUsed < successor.lastUsed);
+    });
+    if (at - list.begin() >= Config::UserHistory::MAX_SUCCESSORS) return false;
+    list.insert(at, successor);
+    if (list.size() > (size_t)Config::UserHistory::MAX_SUCCESSORS) list.pop_back();
+    return true;
+}
+
+void CUserHistory::GetSuccessors(const std::wstring& word, CCandidateList& results, size_t max) const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    auto it = _successors.find(word);
+    if (it == _successors.end()) return;
+
+    for (const Successor& successor : it->second)
+    {
+        if (results.Size() >= max) break;
+        results.Add(successor.next);
+    }
+}
+
+void CUserHistory::Flush()
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (!_writer.joinable()) return;
+        _stopping = true;
+    }
+    _wake.notify_one();
+    _writer.join();
+
+    std::lock_guard<std::mutex> guard(_lock);
+    _stopping = false;
+}
+
+// ---------------------------------------------------------
+// Write-behind thread
+// ---------------------------------------------------------
+
+// Called with _lock held.
+void CUserHistory::_StartWriter()
+{
+    _stopping = false;
+    _writer = std::thread(&CUserHistory::_WriterLoop, this);
+}
+
+void CUserHistory::_WriterLoop()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    for (;;)
+    {
+        _wake.wait(guard, [this]() {
+            return _stopping || !_dirty.empty() || !_pendingWords.empty() || !_pendingSuccessors.empty();
+        });
+
+        // Let a batch accumulate unless we are shutting down. Meanwhile
+        // every update is made durable in the journal as it arrives, in
+        // groups of whatever queued up during the previous fsync.
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(Config::UserHistory::WRITE_DELAY_MS);
+        for (;;)
+        {
+            if (_journalPending) _CommitJournal(guard);
+            if (_stopping || _dirty.size() >= (size_t)Config::UserHistory::WRITE_BATCH) break;
+            if (!_wake.wait_until(guard, deadline, [this]() {
+                    return _stopping || _journalPending || _dirty.size() >= (size_t)Config::UserHistory::WRITE_BATCH;
+                })) break;
+        }
+
+        std::vector<std::pair<std::wstring, Entry>> batch;
+        batch.reserve(_dirty.size());
+        for (const std::wstring& id : _dirty)
+        {
+            batch.push_back(std::make_pair(id, _entries[id]));
+        }
+        _dirty.clear();
+        std::vector<UserWord> words;
+        words.swap(_pendingWords);
+        std::vector<SuccessorUpdate> successors;
+        successors.swap(_pendingSuccessors);
+        bool stopping = _stopping;
+
+        guard.unlock();
+        bool written = (batch.empty() && words.empty() && successors.empty()) || _WriteBatch(batch, words, successors);
+        guard.lock();
+
+        // Keep failed entries dirty for the next round, but do not spin on
+        // a broken database while shutting down
+        if (!written && !stopping)
+        {
+            for (const auto& item : batch) _dirty.insert(item.first);
+            _pendingWords.insert(_pendingWords.begin(), words.begin(), words.end());
+            _pendingSuccessors.insert(_pendingSuccessors.begin(), successors.begin(), successors.end());
+            _wake.wait_for(guard, std::chrono::milliseconds(Config::UserHistory::WRITE_DELAY_MS), [this]() { return _stopping; });
+        }
+        else if (written && (stopping || _journal.Size() >= (size_t)Config::UserHistory::JOURNAL_COMPACT_BYTES))
+        {
+            _CompactJournal(guard);
+        }
+
+        if (stopping && _dirty.empty() && _pendingWords.empty() && _pendingSuccessors.empty()) break;
+    }
+}
+
+// Called with _lock held; releases it during the fsync.
+void CUserHistory::_CommitJournal(std::unique_lock<std::mutex>& guard)
+{
+    _journalPending = false;
+    guard.unlock();
+    bool committed = _journal.Commit();
+    guard.lock();
+    if (!committed) DebugLog(L"UserHistory: Journal commit failed; records stay queued");
+}
+
+// Called with _lock held. Once user.db durably holds everything the journal
+// does, the journal starts over. Only this thread writes user.db, so if
+// nothing is dirty after the checkpoint, every journaled update is in it.
+void CUserHistory::_CompactJournal(std::unique_lock<std::mutex>& guard)
+{
+    guard.unlock();
+    int rc = sqlite3_wal_checkpoint_v2(_db, NULL, SQLITE_CHECKPOINT_FULL, NULL, NULL);
+    guard.lock();
+
+    if (rc != SQLITE_OK || !_dirty.empty() || !_pendingWords.empty() || !_pendingSuccessors.empty()) return;
+    if (_journal.Reset())
+    {
+        _journalPending = false;
+        DebugLog(L"UserHistory: Journal folded into user.db");
+    }
+}
+
+bool CUserHistory::_WriteBatch(const std::vector<std::pair<std::wstring, Entry>>& batch, const std::vector<UserWord>& words,
+                               const std::vector<SuccessorUpdate>& successors)
+{
+    const char* upsert =
+        "INSERT INTO user_history (pinyin, hanzi, count, last_used) VALUES (?, ?, ?, ?) "
+        "ON CONFLICT (pinyin, hanzi) DO UPDATE SET count = excluded.count, last_used = excluded.last_used;";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(_db, upsert, -1, &stmt, 0) != SQLITE_OK)
+    {
+        DebugLog(L"UserHistory: Prepare failed: %S", sqlite3_errmsg(_db));
+        return false;
+    }
+
+    bool ok = sqlite3_exec(_db, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK;
+    for (size_t i = 0; ok && i < batch.size(); ++i)
+    {
+        const std::wstring& id = batch[i].first;
+        size_t tab = id.find(L'\t');
+        std::string pinyin = ToUtf8(id.substr(0, tab));
+        std::string hanzi = ToUtf8(id.substr(tab + 1));
+
+        sqlite3_bind_text(stmt, 1, pinyin.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, hanzi.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 3, batch[i].second.count);
+        sqlite3_bind_int64(stmt, 4, batch[i].second.lastUsed);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    const char* insertWord =
+        "INSERT INTO user_lexicon (pinyin_clean, initials, hanzi, priority, created) VALUES (?, ?, ?, ?, ?) "
+        "ON CONFLICT (pinyin_clean, hanzi) DO UPDATE SET priority = excluded.priority;";
+    if (ok && !words.empty())
+    {
+        ok = sqlite3_prepare_v2(_db, insertWord, -1, &stmt, 0) == SQLITE_OK;
+        for (size_t i = 0; ok && i < words.size(); ++i)
+        {
+            std::string hanzi = ToUtf8(words[i].hanzi);
+            sqlite3_bind_text(stmt, 1, words[i].key.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, words[i].initials.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, hanzi.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 4, words[i].priority);
+            sqlite3_bind_int64(stmt, 5, words[i].created);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+        if (stmt) sqlite3_finalize(stmt);
+    }
+
+    const char* upsertSuccessor =
+        "INSERT INTO user_successors (word, next, count, last_used) VALUES (?, ?, ?, ?) "
+        "ON CONFLICT (word, next) DO UPDATE SET count = excluded.count, last_used = excluded.last_used;";
+    if (ok && !successors.empty())
+    {
+        ok = sqlite3_prepare_v2(_db, upsertSuccessor, -1, &stmt, 0) == SQLITE_OK;
+        for (size_t i = 0; ok && i < successors.size(); ++i)
+        {
+            std::string word = ToUtf8(successors[i].word);
+            std::string next = ToUtf8(successors[i].successor.next);
+            sqlite3_bind_text(stmt, 1, word.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, next.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 3, successors[i].successor.count);
+            sqlite3_bind_int64(stmt, 4, successors[i].successor.lastUsed);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+        if (stmt) sqlite3_finalize(stmt);
+    }
+
+    if (ok && sqlite3_exec(_db, "COMMIT;", NULL, NULL, NULL) == SQLITE_OK)
+    {
+        DebugLog(L"UserHistory: Persisted %d entries, %d user words, %d next words", batch.size(), words.size(),
+                 successors.size());
+        return true;
+    }
+
+    DebugLog(L"UserHistory: Batch write failed: %S", sqlite3_errmsg(_db));
+    sqlite3_exec(_db, "ROLLBACK;", NULL, NULL, NULL);
+    return false;
+}
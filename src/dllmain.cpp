@@ -1,5 +1,6 @@
 #include "Globals.h"
 #include "TextService.h"
+#include "DictionaryEngine.h"
 #include <olectl.h>
 
 HINSTANCE g_hInst = NULL;
@@ -109,5 +110,11 @@ STDAPI DllGetClassObject(REFCLSID rclsid, REFIID riid, void **ppv)
 
 STDAPI DllCanUnloadNow()
 {
-    return (g_cRefDll == 0) ? S_OK : S_FALSE;
+    if (g_cRefDll != 0) return S_FALSE;
+
+    // The engine's threads must be gone before DLL_PROCESS_DETACH, where
+    // its destructor will not wait for them. Not under the loader lock
+    // here, so joining is safe.
+    CDictionaryEngine::Instance().FlushUserData();
+    return S_OK;
 }
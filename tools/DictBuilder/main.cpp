@@ -3,9 +3,87 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <windows.h>
 #include "../../include/sqlite/sqlite3.h"
+#include "../../include/PinyinNormalizer.h"
+#include "../HotPageRecorder.h"
+
+// One row of the generated lexicon. Entries are deduplicated on
+// (hanzi, pinyin_clean) before anything is written to the database.
+struct LexEntry {
+    std::string hanzi;
+    std::string clean;
+    std::string initials;
+    int senses;          // Number of CEDICT lines carrying this (hanzi, reading)
+    bool unihanPrimary;  // First listed reading in pinyin.txt
+    bool fromCedict;
+    bool fromUnihan;
+};
+
+// Counters collected while merging, printed as the coverage report.
+struct BuildStats {
+    int cedictLines = 0;
+    int cedictRecords = 0;
+    int cedictDuplicates = 0;
+    int unihanChars = 0;
+    int unihanPolyphones = 0;
+    int unihanReadings = 0;
+    int unihanAlreadyInCedict = 0;
+    int unihanAdded = 0;
+    int unihanNewChars = 0;
+    int wordReadings = 0;
+    int wordReadingsCovered = 0;
+};
+
+class LexiconBuilder {
+public:
+    // Returns the entry for (hanzi, clean), creating it if needed.
+    LexEntry& Get(const std::string& hanzi, const std::string& clean, const std::string& initials, bool* created) {
+        std::string key = hanzi + '\t' + clean;
+        auto it = _index.find(key);
+        if (it != _index.end()) {
+            *created = false;
+            return _entries[it->second];
+        }
+        LexEntry entry;
+        entry.hanzi = hanzi;
+        entry.clean = clean;
+        entry.initials = initials;
+        entry.senses = 0;
+        entry.unihanPrimary = false;
+        entry.fromCedict = false;
+        entry.fromUnihan = false;
+        _index[key] = _entries.size();
+        _entries.push_back(entry);
+        _hanzi.insert(hanzi);
+        *created = true;
+        return _entries.back();
+    }
+
+    bool HasHanzi(const std::string& hanzi) const { return _hanzi.count(hanzi) != 0; }
+
+    // Count how often a single character is read as `syllable` inside CEDICT words.
+    void AddAttestation(const std::string& ch, const std::string& syllable) {
+        _attestations[ch + '\t' + syllable]++;
+    }
+
+    int Attestations(const std::string& ch, const std::string& syllable) const {
+        auto it = _attestations.find(ch + '\t' + syllable);
+        return it != _attestations.end() ? it->second : 0;
+    }
+
+    const std::unordered_map<std::string, int>& AllAttestations() const { return _attestations; }
+    const std::vector<LexEntry>& Entries() const { return _entries; }
+
+private:
+    std::vector<LexEntry> _entries;
+    std::unordered_map<std::string, size_t> _index;
+    std::unordered_set<std::string> _hanzi;
+    std::unordered_map<std::string, int> _attestations;
+};
 
 // Helper to split string
 std::vector<std::string> Split(const std::string& str, char delimiter) {
@@ -19,11 +97,26 @@ std::vector<std::string> Split(const std::string& str, char delimiter) {
     return tokens;
 }
 
+// Split a UTF-8 string into one string per code point.
+std::vector<std::string> SplitUtf8Chars(const std::string& str) {
+    std::vector<std::string> chars;
+    size_t i = 0;
+    while (i < str.length()) {
+        char32_t cp;
+        size_t n = DecodeUtf8(str.data() + i, str.length() - i, cp);
+        chars.push_back(str.substr(i, n));
+        i += n;
+    }
+    return chars;
+}
+
 // Process CEDICT pinyin: "ni3 hao3" -> "nihao", initials: "nh"
-void ProcessPinyin(const std::string& rawPinyin, std::string& outClean, std::string& outInitials) {
+// Optionally returns the cleaned syllables ("ni", "hao").
+void ProcessPinyin(const std::string& rawPinyin, std::string& outClean, std::string& outInitials,
+                   std::vector<std::string>* outSyllables = nullptr) {
     outClean = "";
     outInitials = "";
-    
+
     std::vector<std::string> syllables = Split(rawPinyin, ' ');
     for (const auto& syl : syllables) {
         std::string cleanSyl;
@@ -37,148 +130,485 @@ void ProcessPinyin(const std::string& rawPinyin, std::string& outClean, std::str
                 }
             }
         }
-        
+
         if (!cleanSyl.empty()) {
             outClean += cleanSyl;
             outInitials += (char)cleanSyl[0];
+            if (outSyllables) outSyllables->push_back(cleanSyl);
         }
     }
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        std::cout << "Usage: DictBuilder <cedict_ts.u8> <output.db>" << std::endl;
-        return 1;
+// Map a frequency count onto a small priority bonus (0..8).
+int FrequencyBucket(int frequency) {
+    int bucket = 0;
+    while (frequency > 1 && bucket < 8) {
+        frequency >>= 1;
+        bucket++;
     }
+    return bucket;
+}
 
-    std::string dictPath = argv[1];
-    std::string dbPath = argv[2];
+// Stage 1: CEDICT words and phrases.
+// Format: Traditional Simplified [pin1 yin1] /English/
+// Example: 你好 你好 [ni3 hao3] /Hello!/
+bool LoadCedict(const std::string& dictPath, LexiconBuilder& builder, BuildStats& stats) {
+    std::ifstream file(dictPath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << dictPath << std::endl;
+        // Try absolute path or check current directory
+        char buf[MAX_PATH];
+        GetCurrentDirectoryA(MAX_PATH, buf);
+        std::cerr << "Current Directory: " << buf << std::endl;
+        return false;
+    }
 
-    // Remove existing db
-    remove(dbPath.c_str());
+    std::cout << "Processing " << dictPath << "..." << std::endl;
 
-    sqlite3* db;
-    if (sqlite3_open(dbPath.c_str(), &db)) {
-        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
-        return 1;
+    std::string line;
+    int line_count = 0;
+    while (std::getline(file, line)) {
+        line_count++;
+        if (line.empty() || line[0] == '#') continue;
+
+        if (line_count % 10000 == 0) {
+            std::cout << "Read " << line_count << " lines..." << std::endl;
+        }
+
+        std::stringstream ss(line);
+        std::string trad, simp, pinyinRaw;
+
+        if (!(ss >> trad >> simp)) {
+            std::cerr << "Failed to parse trad/simp at line " << line_count << ": " << line << std::endl;
+            continue;
+        }
+
+        // Extract [ ... ]
+        size_t startBracket = line.find('[');
+        size_t endBracket = line.find(']');
+
+        if (startBracket != std::string::npos && endBracket != std::string::npos) {
+            if (endBracket <= startBracket) {
+                std::cerr << "Invalid brackets at line " << line_count << ": " << line << std::endl;
+                continue;
+            }
+            pinyinRaw = line.substr(startBracket + 1, endBracket - startBracket - 1);
+
+            std::string clean, initials;
+            std::vector<std::string> syllables;
+            ProcessPinyin(pinyinRaw, clean, initials, &syllables);
+
+            if (!clean.empty() && !simp.empty()) {
+                bool created;
+                LexEntry& entry = builder.Get(simp, clean, initials, &created);
+                entry.senses++;
+                entry.fromCedict = true;
+                stats.cedictRecords++;
+                if (!created) stats.cedictDuplicates++;
+
+                // Per-character readings inside multi-character words drive the
+                // frequency of polyphone readings merged from pinyin.txt.
+                std::vector<std::string> chars = SplitUtf8Chars(simp);
+                if (chars.size() > 1 && chars.size() == syllables.size()) {
+                    for (size_t i = 0; i < chars.size(); ++i) {
+                        builder.AddAttestation(chars[i], syllables[i]);
+                    }
+                }
+            }
+        } else {
+            // Some lines might not have brackets, that's fine for CEDICT if it's a comment but we already skipped #
+            // But let's log if it's unexpected
+            if (line.find('/') != std::string::npos) {
+                std::cerr << "Missing brackets in dictionary entry at line " << line_count << ": " << line << std::endl;
+            }
+        }
     }
 
+    stats.cedictLines = line_count;
+    std::cout << "Finished reading " << dictPath << ". Total lines: " << line_count
+              << ", records: " << stats.cedictRecords << std::endl;
+    return true;
+}
+
+// Stage 2: single-character readings from the Unihan-derived pinyin.txt.
+// Format: U+3007: líng,yuán,xīng  # 〇
+bool LoadUnihanReadings(const std::string& pinyinPath, LexiconBuilder& builder, BuildStats& stats) {
+    std::ifstream file(pinyinPath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << pinyinPath << std::endl;
+        return false;
+    }
+
+    std::cout << "Processing " << pinyinPath << "..." << std::endl;
+
+    std::unordered_set<std::string> unihanReadings;
+    std::string line;
+    int line_count = 0;
+    while (std::getline(file, line)) {
+        line_count++;
+        if (line.empty() || line[0] == '#') continue;
+
+        size_t colon = line.find(':');
+        size_t hash = line.find('#', colon == std::string::npos ? 0 : colon);
+        if (colon == std::string::npos || hash == std::string::npos) {
+            std::cerr << "Malformed reading at line " << line_count << ": " << line << std::endl;
+            continue;
+        }
+
+        std::stringstream hanziStream(line.substr(hash + 1));
+        std::string hanzi;
+        if (!(hanziStream >> hanzi)) continue;
+
+        // Readings are listed most common first; collapse readings that only
+        // differ by tone ("hǎo,hào" -> "hao") and keep their first position.
+        std::vector<std::string> readings;
+        for (const auto& reading : Split(line.substr(colon + 1, hash - colon - 1), ',')) {
+            std::string clean = StripTones(reading);
+            if (!clean.empty() && std::find(readings.begin(), readings.end(), clean) == readings.end()) {
+                readings.push_back(clean);
+            }
+        }
+        if (readings.empty()) continue;
+
+        stats.unihanChars++;
+        if (readings.size() > 1) stats.unihanPolyphones++;
+        if (!builder.HasHanzi(hanzi)) stats.unihanNewChars++;
+
+        for (size_t i = 0; i < readings.size(); ++i) {
+            const std::string& clean = readings[i];
+            unihanReadings.insert(hanzi + '\t' + clean);
+            stats.unihanReadings++;
+
+            bool created;
+            LexEntry& entry = builder.Get(hanzi, clean, clean.substr(0, 1), &created);
+            entry.fromUnihan = true;
+            if (i == 0) entry.unihanPrimary = true;
+            if (created) stats.unihanAdded++;
+            else if (entry.fromCedict) stats.unihanAlreadyInCedict++;
+        }
+    }
+
+    for (const auto& attestation : builder.AllAttestations()) {
+        stats.wordReadings++;
+        if (unihanReadings.count(attestation.first)) stats.wordReadingsCovered++;
+    }
+
+    std::cout << "Finished reading " << pinyinPath << ". Characters: " << stats.unihanChars
+              << ", readings: " << stats.unihanReadings << std::endl;
+    return true;
+}
+
+// Frequency of one reading: CEDICT senses, plus (for single characters) how
+// often words use that reading, plus a bonus for the primary Unihan reading.
+int EntryFrequency(const LexiconBuilder& builder, const LexEntry& entry) {
+    int frequency = entry.senses;
+    if (SplitUtf8Chars(entry.hanzi).size() == 1) {
+        frequency += builder.Attestations(entry.hanzi, entry.clean);
+        if (entry.unihanPrimary) frequency++;
+    }
+    return frequency;
+}
+
+// The abbreviation index: every word of two or more syllables under its
+// initials ("zg" for zhongguo), with the rank and text the engine reads
+// and the full pinyin that mixed keys ("zhguo") are checked against.
+// Clustered by initials and rank, so typing "zg" reads a few adjacent
+// pages instead of looking up one lexicon row per match through
+// idx_initials. Single characters are left out; one letter is a full
+// pinyin prefix and never queried as an abbreviation.
+bool WriteAbbreviations(sqlite3* db) {
+    int rc = sqlite3_exec(db,
+        "CREATE TABLE abbreviations ("
+        "initials TEXT NOT NULL,"
+        "priority INTEGER NOT NULL,"
+        "id INTEGER NOT NULL,"
+        "hanzi TEXT NOT NULL,"
+        "pinyin_clean TEXT NOT NULL,"
+        "PRIMARY KEY (initials, priority DESC, id)) WITHOUT ROWID;"
+        "INSERT INTO abbreviations (initials, priority, id, hanzi, pinyin_clean) "
+        "SELECT initials, priority, id, hanzi, pinyin_clean FROM lexicon WHERE length(initials) > 1;", 0, 0, 0);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Failed to write the abbreviation index: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    std::cout << "Abbreviation index: " << sqlite3_changes(db) << " words" << std::endl;
+    return true;
+}
+
+// Stage 3: write the merged lexicon.
+bool WriteLexicon(sqlite3* db, const LexiconBuilder& builder, int& singleCharCount) {
     // Create table with initials support
-    // Priority: Default 0. We can adjust this later based on length or external freq data.
+    // Priority: length heuristic plus a bonus derived from the per-reading frequency.
     sqlite3_exec(db, "CREATE TABLE lexicon (" \
                      "id INTEGER PRIMARY KEY AUTOINCREMENT," \
                      "hanzi TEXT NOT NULL," \
                      "pinyin_clean TEXT NOT NULL," \
                      "initials TEXT NOT NULL," \
-                     "priority INTEGER DEFAULT 0);", 0, 0, 0);
-    
+                     "priority INTEGER DEFAULT 0," \
+                     "frequency INTEGER DEFAULT 0);", 0, 0, 0);
+
     // Indexes for fast lookup
     sqlite3_exec(db, "CREATE INDEX idx_pinyin ON lexicon (pinyin_clean);", 0, 0, 0);
     sqlite3_exec(db, "CREATE INDEX idx_initials ON lexicon (initials);", 0, 0, 0);
-    
-    sqlite3_exec(db, "BEGIN TRANSACTION;", 0, 0, 0);
 
-    std::ifstream file(dictPath);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open " << dictPath << std::endl;
-        // Try absolute path or check current directory
-        char buf[MAX_PATH];
-        GetCurrentDirectoryA(MAX_PATH, buf);
-        std::cerr << "Current Directory: " << buf << std::endl;
-        return 1;
-    }
+    sqlite3_exec(db, "BEGIN TRANSACTION;", 0, 0, 0);
 
-    std::string line;
-    int count = 0;
-    int line_count = 0;
     sqlite3_stmt* stmt = nullptr;
-    int rc_prep = sqlite3_prepare_v2(db, "INSERT INTO lexicon (hanzi, pinyin_clean, initials, priority) VALUES (?, ?, ?, ?);", -1, &stmt, 0);
+    int rc_prep = sqlite3_prepare_v2(db, "INSERT INTO lexicon (hanzi, pinyin_clean, initials, priority, frequency) VALUES (?, ?, ?, ?, ?);", -1, &stmt, 0);
     if (rc_prep != SQLITE_OK) {
         std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
-        return 1;
+        return false;
     }
 
-    std::cout << "Processing " << dictPath << "..." << std::endl;
+    int count = 0;
+    singleCharCount = 0;
+    for (const auto& entry : builder.Entries()) {
+        int frequency = EntryFrequency(builder, entry);
 
-    try {
-        while (std::getline(file, line)) {
-            line_count++;
-            if (line.empty() || line[0] == '#') continue;
+        // Priority heuristic: shorter words are more common?
+        int priority = 10 - (int)entry.hanzi.length();
+        if (priority < 0) priority = 0;
+        priority += FrequencyBucket(frequency);
+
+        sqlite3_reset(stmt);
+        sqlite3_bind_text(stmt, 1, entry.hanzi.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, entry.clean.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, entry.initials.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 4, priority);
+        sqlite3_bind_int(stmt, 5, frequency);
+
+        int rc_step = sqlite3_step(stmt);
+        if (rc_step != SQLITE_DONE) {
+            std::cerr << "Failed to insert " << entry.hanzi << " [" << entry.clean << "]: " << sqlite3_errmsg(db) << " (rc=" << rc_step << ")" << std::endl;
+            continue;
+        }
+        count++;
+        if (SplitUtf8Chars(entry.hanzi).size() == 1) singleCharCount++;
+        if (count % 10000 == 0) {
+            std::cout << "Inserted " << count << " records..." << std::endl;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    int rc_commit = sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+    if (rc_commit != SQLITE_OK) {
+        std::cerr << "Failed to commit transaction: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    return WriteAbbreviations(db);
+}
+
+// Stage 4: next-word statistics. word -> following word -> weight.
+typedef std::unordered_map<std::string, std::unordered_map<std::string, int>> BigramCounts;
+
+// Longest successor list stored per word (two candidate pages)
+const size_t MAX_SUCCESSORS = 18;
 
-            if (line_count % 1000 == 0) {
-                std::cout << "Read " << line_count << " lines..." << std::endl;
+// Highest frequency over the readings of each word.
+std::unordered_map<std::string, int> WordFrequencies(const LexiconBuilder& builder) {
+    std::unordered_map<std::string, int> frequencies;
+    for (const auto& entry : builder.Entries()) {
+        int& frequency = frequencies[entry.hanzi];
+        frequency = std::max(frequency, EntryFrequency(builder, entry));
+    }
+    return frequencies;
+}
+
+// Pairs the lexicon itself attests: a compound that splits into two words
+// of two or more characters ("中国人民" = 中国 + 人民) is a sighting of
+// the pair, weighted by the compound's frequency.
+void CountCompoundBigrams(const LexiconBuilder& builder, const std::unordered_map<std::string, int>& frequencies,
+                          BigramCounts& counts) {
+    for (const auto& word : frequencies) {
+        std::vector<std::string> chars = SplitUtf8Chars(word.first);
+        for (size_t split = 2; split + 2 <= chars.size(); ++split) {
+            std::string first, second;
+            for (size_t i = 0; i < split; ++i) first += chars[i];
+            for (size_t i = split; i < chars.size(); ++i) second += chars[i];
+            if (builder.HasHanzi(first) && builder.HasHanzi(second)) {
+                counts[first][second] += 1 + FrequencyBucket(word.second);
             }
+        }
+    }
+}
 
-            // Format: Traditional Simplified [pin1 yin1] /English/
-            // Example: 你好 你好 [ni3 hao3] /Hello!/
-            
-            std::stringstream ss(line);
-            std::string trad, simp, pinyinRaw;
-            
-            if (!(ss >> trad >> simp)) {
-                std::cerr << "Failed to parse trad/simp at line " << line_count << ": " << line << std::endl;
+// Pairs of adjacent lexicon words in a corpus of whitespace-segmented UTF-8
+// text, one sighting each. Anything that is not a lexicon word (punctuation,
+// Latin text) breaks the chain, as does the end of a line.
+bool CountCorpusBigrams(const std::string& corpusPath, const LexiconBuilder& builder, BigramCounts& counts,
+                        long long& pairs) {
+    std::ifstream file(corpusPath);
+    if (!file.is_open()) {
+        std::cerr << "Could not open corpus " << corpusPath << std::endl;
+        return false;
+    }
+
+    pairs = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream words(line);
+        std::string word, previous;
+        while (words >> word) {
+            if (!builder.HasHanzi(word)) {
+                previous.clear();
                 continue;
             }
-            
-            // Extract [ ... ]
-            size_t startBracket = line.find('[');
-            size_t endBracket = line.find(']');
-            
-            if (startBracket != std::string::npos && endBracket != std::string::npos) {
-                if (endBracket <= startBracket) {
-                    std::cerr << "Invalid brackets at line " << line_count << ": " << line << std::endl;
-                    continue;
-                }
-                pinyinRaw = line.substr(startBracket + 1, endBracket - startBracket - 1);
-                
-                std::string clean, initials;
-                ProcessPinyin(pinyinRaw, clean, initials);
-                
-                if (!clean.empty() && !simp.empty()) {
-                    // Priority heuristic: shorter words are more common? 
-                    int priority = 10 - (int)simp.length(); 
-                    if (priority < 0) priority = 0;
-
-                    sqlite3_reset(stmt);
-                    sqlite3_bind_text(stmt, 1, simp.c_str(), -1, SQLITE_TRANSIENT);
-                    sqlite3_bind_text(stmt, 2, clean.c_str(), -1, SQLITE_TRANSIENT);
-                    sqlite3_bind_text(stmt, 3, initials.c_str(), -1, SQLITE_TRANSIENT);
-                    sqlite3_bind_int(stmt, 4, priority);
-                    
-                    int rc_step = sqlite3_step(stmt);
-                    if (rc_step != SQLITE_DONE) {
-                        std::cerr << "Failed to insert record at line " << line_count << ": " << sqlite3_errmsg(db) << " (rc=" << rc_step << ")" << std::endl;
-                    }
-                    count++;
-                    if (count % 10000 == 0) {
-                        std::cout << "Inserted " << count << " records (total lines: " << line_count << ")..." << std::endl;
-                    }
-                }
-            } else {
-                // Some lines might not have brackets, that's fine for CEDICT if it's a comment but we already skipped #
-                // But let's log if it's unexpected
-                if (line.find('/') != std::string::npos) {
-                    std::cerr << "Missing brackets in dictionary entry at line " << line_count << ": " << line << std::endl;
-                }
+            if (!previous.empty()) {
+                counts[previous][word]++;
+                pairs++;
             }
+            previous.swap(word);
+        }
+    }
+    return true;
+}
+
+// The successor lists: for each word, the words seen after it, most often
+// first (more frequent words first on ties), at most MAX_SUCCESSORS,
+// separated by spaces. One row per word, so predicting after a commit is a
+// single primary key lookup.
+bool WriteSuccessors(sqlite3* db, const BigramCounts& counts, const std::unordered_map<std::string, int>& frequencies) {
+    int rc = sqlite3_exec(db,
+        "CREATE TABLE successors ("
+        "word TEXT PRIMARY KEY,"
+        "next TEXT NOT NULL) WITHOUT ROWID;"
+        "BEGIN TRANSACTION;", 0, 0, 0);
+    sqlite3_stmt* stmt = nullptr;
+    if (rc != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "INSERT INTO successors (word, next) VALUES (?, ?);", -1, &stmt, 0) != SQLITE_OK) {
+        std::cerr << "Failed to write the successor lists: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    size_t total = 0;
+    for (const auto& word : counts) {
+        std::vector<std::pair<std::string, int>> ranked(word.second.begin(), word.second.end());
+        std::sort(ranked.begin(), ranked.end(), [&frequencies](const std::pair<std::string, int>& a,
+                                                                const std::pair<std::string, int>& b) {
+            if (a.second != b.second) return a.second > b.second;
+            int fa = frequencies.at(a.first);
+            int fb = frequencies.at(b.first);
+            return fa != fb ? fa > fb : a.first < b.first;
+        });
+        if (ranked.size() > MAX_SUCCESSORS) ranked.resize(MAX_SUCCESSORS);
+
+        std::string next;
+        for (const auto& successor : ranked) {
+            if (!next.empty()) next += ' ';
+            next += successor.first;
+        }
+        total += ranked.size();
+
+        sqlite3_reset(stmt);
+        sqlite3_bind_text(stmt, 1, word.first.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, next.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Failed to insert the successors of " << word.first << ": " << sqlite3_errmsg(db) << std::endl;
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (sqlite3_exec(db, "COMMIT;", 0, 0, 0) != SQLITE_OK) {
+        std::cerr << "Failed to commit the successor lists: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    std::cout << "Successor lists: " << counts.size() << " words, " << total << " successors" << std::endl;
+    return true;
+}
+
+double Percent(int part, int total) {
+    return total > 0 ? 100.0 * part / total : 0.0;
+}
+
+void PrintCoverage(const BuildStats& stats, size_t totalEntries, int singleCharCount) {
+    std::cout << std::endl << "Coverage report:" << std::endl;
+    std::cout << "  CEDICT records:                  " << stats.cedictRecords
+              << " (" << stats.cedictDuplicates << " duplicates merged)" << std::endl;
+    std::cout << "  Unihan characters:               " << stats.unihanChars
+              << " (" << stats.unihanPolyphones << " polyphonic)" << std::endl;
+    std::cout << "  Unihan readings:                 " << stats.unihanReadings << std::endl;
+    std::cout << "    already in CEDICT:             " << stats.unihanAlreadyInCedict
+              << " (" << Percent(stats.unihanAlreadyInCedict, stats.unihanReadings) << "%)" << std::endl;
+    std::cout << "    added to lexicon:              " << stats.unihanAdded
+              << " (" << Percent(stats.unihanAdded, stats.unihanReadings) << "%)" << std::endl;
+    std::cout << "  Characters new to the lexicon:   " << stats.unihanNewChars << std::endl;
+    std::cout << "  Word readings with Unihan match: " << stats.wordReadingsCovered << " of " << stats.wordReadings
+              << " (" << Percent(stats.wordReadingsCovered, stats.wordReadings) << "%)" << std::endl;
+    std::cout << "  Final lexicon entries:           " << totalEntries
+              << " (" << singleCharCount << " single characters)" << std::endl;
+}
+
+// Hot pages this close together are read as one run
+const uint32_t HOT_PAGE_GAP = 4;
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: DictBuilder <cedict_ts.u8> <output.db> [pinyin.txt] [corpus.txt]" << std::endl;
+        return 1;
+    }
+
+    std::string dictPath = argv[1];
+    std::string dbPath = argv[2];
+    std::string pinyinPath = argc > 3 ? argv[3] : "";
+    std::string corpusPath = argc > 4 ? argv[4] : "";
+
+    BuildStats stats;
+    LexiconBuilder builder;
+    BigramCounts bigrams;
+    std::unordered_map<std::string, int> frequencies;
+
+    try {
+        if (!LoadCedict(dictPath, builder, stats)) return 1;
+        if (!pinyinPath.empty() && !LoadUnihanReadings(pinyinPath, builder, stats)) return 1;
+
+        frequencies = WordFrequencies(builder);
+        CountCompoundBigrams(builder, frequencies, bigrams);
+        long long corpusPairs = 0;
+        if (!corpusPath.empty()) {
+            if (!CountCorpusBigrams(corpusPath, builder, bigrams, corpusPairs)) return 1;
+            std::cout << "Finished reading " << corpusPath << ". Word pairs: " << corpusPairs << std::endl;
         }
     } catch (const std::exception& e) {
-        std::cerr << "Exception occurred during processing: " << e.what() << " at line " << line_count << std::endl;
+        std::cerr << "Exception occurred during processing: " << e.what() << std::endl;
         return 1;
     } catch (...) {
-        std::cerr << "Unknown exception occurred at line " << line_count << std::endl;
+        std::cerr << "Unknown exception occurred during processing" << std::endl;
         return 1;
     }
 
-    std::cout << "Finished reading file. Total lines: " << line_count << ", Total records found: " << count << std::endl;
+    // Remove existing db
+    remove(dbPath.c_str());
 
-    sqlite3_finalize(stmt);
-    int rc_commit = sqlite3_exec(db, "COMMIT;", 0, 0, 0);
-    if (rc_commit != SQLITE_OK) {
-        std::cerr << "Failed to commit transaction: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3* db;
+    if (sqlite3_open(dbPath.c_str(), &db)) {
+        std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+        return 1;
     }
+
+    int singleCharCount = 0;
+    bool ok = WriteLexicon(db, builder, singleCharCount) && WriteSuccessors(db, bigrams, frequencies);
     sqlite3_close(db);
+    if (!ok) return 1;
+
+    // Record the pages the first keystrokes read, now that the layout is
+    // final. The hot_pages table is appended after the lexicon, so writing
+    // it does not move the pages it describes.
+    std::vector<PageRun> hotRuns;
+    int pageSize = 0;
+    if (RecordHotPages(dbPath, GetHotPrefixes(), HOT_PAGE_GAP, hotRuns, pageSize) &&
+        sqlite3_open(dbPath.c_str(), &db) == SQLITE_OK) {
+        size_t hotPages = 0;
+        for (const PageRun& run : hotRuns) hotPages += run.count;
+        if (WriteHotPages(db, hotRuns)) {
+            std::cout << "Hot set: " << hotPages << " pages in " << hotRuns.size() << " runs ("
+                      << hotPages * pageSize / 1024 << " KB)" << std::endl;
+        }
+        sqlite3_close(db);
+    } else {
+        std::cerr << "Warning: could not record the hot set; the IME will skip prefetching" << std::endl;
+    }
+
+    PrintCoverage(stats, builder.Entries().size(), singleCharCount);
 
-    std::cout << "Generated " << dbPath << " with " << count << " records." << std::endl;
+    std::cout << "Generated " << dbPath << " with " << builder.Entries().size() << " records." << std::endl;
     return 0;
 }
@@ -0,0 +1,214 @@
+#include "HotPageRecorder.h"
+#include "../include/HotWords.h"
+#include "../include/PinyinSyllables.h"
+#include <algorithm>
+#include <set>
+
+// ---------------------------------------------------------
+// Tracing VFS: forwards everything to the default VFS and notes the page
+// range of every read from the main database file.
+// ---------------------------------------------------------
+
+struct TraceFile
+{
+    sqlite3_file base;
+    sqlite3_file* real;     // Allocated right after this struct
+    bool mainDb;
+};
+
+static sqlite3_vfs* g_realVfs = NULL;
+static sqlite3_vfs g_traceVfs;
+static sqlite3_io_methods g_traceMethods;
+static std::vector<std::pair<sqlite3_int64, int>> g_reads;     // offset, amount
+
+static sqlite3_file* Real(sqlite3_file* file) { return ((TraceFile*)file)->real; }
+
+static int TraceClose(sqlite3_file* f) { return Real(f)->pMethods->xClose(Real(f)); }
+static int TraceRead(sqlite3_file* f, void* buf, int amount, sqlite3_int64 offset)
+{
+    if (((TraceFile*)f)->mainDb) g_reads.push_back(std::make_pair(offset, amount));
+    return Real(f)->pMethods->xRead(Real(f), buf, amount, offset);
+}
+static int TraceWrite(sqlite3_file* f, const void* buf, int amount, sqlite3_int64 offset) { return Real(f)->pMethods->xWrite(Real(f), buf, amount, offset); }
+static int TraceTruncate(sqlite3_file* f, sqlite3_int64 size) { return Real(f)->pMethods->xTruncate(Real(f), size); }
+static int TraceSync(sqlite3_file* f, int flags) { return Real(f)->pMethods->xSync(Real(f), flags); }
+static int TraceFileSize(sqlite3_file* f, sqlite3_int64* size) { return Real(f)->pMethods->xFileSize(Real(f), size); }
+static int TraceLock(sqlite3_file* f, int lock) { return Real(f)->pMethods->xLock(Real(f), lock); }
+static int TraceUnlock(sqlite3_file* f, int lock) { return Real(f)->pMethods->xUnlock(Real(f), lock); }
+static int TraceCheckReservedLock(sqlite3_file* f, int* out) { return Real(f)->pMethods->xCheckReservedLock(Real(f), out); }
+static int TraceFileControl(sqlite3_file* f, int op, void* arg) { return Real(f)->pMethods->xFileControl(Real(f), op, arg); }
+static int TraceSectorSize(sqlite3_file* f) { return Real(f)->pMethods->xSectorSize(Real(f)); }
+static int TraceDeviceCharacteristics(sqlite3_file* f) { return Real(f)->pMethods->xDeviceCharacteristics(Real(f)); }
+
+static int TraceOpen(sqlite3_vfs*, const char* name, sqlite3_file* file, int flags, int* outFlags)
+{
+    TraceFile* trace = (TraceFile*)file;
+    trace->real = (sqlite3_file*)(trace + 1);
+    trace->mainDb = (flags & SQLITE_OPEN_MAIN_DB) != 0;
+    int rc = g_realVfs->xOpen(g_realVfs, name, trace->real, flags, outFlags);
+    // Version 1 methods only: no WAL or memory-mapped reads, so every page
+    // goes through xRead
+    trace->base.pMethods = rc == SQLITE_OK ? &g_traceMethods : NULL;
+    return rc;
+}
+
+static bool RegisterTraceVfs()
+{
+    if (g_realVfs) return true;
+    g_realVfs = sqlite3_vfs_find(NULL);
+    if (!g_realVfs) return false;
+
+    // Everything but xOpen goes straight to the default VFS
+    g_traceVfs = *g_realVfs;
+    g_traceVfs.zName = "hotpage-trace";
+    g_traceVfs.szOsFile = (int)sizeof(TraceFile) + g_realVfs->szOsFile;
+    g_traceVfs.xOpen = TraceOpen;
+    g_traceVfs.pNext = NULL;
+
+    g_traceMethods.iVersion = 1;
+    g_traceMethods.xClose = TraceClose;
+    g_traceMethods.xRead = TraceRead;
+    g_traceMethods.xWrite = TraceWrite;
+    g_traceMethods.xTruncate = TraceTruncate;
+    g_traceMethods.xSync = TraceSync;
+    g_traceMethods.xFileSize = TraceFileSize;
+    g_traceMethods.xLock = TraceLock;
+    g_traceMethods.xUnlock = TraceUnlock;
+    g_traceMethods.xCheckReservedLock = TraceCheckReservedLock;
+    g_traceMethods.xFileControl = TraceFileControl;
+    g_traceMethods.xSectorSize = TraceSectorSize;
+    g_traceMethods.xDeviceCharacteristics = TraceDeviceCharacteristics;
+
+    return sqlite3_vfs_register(&g_traceVfs, 0) == SQLITE_OK;
+}
+
+// ---------------------------------------------------------
+// Recording
+// ---------------------------------------------------------
+
+std::vector<std::string> GetHotPrefixes()
+{
+    std::set<std::string> prefixes;
+    for (char c = 'a'; c <= 'z'; ++c) prefixes.insert(std::string(1, c));
+    for (size_t i = 0; i < HotWordCount(); ++i)
+    {
+        // Words are typed in full and as abbreviations ("women", "wm")
+        std::string key = HotWordKey(i);
+        prefixes.insert(key);
+        std::string initials = SyllableInitials(key.data(), key.length());
+        if (initials.length() > 1) prefixes.insert(initials);
+    }
+    return std::vector<std::string>(prefixes.begin(), prefixes.end());
+}
+
+// Run a prepared prefix query for [prefix, prefix with its last byte bumped).
+static void ReadPrefix(sqlite3_stmt* stmt, const std::string& prefix)
+{
+    std::string upper = prefix;
+    upper.back()++;
+    sqlite3_bind_text(stmt, 1, prefix.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, upper.c_str(), -1, SQLITE_TRANSIENT);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {}
+    sqlite3_reset(stmt);
+}
+
+bool RecordHotPages(const std::string& dbPath, const std::vector<std::string>& prefixes, uint32_t gap,
+                    std::vector<PageRun>& runs, int& pageSize)
+{
+    runs.clear();
+    if (!RegisterTraceVfs()) return false;
+
+    sqlite3* db = NULL;
+    if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, g_traceVfs.zName) != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return false;
+    }
+
+    sqlite3_stmt* stmt = NULL;
+    pageSize = 0;
+    if (sqlite3_prepare_v2(db, "PRAGMA page_size;", -1, &stmt, 0) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        pageSize = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    // Same shapes as CDictionaryEngine::_QueryKeys for a single key: full
+    // pinyin, and abbreviations when the lexicon has their table
+    const char* pinyinSql =
+        "SELECT hanzi, length(pinyin_clean), priority FROM lexicon "
+        "WHERE (pinyin_clean >= ?1 AND pinyin_clean < ?2) "
+        "ORDER BY length(pinyin_clean) ASC, priority DESC, rowid ASC LIMIT 20;";
+    const char* initialsSql =
+        "SELECT hanzi, length(initials), priority FROM abbreviations "
+        "WHERE (initials >= ?1 AND initials < ?2) "
+        "ORDER BY length(initials) ASC, priority DESC, id ASC LIMIT 20;";
+    g_reads.clear();
+    sqlite3_stmt* initialsStmt = NULL;
+    bool ok = pageSize > 0 && sqlite3_prepare_v2(db, pinyinSql, -1, &stmt, 0) == SQLITE_OK;
+    if (ok && sqlite3_prepare_v2(db, initialsSql, -1, &initialsStmt, 0) != SQLITE_OK) initialsStmt = NULL;
+
+    std::vector<std::string> readings;
+    for (size_t i = 0; ok && i < prefixes.size(); ++i)
+    {
+        size_t count = GetInitialsKeys(prefixes[i], readings, 5);
+        if (count == 0) ReadPrefix(stmt, prefixes[i]);
+        for (size_t r = 0; r < count && initialsStmt; ++r) ReadPrefix(initialsStmt, readings[r]);
+    }
+    if (ok) sqlite3_finalize(stmt);
+    sqlite3_finalize(initialsStmt);
+
+    // The successor lists are small (~150 KB); all of them, so the first
+    // prediction after a commit never waits for the disk
+    if (ok && sqlite3_prepare_v2(db, "SELECT next FROM successors;", -1, &stmt, 0) == SQLITE_OK)
+    {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {}
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+    if (!ok) return false;
+
+    std::set<uint32_t> pages;
+    for (const auto& read : g_reads)
+    {
+        uint32_t first = (uint32_t)(read.first / pageSize);
+        uint32_t last = (uint32_t)((read.first + read.second - 1) / pageSize);
+        for (uint32_t page = first; page <= last; ++page) pages.insert(page);
+    }
+
+    for (uint32_t page : pages)
+    {
+        if (!runs.empty() && page <= runs.back().first + runs.back().count + gap)
+        {
+            runs.back().count = page - runs.back().first + 1;
+        }
+        else
+        {
+            runs.push_back({ page, 1 });
+        }
+    }
+    return true;
+}
+
+bool WriteHotPages(sqlite3* db, const std::vector<PageRun>& runs)
+{
+    if (sqlite3_exec(db,
+            "DROP TABLE IF EXISTS hot_pages;"
+            "CREATE TABLE hot_pages (first_page INTEGER NOT NULL, page_count INTEGER NOT NULL);"
+            "BEGIN;", 0, 0, 0) != SQLITE_OK)
+    {
+        return false;
+    }
+
+    sqlite3_stmt* stmt = NULL;
+    bool ok = sqlite3_prepare_v2(db, "INSERT INTO hot_pages (first_page, page_count) VALUES (?, ?);", -1, &stmt, 0) == SQLITE_OK;
+    for (size_t i = 0; ok && i < runs.size(); ++i)
+    {
+        sqlite3_bind_int64(stmt, 1, runs[i].first);
+        sqlite3_bind_int64(stmt, 2, runs[i].count);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return sqlite3_exec(db, ok ? "COMMIT;" : "ROLLBACK;", 0, 0, 0) == SQLITE_OK && ok;
+}
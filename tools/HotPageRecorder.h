@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../include/sqlite/sqlite3.h"
+
+// Records the lexicon's "hot set": the database pages SQLite reads while
+// answering the prefixes users type first. DictBuilder stores the result in
+// the hot_pages table so the IME can prefetch those pages after activation;
+// StartupBench uses it to measure the effect.
+
+struct PageRun
+{
+    uint32_t first;     // 0-based page index in the file
+    uint32_t count;
+};
+
+// Open `dbPath` read-only, run the engine's prefix query for each of
+// `prefixes`, and return the pages read, coalesced into runs. Runs closer
+// than `gap` pages are merged (one larger read beats two seeks).
+bool RecordHotPages(const std::string& dbPath, const std::vector<std::string>& prefixes, uint32_t gap,
+                    std::vector<PageRun>& runs, int& pageSize);
+
+// The prefixes worth warming: every letter (the first keystroke), and the
+// keys of the built-in hot-word table with their abbreviations.
+std::vector<std::string> GetHotPrefixes();
+
+// Replace the hot_pages table of an open, writable database.
+bool WriteHotPages(sqlite3* db, const std::vector<PageRun>& runs);
@@ -0,0 +1,1369 @@
+// UTIME micro-benchmarks for the platform-neutral core.
+// Builds on Windows and Linux (see CMakeLists.txt) so hot paths can be
+// measured without a TSF host.
+//
+// Usage: PerfBench <benchmark> [args]
+//   tones <pinyin.txt>   Tone-mark stripping throughput over Unihan readings
+//   normalize            UTF-16 -> key bytes: scalar vs SSE2 vs AVX2 kernels,
+//                        and legacy find/replace AutoCorrect vs the automaton
+//   rules [file]         Correction cost as the rule count grows, plus the
+//                        conditional rules of a rules file (autocorrect.rules)
+//   typo                 Bounded typo search: recovery rate and worst-case latency
+//   compose [events]     Composition state machine: key events per second
+//   fuzz [events] [seed] Composition state machine: random keys, checking
+//                        its invariants after every event
+//   caret                Caret strategy cache: probes per candidate window
+//                        placement across hosts with different working strategies
+//   layout               Candidate window layout: text measurements per key
+//                        with and without the extent cache (and its miss
+//                        path alone), and hit testing of both orientations
+//                        against the cells
+//   alloc                Heap allocations per keystroke on the query and
+//                        display path once warm, fails unless zero; and
+//                        the composition arena's peak per query by length
+//   pool                 Handing a page to the window as pool ids vs as
+//                        copied strings, and interning throughput
+//   mixed                Keys typed as a mix of whole syllables and initials:
+//                        lattice readings per key, and filtering the initials
+//                        ranges they select
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <set>
+#include <random>
+#include <string>
+#include <vector>
+#include "PinyinNormalizer.h"
+#include "AutoCorrect.h"
+#include "TypoCorrector.h"
+#include "CompositionEngine.h"
+#include "CaretLocator.h"
+#include "CandidateLayout.h"
+#include "CandidateList.h"
+#include "CandidateMerge.h"
+#include "CompositionArena.h"
+#include "MixedPinyin.h"
+#include "PinyinSyllables.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+// Longest key the benchmarks generate (20 syllables of up to 6 letters).
+static const size_t kMaxBenchKey = 128;
+
+// Keeps results observable so the optimizer cannot drop the measured work.
+static volatile size_t g_sink = 0;
+
+// Every operator new in the process is counted, so a benchmark can check
+// that a loop stays off the heap.
+static size_t g_allocations = 0;
+
+// GCC inlines these replacements into their callers and then reports free()
+// on memory from "operator new" as a mismatch (-Wmismatched-new-delete).
+// Every form below allocates with malloc and frees with free, so the pairs
+// do match.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// The array forms too, so every allocation and free goes through the same
+// counted malloc/free pair
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static double ElapsedMs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+static void Report(const char* name, double ms, size_t ops, size_t bytes)
+{
+    double nsPerOp = ops ? ms * 1e6 / ops : 0.0;
+    double mbPerSec = ms > 0 ? (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) : 0.0;
+    printf("  %-28s %10.2f ms %10.1f ns/op %10.1f MB/s\n", name, ms, nsPerOp, mbPerSec);
+}
+
+// ---------------------------------------------------------
+// tones
+// ---------------------------------------------------------
+
+// The previous RemoveTones implementation, kept as the baseline: one
+// substring allocation per non-ASCII byte per table entry.
+static std::string LegacyRemoveTones(const std::string& pinyin)
+{
+    static const std::vector<std::pair<std::string, char>> toneMap = {
+        {"ā", 'a'}, {"á", 'a'}, {"ǎ", 'a'}, {"à", 'a'},
+        {"ē", 'e'}, {"é", 'e'}, {"ě", 'e'}, {"è", 'e'},
+        {"ī", 'i'}, {"í", 'i'}, {"ǐ", 'i'}, {"ì", 'i'},
+        {"ō", 'o'}, {"ó", 'o'}, {"ǒ", 'o'}, {"ò", 'o'},
+        {"ū", 'u'}, {"ú", 'u'}, {"ǔ", 'u'}, {"ù", 'u'},
+        {"ǖ", 'v'}, {"ǘ", 'v'}, {"ǚ", 'v'}, {"ǜ", 'v'}, {"ü", 'v'},
+        {"n", 'n'}, {"g", 'g'}
+    };
+
+    std::string result;
+    for (size_t i = 0; i < pinyin.length(); ++i) {
+        unsigned char c = (unsigned char)pinyin[i];
+        if (c < 128) {
+            if (isalpha(c)) result += (char)tolower(c);
+        } else {
+            for (const auto& pair : toneMap) {
+                if (pinyin.substr(i).find(pair.first) == 0) {
+                    result += pair.second;
+                    i += pair.first.length() - 1;
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// Extract the reading lists ("líng,yuán,xīng") from pinyin.txt.
+static bool LoadReadings(const char* path, std::vector<std::string>& readings, size_t& bytes)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    bytes = 0;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+        size_t colon = line.find(':');
+        size_t hash = line.find('#');
+        if (colon == std::string::npos || hash == std::string::npos || hash < colon) continue;
+        readings.push_back(line.substr(colon + 1, hash - colon - 1));
+        bytes += readings.back().length();
+    }
+    return true;
+}
+
+static int BenchTones(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: PerfBench tones <pinyin.txt>\n");
+        return 1;
+    }
+
+    std::vector<std::string> readings;
+    size_t bytes = 0;
+    if (!LoadReadings(argv[2], readings, bytes))
+    {
+        fprintf(stderr, "Failed to open %s\n", argv[2]);
+        return 1;
+    }
+
+    const int rounds = 20;
+    printf("tones: %zu lines, %zu bytes, %d rounds\n", readings.size(), bytes, rounds);
+
+    // Sanity check: every reading must strip cleanly and agree with the baseline
+    // wherever the baseline knew the code points involved.
+    size_t unknown = 0;
+    size_t mismatches = 0;
+    char buffer[256];
+    for (const auto& r : readings)
+    {
+        ToneStripResult res = StripTones(r.data(), r.length(), buffer, sizeof(buffer));
+        unknown += res.unknown;
+        std::string legacy = LegacyRemoveTones(r);
+        if (legacy.length() != res.length || memcmp(legacy.data(), buffer, res.length) != 0) mismatches++;
+    }
+    printf("  unknown code points: %zu, lines differing from legacy: %zu\n", unknown, mismatches);
+
+    BenchClock::time_point start = BenchClock::now();
+    for (int round = 0; round < 2; ++round)
+        for (const auto& r : readings) g_sink += LegacyRemoveTones(r).length();
+    Report("legacy substring search", ElapsedMs(start) * rounds / 2, readings.size() * rounds, bytes * rounds);
+
+    start = BenchClock::now();
+    for (int round = 0; round < rounds; ++round)
+        for (const auto& r : readings) g_sink += StripTones(r).length();
+    Report("table, std::string", ElapsedMs(start), readings.size() * rounds, bytes * rounds);
+
+    start = BenchClock::now();
+    for (int round = 0; round < rounds; ++round)
+        for (const auto& r : readings) g_sink += StripTones(r.data(), r.length(), buffer, sizeof(buffer)).length;
+    Report("table, span (no alloc)", ElapsedMs(start), readings.size() * rounds, bytes * rounds);
+
+    return 0;
+}
+
+// ---------------------------------------------------------
+// normalize
+// ---------------------------------------------------------
+
+// The previous AutoCorrect: one find/replace loop per rule.
+static std::string LegacyAutoCorrect(std::string input)
+{
+    for (const auto& pair : GetDefaultCorrectionRules()) {
+        size_t pos = 0;
+        while ((pos = input.find(pair.pattern, pos)) != std::string::npos) {
+            input.replace(pos, pair.pattern.length(), pair.replacement);
+            pos += pair.replacement.length();
+        }
+    }
+    return input;
+}
+
+// Random pinyin-like keys built from real syllables, mixed case.
+static std::vector<std::u16string> MakeKeys(size_t count, size_t minSyllables, size_t maxSyllables)
+{
+    static const char* syllables[] = {
+        "ni", "hao", "zhong", "guo", "ren", "shi", "jie", "xue", "sheng", "huo",
+        "lv", "nve", "qiong", "zhuang", "a", "e", "ign", "uen", "iou", "uei"
+    };
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<size_t> pickSyllable(0, sizeof(syllables) / sizeof(syllables[0]) - 1);
+    std::uniform_int_distribution<size_t> pickCount(minSyllables, maxSyllables);
+    std::uniform_int_distribution<int> pickCase(0, 7);
+
+    std::vector<std::u16string> keys;
+    for (size_t k = 0; k < count; ++k)
+    {
+        std::u16string key;
+        size_t n = pickCount(rng);
+        for (size_t s = 0; s < n; ++s)
+        {
+            for (const char* p = syllables[pickSyllable(rng)]; *p; ++p)
+                key += (char16_t)(pickCase(rng) == 0 ? *p - 'a' + 'A' : *p);
+        }
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+typedef bool (*KeyKernel)(const char16_t* in, size_t len, char* out);
+
+static void BenchKernel(const char* name, KeyKernel kernel, const std::vector<std::u16string>& keys, int rounds)
+{
+    char buffer[kMaxBenchKey];
+    size_t bytes = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (const auto& key : keys)
+        {
+            g_sink += kernel(key.data(), key.length(), buffer);
+            g_sink += (unsigned char)buffer[0];
+            bytes += key.length() * sizeof(char16_t);
+        }
+    }
+    Report(name, ElapsedMs(start), keys.size() * rounds, bytes);
+}
+
+static int BenchNormalize(int, char*[])
+{
+    const int rounds = 200;
+    printf("normalize: SSE2=%d AVX2=%d\n", CpuHasSse2() ? 1 : 0, CpuHasAvx2() ? 1 : 0);
+
+    // Kernels must agree before they are worth timing.
+    std::vector<std::u16string> check = MakeKeys(2000, 1, 20);
+    for (const auto& key : check)
+    {
+        char a[kMaxBenchKey], b[kMaxBenchKey], c[kMaxBenchKey];
+        NormalizeKeyScalar(key.data(), key.length(), a);
+        NormalizeKeySse2(key.data(), key.length(), b);
+        NormalizeKeyAvx2(key.data(), key.length(), c);
+        if (memcmp(a, b, key.length()) != 0 || memcmp(a, c, key.length()) != 0)
+        {
+            fprintf(stderr, "  kernel mismatch\n");
+            return 1;
+        }
+    }
+
+    const size_t shapes[][2] = { { 1, 3 }, { 4, 8 }, { 10, 20 } };
+    for (const auto& shape : shapes)
+    {
+        std::vector<std::u16string> keys = MakeKeys(10000, shape[0], shape[1]);
+        printf(" %zu-%zu syllables per key\n", shape[0], shape[1]);
+        BenchKernel("scalar", NormalizeKeyScalar, keys, rounds);
+        BenchKernel("sse2", NormalizeKeySse2, keys, rounds);
+        BenchKernel("avx2", NormalizeKeyAvx2, keys, rounds);
+    }
+
+    // AutoCorrect over the normalized keys
+    std::vector<std::u16string> wide = MakeKeys(10000, 1, 6);
+    std::vector<std::string> keys;
+    size_t bytes = 0;
+    for (const auto& key : wide)
+    {
+        char buffer[kMaxBenchKey];
+        KeyNormalizeResult r = NormalizeKey(key.data(), key.length(), buffer, sizeof(buffer));
+        keys.push_back(std::string(buffer, r.length));
+        bytes += r.length;
+    }
+
+    const CCorrectionAutomaton& corrector = GetDefaultCorrector();
+    for (const auto& key : keys)
+    {
+        if (LegacyAutoCorrect(key) != corrector.Apply(key))
+        {
+            printf("  note: automaton differs from legacy on '%s'\n", key.c_str());
+            break;
+        }
+    }
+
+    printf(" autocorrect (%zu rules, %zu states)\n", GetDefaultCorrectionRules().size(), corrector.StateCount());
+    BenchClock::time_point start = BenchClock::now();
+    for (int round = 0; round < rounds / 10; ++round)
+        for (const auto& key : keys) g_sink += LegacyAutoCorrect(key).length();
+    Report("legacy find/replace", ElapsedMs(start), keys.size() * (rounds / 10), bytes * (rounds / 10));
+
+    start = BenchClock::now();
+    for (int round = 0; round < rounds / 10; ++round)
+    {
+        for (const auto& key : keys)
+        {
+            char out[kMaxBenchKey * 2];
+            bool truncated;
+            g_sink += corrector.Apply(key.data(), key.length(), out, sizeof(out), &truncated);
+        }
+    }
+    Report("automaton, span", ElapsedMs(start), keys.size() * (rounds / 10), bytes * (rounds / 10));
+    return 0;
+}
+
+// ---------------------------------------------------------
+// rules
+// ---------------------------------------------------------
+
+// Sequential find/replace over an arbitrary rule list (conditions ignored),
+// the cost model the automaton replaces.
+static std::string SequentialCorrect(std::string input, const std::vector<CorrectionRule>& rules)
+{
+    for (const auto& rule : rules) {
+        size_t pos = 0;
+        while ((pos = input.find(rule.pattern, pos)) != std::string::npos) {
+            input.replace(pos, rule.pattern.length(), rule.replacement);
+            pos += rule.replacement.length();
+        }
+    }
+    return input;
+}
+
+// Random 3-5 letter patterns, mostly absent from real keys, so every rule
+// costs a full scan in the sequential model but rarely fires.
+static std::vector<CorrectionRule> MakeRules(size_t count)
+{
+    std::vector<CorrectionRule> rules = GetDefaultCorrectionRules();
+    std::set<std::string> seen;
+    std::mt19937 rng(777);
+    std::uniform_int_distribution<int> pickLetter('a', 'z');
+    std::uniform_int_distribution<int> pickLength(3, 5);
+    while (rules.size() < count)
+    {
+        CorrectionRule rule;
+        int n = pickLength(rng);
+        for (int k = 0; k < n; ++k) rule.pattern += (char)pickLetter(rng);
+        if (!seen.insert(rule.pattern).second) continue;
+        rule.replacement = rule.pattern.substr(0, 2);
+        rules.push_back(rule);
+    }
+    return rules;
+}
+
+static int BenchRules(int argc, char* argv[])
+{
+    const int rounds = 20;
+
+    std::vector<std::u16string> wide = MakeKeys(10000, 1, 6);
+    std::vector<std::string> keys;
+    size_t bytes = 0;
+    for (const auto& key : wide)
+    {
+        char buffer[kMaxBenchKey];
+        KeyNormalizeResult r = NormalizeKey(key.data(), key.length(), buffer, sizeof(buffer));
+        keys.push_back(std::string(buffer, r.length));
+        bytes += r.length;
+    }
+
+    // Conditional rules from a rules file, checked on inputs where context matters
+    if (argc >= 3)
+    {
+        std::ifstream file(argv[2]);
+        std::vector<CorrectionRule> loaded;
+        std::string error;
+        if (!file.is_open() || !LoadCorrectionRules(file, loaded, &error))
+        {
+            fprintf(stderr, "Failed to load %s: %s\n", argv[2], error.c_str());
+            return 1;
+        }
+        CCorrectionAutomaton fromFile;
+        fromFile.Build(loaded);
+        printf("rules: %s (%zu rules, %zu states)\n", argv[2], fromFile.RuleCount(), fromFile.StateCount());
+        const char* samples[] = { "lv", "nvhai", "jvzi", "xve", "qvan", "lvxing", "hagn", "pingnan", "xiign", "guei" };
+        for (const char* sample : samples)
+            printf("  %-10s -> %s\n", sample, fromFile.Apply(sample).c_str());
+    }
+
+    const size_t counts[] = { 6, 50, 200, 800 };
+    for (size_t count : counts)
+    {
+        std::vector<CorrectionRule> rules = MakeRules(count);
+        CCorrectionAutomaton automaton;
+        automaton.Build(rules);
+        printf(" %zu rules, %zu states\n", rules.size(), automaton.StateCount());
+
+        BenchClock::time_point start = BenchClock::now();
+        for (const auto& key : keys) g_sink += SequentialCorrect(key, rules).length();
+        Report("sequential find/replace", ElapsedMs(start) * rounds, keys.size() * rounds, bytes * rounds);
+
+        start = BenchClock::now();
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (const auto& key : keys)
+            {
+                char out[kMaxBenchKey * 4];
+                bool truncated;
+                g_sink += automaton.Apply(key.data(), key.length(), out, sizeof(out), &truncated);
+            }
+        }
+        Report("automaton, span", ElapsedMs(start), keys.size() * rounds, bytes * rounds);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------
+// typo
+// ---------------------------------------------------------
+
+// Inject one typo: a neighbouring key, a dropped letter, or a swap.
+static std::string MakeTypo(const std::string& key, std::mt19937& rng)
+{
+    std::string typo = key;
+    std::uniform_int_distribution<size_t> pickPos(0, key.length() - 1);
+    size_t pos = pickPos(rng);
+    switch (rng() % 3)
+    {
+    case 0:
+        for (char c = 'a'; c <= 'z'; ++c)
+        {
+            if (TypoSubstitutionCost(key[pos], c) == 1)
+            {
+                typo[pos] = c;
+                break;
+            }
+        }
+        break;
+    case 1:
+        if (typo.length() > 2) typo.erase(pos, 1);
+        break;
+    default:
+        if (pos + 1 < typo.length()) std::swap(typo[pos], typo[pos + 1]);
+        break;
+    }
+    return typo;
+}
+
+static int BenchTypo(int, char*[])
+{
+    const size_t budgets[] = { 1000, 4000, 20000 };
+    const size_t topK = 8;
+
+    std::vector<std::u16string> wide = MakeKeys(2000, 1, 4);
+    std::mt19937 rng(4242);
+    std::vector<std::string> intended;
+    std::vector<std::string> typed;
+    for (const auto& key : wide)
+    {
+        char buffer[kMaxBenchKey];
+        KeyNormalizeResult r = NormalizeKey(key.data(), key.length(), buffer, sizeof(buffer));
+        std::string clean = GetDefaultCorrector().Apply(std::string(buffer, r.length));
+        std::string typo = MakeTypo(clean, rng);
+        if (typo == clean) continue;
+        intended.push_back(clean);
+        typed.push_back(typo);
+    }
+
+    printf("typo: %zu mistyped keys, max cost 2, top %zu\n", typed.size(), topK);
+    for (size_t budget : budgets)
+    {
+        TypoSearchLimits limits = { 2, budget, topK };
+        std::pmr::vector<TypoCandidate> out;
+        size_t recovered = 0;
+        size_t exhausted = 0;
+        double worstMs = 0;
+
+        BenchClock::time_point start = BenchClock::now();
+        for (size_t i = 0; i < typed.size(); ++i)
+        {
+            BenchClock::time_point one = BenchClock::now();
+            TypoSearchResult r = FindTypoCorrections(typed[i].data(), typed[i].length(), limits, out);
+            worstMs = std::max(worstMs, ElapsedMs(one));
+            if (r.exhausted) exhausted++;
+            for (const auto& c : out)
+            {
+                if (c.key == intended[i].c_str())
+                {
+                    recovered++;
+                    break;
+                }
+            }
+            g_sink += out.size();
+        }
+        double ms = ElapsedMs(start);
+
+        char name[64];
+        snprintf(name, sizeof(name), "budget %zu rows", budget);
+        Report(name, ms, typed.size(), 0);
+        printf("  %-28s recovered %.1f%%, budget hit %.1f%%, worst %.3f ms\n", "",
+               100.0 * recovered / typed.size(), 100.0 * exhausted / typed.size(), worstMs);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------
+// compose / fuzz
+// ---------------------------------------------------------
+
+// Stand-in for the dictionary: up to a few pages of candidates derived from
+// the key, handed out in batches of 12, and none for some keys so the
+// raw-pinyin fallback is exercised.
+static bool FakeCandidates(const std::wstring& composition, bool, CCandidateList& candidates)
+{
+    wchar_t text[34];
+    size_t count = (composition.length() * 7 + composition[0]) % 31;
+    size_t end = std::min(count, candidates.Size() + 12);
+    for (size_t i = candidates.Size(); i < end; ++i)
+    {
+        size_t length = std::min((size_t)32, 1 + i % composition.length());
+        std::copy(composition.begin(), composition.begin() + length, text);
+        text[length] = (wchar_t)(L'A' + i);
+        candidates.Add(text, length + 1);
+    }
+    return end < count;
+}
+
+// Stand-in for next-word prediction: up to two pages of words derived from
+// the commit, none for some.
+static void FakePredictions(const std::wstring& committed, CCandidateList& predictions)
+{
+    size_t count = (committed.length() * 5 + committed[0]) % 19;
+    for (size_t i = 0; i < count; ++i)
+    {
+        wchar_t text[2] = { committed[0], (wchar_t)(L'a' + i) };
+        predictions.Add(text, 2);
+    }
+}
+
+// The page the engine shows, as strings.
+static std::vector<std::wstring> PageOf(const CCompositionEngine& engine)
+{
+    std::vector<std::wstring> page;
+    for (size_t i = 0; i < engine.PageLength(); ++i) page.push_back(engine.Candidates().String(engine.PageStart() + i));
+    return page;
+}
+
+static const int kPageSize = 9;
+
+// A typing-like key mix: mostly letters, some selection and editing keys.
+static CompositionKey RandomKey(std::mt19937& rng)
+{
+    CompositionKey key = { COMP_KEY_LETTER, 0 };
+    unsigned roll = rng() % 100;
+    if (roll < 55) key.ch = (wchar_t)(L'a' + rng() % 26);
+    else if (roll < 65) key.code = COMP_KEY_BACKSPACE;
+    else if (roll < 73) { key.code = COMP_KEY_DIGIT; key.ch = (wchar_t)(L'1' + rng() % 9); }
+    else if (roll < 80) key.code = COMP_KEY_SPACE;
+    else if (roll < 83) key.code = COMP_KEY_ENTER;
+    else if (roll < 87) key.code = COMP_KEY_UP;
+    else if (roll < 91) key.code = COMP_KEY_DOWN;
+    else if (roll < 93) key.code = COMP_KEY_ESCAPE;
+    else if (roll < 95) key.code = COMP_KEY_MODIFIER;
+    else if (roll < 97) key.code = COMP_KEY_PAGE_DOWN;
+    else if (roll < 98) key.code = COMP_KEY_PAGE_UP;
+    else key.code = COMP_KEY_OTHER;
+    return key;
+}
+
+static int BenchCompose(int argc, char* argv[])
+{
+    size_t events = argc > 2 ? (size_t)atoll(argv[2]) : 5000000;
+    std::mt19937 rng(7);
+    std::vector<CompositionKey> keys(1 << 16);
+    for (auto& key : keys) key = RandomKey(rng);
+
+    CCompositionEngine engine(FakeCandidates, kPageSize);
+    size_t commits = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (size_t i = 0; i < events; ++i)
+    {
+        CompositionResult r = engine.OnKey(keys[i & (keys.size() - 1)]);
+        if (r.actions & ACTION_COMMIT) commits++;
+        g_sink += r.actions;
+    }
+    double ms = ElapsedMs(start);
+
+    printf("compose: %zu key events, %zu commits\n", events, commits);
+    Report("OnKey", ms, events, 0);
+    printf("  %-28s %10.2f M events/s\n", "", ms > 0 ? events / ms / 1000.0 : 0.0);
+    return 0;
+}
+
+#define FUZZ_CHECK(cond) \
+    do { if (!(cond)) { fprintf(stderr, "Event %zu: check failed: %s\n", i, #cond); return 1; } } while (0)
+
+static int FuzzCompose(int argc, char* argv[])
+{
+    size_t events = argc > 2 ? (size_t)atoll(argv[2]) : 2000000;
+    unsigned seed = argc > 3 ? (unsigned)atoi(argv[3]) : 1;
+    std::mt19937 rng(seed);
+
+    CCompositionEngine engine(FakeCandidates, kPageSize, FakePredictions);
+    std::wstring model;     // What the composition must be
+    bool predicting = false;
+    size_t commits = 0, learned = 0, predicted = 0;
+    for (size_t i = 0; i < events; ++i)
+    {
+        CompositionKey key = RandomKey(rng);
+        bool wouldEat = engine.WouldEat(key);
+        std::vector<std::wstring> before = PageOf(engine);
+        int selection = engine.Selection();
+        int page = engine.Page();
+        size_t fetched = engine.Candidates().Size();
+
+        CompositionResult r = engine.OnKey(key);
+        const unsigned a = r.actions;
+        FUZZ_CHECK(r.eaten == wouldEat);
+
+        if (!r.eaten && predicting && key.code != COMP_KEY_MODIFIER)
+        {
+            // Typing past predictions dismisses them
+            FUZZ_CHECK(a == (ACTION_END_COMMIT_RUN | ACTION_HIDE_CANDIDATES));
+            FUZZ_CHECK(!engine.Predicting() && engine.Candidates().Empty());
+            predicting = false;
+        }
+        else if (!r.eaten)
+        {
+            FUZZ_CHECK((a & ~ACTION_END_COMMIT_RUN) == 0);
+            FUZZ_CHECK(engine.Composition() == model && PageOf(engine) == before);
+            FUZZ_CHECK(engine.Selection() == selection && engine.Page() == page);
+        }
+        else if (a & ACTION_COMMIT)
+        {
+            FUZZ_CHECK(!engine.CommitText().empty() && engine.CommitKey() == model);
+            FUZZ_CHECK(((a & ACTION_LEARN) != 0) != ((a & ACTION_END_COMMIT_RUN) != 0));
+            FUZZ_CHECK(((a & ACTION_LEARN) != 0) == (engine.CommitText() != model));
+            if (predicting) FUZZ_CHECK(key.code == COMP_KEY_DIGIT && model.empty());
+            if (key.code == COMP_KEY_ENTER) FUZZ_CHECK(engine.CommitText() == model);
+            if (key.code == COMP_KEY_SPACE) FUZZ_CHECK(engine.CommitText() == before[selection]);
+            if (key.code == COMP_KEY_DIGIT) FUZZ_CHECK(engine.CommitText() == before[key.ch - L'1']);
+            model.clear();
+            commits++;
+            if (a & ACTION_LEARN) learned++;
+
+            // Predictions follow learned commits only, and replace the window's contents
+            predicting = engine.Predicting();
+            FUZZ_CHECK(!predicting || (a & ACTION_LEARN));
+            FUZZ_CHECK((a & ACTION_HIDE_CANDIDATES) == (predicting ? 0u : (unsigned)ACTION_HIDE_CANDIDATES));
+            FUZZ_CHECK((a & ACTION_SHOW_CANDIDATES) == (predicting ? (unsigned)ACTION_SHOW_CANDIDATES : 0u));
+            if (predicting)
+            {
+                FUZZ_CHECK(engine.Selection() == 0 && engine.Page() == 0);
+                predicted++;
+            }
+        }
+        else if (key.code == COMP_KEY_LETTER)
+        {
+            model += key.ch;
+            predicting = false;
+            FUZZ_CHECK(a == (ACTION_UPDATE_PREEDIT | ACTION_SHOW_CANDIDATES));
+            FUZZ_CHECK(engine.Selection() == 0 && engine.Page() == 0);
+        }
+        else if (key.code == COMP_KEY_BACKSPACE)
+        {
+            model.pop_back();
+            FUZZ_CHECK(a == (model.empty() ? (unsigned)(ACTION_END_COMPOSITION | ACTION_HIDE_CANDIDATES)
+                                           : (unsigned)(ACTION_UPDATE_PREEDIT | ACTION_SHOW_CANDIDATES)));
+        }
+        else if (key.code == COMP_KEY_ESCAPE)
+        {
+            FUZZ_CHECK(a == (predicting ? (unsigned)ACTION_HIDE_CANDIDATES
+                                        : (unsigned)(ACTION_END_COMMIT_RUN | ACTION_END_COMPOSITION | ACTION_HIDE_CANDIDATES)));
+            model.clear();
+            predicting = false;
+        }
+        else if (key.code == COMP_KEY_UP || key.code == COMP_KEY_DOWN)
+        {
+            // Up wraps to the last candidate fetched so far; down fetches past it
+            int index = page * kPageSize + selection;
+            int expected = key.code == COMP_KEY_DOWN ? (index + 1) % (int)engine.Candidates().Size()
+                                                     : (index == 0 ? (int)fetched : index) - 1;
+            FUZZ_CHECK(engine.Page() * kPageSize + engine.Selection() == expected);
+            FUZZ_CHECK(a == (engine.Page() == page ? ACTION_MOVE_SELECTION : ACTION_SHOW_PAGE));
+        }
+        else if (key.code == COMP_KEY_PAGE_UP || key.code == COMP_KEY_PAGE_DOWN)
+        {
+            int step = key.code == COMP_KEY_PAGE_DOWN ? 1 : -1;
+            if (a == 0)
+            {
+                // First or last page: nothing to turn to
+                FUZZ_CHECK(engine.Page() == page && engine.Selection() == selection);
+                FUZZ_CHECK(step < 0 ? page == 0 : engine.Candidates().Size() <= (size_t)(page + 1) * kPageSize);
+            }
+            else
+            {
+                FUZZ_CHECK(a == ACTION_SHOW_PAGE && engine.Page() == page + step && engine.Selection() == 0);
+            }
+        }
+        else
+        {
+            // A digit past the end of the list: eaten, nothing else
+            FUZZ_CHECK(key.code == COMP_KEY_DIGIT && a == 0 && key.ch - L'1' >= (int)before.size());
+        }
+
+        // State invariants
+        FUZZ_CHECK(engine.Composition() == model);
+        FUZZ_CHECK(engine.Predicting() == predicting && !(predicting && !model.empty()));
+        FUZZ_CHECK((engine.Composition().empty() && !predicting) == engine.Candidates().Empty());
+        FUZZ_CHECK(engine.Selection() >= 0);
+        FUZZ_CHECK(engine.Candidates().Empty() ? engine.Selection() == 0
+                                               : engine.Selection() < (int)engine.PageLength());
+        FUZZ_CHECK(engine.PageStart() == (size_t)(engine.Page() * kPageSize));
+        FUZZ_CHECK(engine.Candidates().Empty() || (engine.PageLength() > 0 && engine.PageLength() <= (size_t)kPageSize));
+        FUZZ_CHECK(!((a & ACTION_UPDATE_PREEDIT) && (a & ACTION_END_COMPOSITION)));
+        FUZZ_CHECK(!((a & ACTION_SHOW_CANDIDATES) && (a & ACTION_HIDE_CANDIDATES)));
+    }
+
+    printf("fuzz: %zu events (seed %u), %zu commits (%zu learned, %zu followed by predictions), all invariants held\n",
+           events, seed, commits, learned, predicted);
+    return 0;
+}
+
+// ---------------------------------------------------------
+// caret
+// ---------------------------------------------------------
+
+static int BenchCaret(int, char*[])
+{
+    // First strategy that works in each simulated host window; the mouse
+    // always works
+    const CaretStrategy hosts[] = { CARET_TEXT_EXT, CARET_VIEW_THREAD, CARET_CARET_POS, CARET_MOUSE };
+    const int hostCount = sizeof(hosts) / sizeof(hosts[0]);
+    const size_t locates = 1000000;
+    const unsigned burst = 40;      // Keys typed before focus moves
+
+    std::mt19937 rng(11);
+    std::vector<int> windows(locates);
+    for (size_t i = 0; i < locates; i += burst)
+    {
+        int window = (int)(rng() % hostCount);
+        for (size_t j = i; j < i + burst && j < locates; ++j) windows[j] = window;
+    }
+
+    int window = 0;
+    size_t probes = 0;
+    CaretProbe probe = [&](CaretStrategy strategy, CaretRect& rc) {
+        probes++;
+        rc.left = rc.top = rc.right = rc.bottom = strategy + 1;
+        return strategy >= hosts[window];
+    };
+
+    CCaretLocator locator(16);
+    printf("caret: %zu placements over %d host types, focus moves every %u keys\n", locates, hostCount, burst);
+    for (int cached = 0; cached < 2; ++cached)
+    {
+        probes = 0;
+        BenchClock::time_point start = BenchClock::now();
+        for (size_t i = 0; i < locates; ++i)
+        {
+            if (windows[i] != window || !cached) locator.Clear();
+            window = windows[i];
+            CaretRect rc;
+            g_sink += locator.Locate((uintptr_t)window, probe, rc);
+        }
+        double ms = ElapsedMs(start);
+        Report(cached ? "remembered strategy" : "full walk", ms, locates, 0);
+        printf("  %-28s %10.2f probes per placement\n", "", (double)probes / locates);
+    }
+    for (int i = 0; i < CARET_STRATEGY_COUNT; ++i)
+    {
+        const CaretStrategyStats& stats = locator.Stats((CaretStrategy)i);
+        printf("  %-28s %10llu hits of %llu attempts\n", CCaretLocator::StrategyName((CaretStrategy)i), stats.hits, stats.attempts);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------
+// layout
+// ---------------------------------------------------------
+
+// Every pixel of a page laid out both ways must hit the cell whose rect
+// contains it, and nothing in the padding.
+static int CheckHitTest()
+{
+    std::vector<int> labelWidths, textWidths;
+    for (int i = 0; i < 9; ++i)
+    {
+        labelWidths.push_back(i == 8 ? 30 : 24);
+        textWidths.push_back(12 * (1 + (i * 5) % 7));
+    }
+
+    for (int horizontal = 0; horizontal < 2; ++horizontal)
+    {
+        CandidateLayoutMetrics metrics = { horizontal ? LAYOUT_HORIZONTAL : LAYOUT_VERTICAL, 200, 5, 24 };
+        CandidateLayout layout;
+        LayoutCandidates(metrics, labelWidths, textWidths, layout);
+
+        size_t points = 0, hits = 0;
+        for (int y = -2; y < layout.height + 2; ++y)
+        {
+            for (int x = -2; x < layout.width + 2; ++x)
+            {
+                int expected = -1;
+                for (size_t i = 0; i < layout.cells.size(); ++i)
+                {
+                    const LayoutRect& rc = layout.cells[i].rect;
+                    if (x >= rc.left && x < rc.right && y >= rc.top && y < rc.bottom) expected = (int)i;
+                }
+                int index = HitTestCandidates(layout, x, y);
+                if (index != expected)
+                {
+                    fprintf(stderr, "hit test: (%d, %d) gave %d, expected %d\n", x, y, index, expected);
+                    return 1;
+                }
+                points++;
+                if (index >= 0) hits++;
+            }
+        }
+        printf("  %-28s %dx%d, %zu points (%zu on cells) all matched\n",
+               horizontal ? "hit test, horizontal" : "hit test, vertical", layout.width, layout.height, points, hits);
+    }
+    return 0;
+}
+
+static int BenchLayout(int, char*[])
+{
+    const size_t events = 1000000;
+    const CandidateLayoutMetrics metrics = { LAYOUT_VERTICAL, 200, 5, 24 };
+
+    // Stand-in for GetTextExtentPoint32: 12 px per character, after
+    // spinning for about what the GDI call costs on a short CJK string
+    // (the font fallback lookup dominates)
+    const std::chrono::nanoseconds measureCost(1000);
+    size_t measured = 0;
+    TextMeasure measure = [&](const wchar_t*, size_t len) {
+        measured++;
+        BenchClock::time_point until = BenchClock::now() + measureCost;
+        while (BenchClock::now() < until) {}
+        return (int)len * 12;
+    };
+
+    std::mt19937 rng(5);
+    std::vector<CompositionKey> keys(events);
+    for (auto& key : keys) key = RandomKey(rng);
+
+    // Modes: measure every line, the extent cache emptied before every
+    // layout (its miss path alone), and the extent cache as the window uses it
+    const char* const modeNames[] = { "measure every line", "extent cache, all misses", "extent cache" };
+    printf("layout: %zu key events, %lld ns per measurement\n", events, (long long)measureCost.count());
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        const bool cached = mode > 0;
+        CCompositionEngine engine(FakeCandidates, kPageSize);
+        CTextExtentCache extents(4096);
+        CandidateLayout layout;
+        std::vector<int> labelWidths, textWidths;
+        size_t layouts = 0;
+        measured = 0;
+
+        BenchClock::time_point start = BenchClock::now();
+        for (const CompositionKey& key : keys)
+        {
+            CompositionResult r = engine.OnKey(key);
+            // Before the cache every redraw measured every line, arrows included
+            bool relayout = (r.actions & (ACTION_SHOW_CANDIDATES | ACTION_SHOW_PAGE)) ||
+                            (!cached && (r.actions & ACTION_MOVE_SELECTION));
+            if (!relayout) continue;
+
+            const CCandidateList& candidates = engine.Candidates();
+            labelWidths.clear();
+            textWidths.clear();
+            if (mode == 1) extents.Clear();
+            for (size_t i = 0; i < engine.PageLength(); ++i)
+            {
+                size_t id = engine.PageStart() + i;
+                if (cached)
+                {
+                    labelWidths.push_back(extents.Width(0, CandidateLabel(i), measure));
+                    textWidths.push_back(extents.Width(0, candidates.Text(id), candidates.Length(id), measure));
+                }
+                else
+                {
+                    std::wstring line = CandidateLabel(i) + candidates.String(id);
+                    labelWidths.push_back(0);
+                    textWidths.push_back(measure(line.c_str(), line.length()));
+                }
+            }
+            LayoutCandidates(metrics, labelWidths, textWidths, layout);
+            g_sink += layout.width;
+            layouts++;
+        }
+        double ms = ElapsedMs(start);
+        Report(modeNames[mode], ms, layouts, 0);
+        printf("  %-28s %10.2f measurements per layout", "", layouts ? (double)measured / layouts : 0.0);
+        if (cached) printf(", %.1f%% hits", 100.0 * extents.Hits() / (extents.Hits() + extents.Misses()));
+        printf("\n");
+    }
+    return CheckHitTest();
+}
+
+// ---------------------------------------------------------
+// alloc
+// ---------------------------------------------------------
+
+// The query path after SQLite, with the memory CDictionaryEngine keeps in
+// its QueryCursor: fuzzy variants, an overlay stream, and a batch of
+// lexicon rows (from an in-memory stand-in table) built in the composition
+// arena and merged into the candidate list.
+struct FakeDictionary
+{
+    FakeDictionary() : arena(64 * 1024) {}
+
+    struct Word
+    {
+        std::string key;
+        std::wstring text;
+        int priority;
+    };
+    std::vector<Word> lexicon;      // Stand-in for the lexicon table
+    std::vector<Word> overlay;      // Stand-in for the user overlay
+
+    std::string key;
+    std::vector<std::string> variants;
+    size_t variantCount;
+    RankedStream userStream;
+    CCompositionArena arena;
+    size_t lexiconNext;             // Matching rows already returned
+    size_t userNext;
+
+    bool Query(const std::wstring& composition, bool more, CCandidateList& candidates)
+    {
+        arena.ResetPeak();
+        if (!more)
+        {
+            key.assign(composition.begin(), composition.end());
+            variantCount = GetFuzzyVariants(key, variants);
+            userStream.Clear();
+            for (size_t v = 0; v < variantCount; ++v) _Find(overlay, variants[v], 0, (size_t)-1, userStream);
+            SortRankedStream(userStream);
+            lexiconNext = 0;
+            userNext = 0;
+        }
+
+        const size_t batch = 18;
+        RankedStream systemStream(&arena);
+        systemStream.ranks.reserve(batch * variantCount);
+        size_t rows = 0;
+        for (size_t v = 0; v < variantCount; ++v) rows += _Find(lexicon, variants[v], lexiconNext, batch, systemStream);
+        SortRankedStream(systemStream);
+        lexiconNext += batch;
+
+        bool lexiconDone = rows < batch;
+        RankedRange ranges[2] = {
+            { &userStream, userNext, lexiconDone ? userStream.ranks.size() : userNext },
+            { &systemStream, 0, systemStream.ranks.size() },
+        };
+        MergeRankedStreams(ranges, 2, (size_t)-1, candidates);
+        userNext = ranges[0].end;
+        arena.NoteLength(composition.length());
+        return !lexiconDone;
+    }
+
+    // Append up to `limit` words of `table` whose key starts with `prefix`,
+    // skipping the first `skip` matches. Returns how many were appended.
+    static size_t _Find(const std::vector<Word>& table, const std::string& prefix, size_t skip, size_t limit,
+                        RankedStream& stream)
+    {
+        size_t matched = 0, added = 0;
+        for (const Word& word : table)
+        {
+            if (added >= limit) break;
+            if (word.key.compare(0, prefix.length(), prefix) != 0 || matched++ < skip) continue;
+            stream.Add(word.text.data(), word.text.length(), (int)word.key.length(), word.priority);
+            added++;
+        }
+        return added;
+    }
+};
+
+// Typing script: lowercase letters and digits as typed, '<' '>' page
+// up/down, 'U' 'D' up/down, 'B' backspace, 'E' escape, ' ' space, '.' enter.
+static std::vector<CompositionKey> ScriptKeys(const char* script)
+{
+    std::vector<CompositionKey> keys;
+    for (const char* p = script; *p; ++p)
+    {
+        CompositionKey key = { COMP_KEY_LETTER, (wchar_t)*p };
+        switch (*p)
+        {
+        case '<': key.code = COMP_KEY_PAGE_UP; break;
+        case '>': key.code = COMP_KEY_PAGE_DOWN; break;
+        case 'U': key.code = COMP_KEY_UP; break;
+        case 'D': key.code = COMP_KEY_DOWN; break;
+        case 'B': key.code = COMP_KEY_BACKSPACE; break;
+        case 'E': key.code = COMP_KEY_ESCAPE; break;
+        case ' ': key.code = COMP_KEY_SPACE; break;
+        case '.': key.code = COMP_KEY_ENTER; break;
+        default:
+            if (*p >= '1' && *p <= '9') key.code = COMP_KEY_DIGIT;
+            break;
+        }
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+static int BenchAlloc(int, char*[])
+{
+    static const char* syllables[] = {
+        "ni", "hao", "zhong", "guo", "ren", "shi", "jie", "xue", "sheng", "huo",
+        "zi", "ci", "si", "lin", "ning", "chang", "cheng", "shang", "a", "e"
+    };
+    const size_t syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+
+    // One- and two-syllable words, as the lexicon mostly holds
+    FakeDictionary dictionary;
+    std::mt19937 rng(3);
+    for (size_t i = 0; i < 3000; ++i)
+    {
+        FakeDictionary::Word word;
+        word.key = syllables[rng() % syllableCount];
+        if (i % 3) word.key += syllables[rng() % syllableCount];
+        for (size_t c = 0; c < 1 + i % 4; ++c) word.text += (wchar_t)(0x4e00 + rng() % 2000);
+        word.priority = (int)(rng() % 16);
+        (i % 40 ? dictionary.lexicon : dictionary.overlay).push_back(word);
+    }
+
+    CCompositionEngine engine([&dictionary](const std::wstring& composition, bool more, CCandidateList& candidates) {
+        return dictionary.Query(composition, more, candidates);
+    }, kPageSize);
+
+    // The candidate window's side: its copy of the page and the layout
+    CCandidateList shown;
+    CTextExtentCache extents(4096);
+    CandidateLayout layout;
+    std::vector<int> labelWidths, textWidths;
+    const CandidateLayoutMetrics metrics = { LAYOUT_VERTICAL, 200, 5, 24 };
+    TextMeasure measure = [](const wchar_t*, size_t len) { return (int)len * 12; };
+
+    std::vector<CompositionKey> keys = ScriptKeys(
+        "nihao>>D<DD shijie>DDDUU2 zhongguoBBuo>>>>E"
+        "chang>UUUD.linBBning3 sisisi>D< xueshengB> renEhaohao1");
+
+    auto typeScript = [&]() {
+        for (const CompositionKey& key : keys)
+        {
+            CompositionResult r = engine.OnKey(key);
+            if (r.actions & (ACTION_SHOW_CANDIDATES | ACTION_SHOW_PAGE))
+            {
+                shown.AssignRange(engine.Candidates(), engine.PageStart(), engine.PageLength());
+                labelWidths.clear();
+                textWidths.clear();
+                for (size_t i = 0; i < shown.Size(); ++i)
+                {
+                    labelWidths.push_back(extents.Width(0, CandidateLabel(i), measure));
+                    textWidths.push_back(extents.Width(0, shown.Text(i), shown.Length(i), measure));
+                }
+                LayoutCandidates(metrics, labelWidths, textWidths, layout);
+                g_sink += layout.width;
+            }
+            if (r.actions & ACTION_COMMIT) g_sink += engine.CommitText().length();
+            if (r.actions & (ACTION_COMMIT | ACTION_END_COMPOSITION)) dictionary.arena.Reset();
+        }
+    };
+
+    // The first passes grow every buffer to its largest size
+    size_t before = g_allocations;
+    typeScript();
+    size_t warmup = g_allocations - before;
+    typeScript();
+
+    const size_t passes = 2000;
+    before = g_allocations;
+    BenchClock::time_point start = BenchClock::now();
+    for (size_t i = 0; i < passes; ++i) typeScript();
+    double ms = ElapsedMs(start);
+    size_t steady = g_allocations - before;
+    size_t events = passes * keys.size();
+
+    printf("alloc: %zu-key script, lexicon of %zu words, overlay of %zu\n",
+           keys.size(), dictionary.lexicon.size(), dictionary.overlay.size());
+    printf("  %-28s %10zu allocations\n", "first pass", warmup);
+    Report("steady state", ms, events, 0);
+    printf("  %-28s %10zu allocations (%.3f per key)\n", "", steady, (double)steady / events);
+
+    printf("  arena peak per query by composition length (bytes, %zu reserved):\n   ", dictionary.arena.Reserved());
+    for (size_t length = 1; length <= dictionary.arena.LongestLength(); ++length)
+    {
+        printf(" %zu:%zu", length, dictionary.arena.PeakAtLength(length));
+    }
+    printf("\n");
+
+    if (steady != 0)
+    {
+        fprintf(stderr, "alloc: the steady state allocated\n");
+        return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------
+// pool
+// ---------------------------------------------------------
+
+static int BenchPool(int, char*[])
+{
+    // A lexicon-sized spread of one- to four-character words
+    std::mt19937 rng(5);
+    std::vector<std::wstring> words(20000);
+    for (std::wstring& word : words)
+    {
+        size_t length = 1 + rng() % 4;
+        for (size_t c = 0; c < length; ++c) word += (wchar_t)(0x4e00 + rng() % 6000);
+    }
+
+    CCandidatePool& pool = CCandidatePool::Instance();
+    size_t before = pool.Size();
+    BenchClock::time_point start = BenchClock::now();
+    for (const std::wstring& word : words) g_sink += pool.Intern(word.data(), word.length());
+    Report("intern, first sight", ElapsedMs(start), words.size(), 0);
+
+    const size_t rounds = 50;
+    start = BenchClock::now();
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        for (const std::wstring& word : words) g_sink += pool.Intern(word.data(), word.length());
+    }
+    Report("intern, already pooled", ElapsedMs(start), rounds * words.size(), 0);
+    printf("  %-28s %10zu words pooled\n", "", pool.Size() - before);
+
+    // The candidate window's side of a page turn: compare the new page with
+    // the one shown, then take a copy
+    CCandidateList fetched;
+    for (size_t i = 0; i < 180; ++i) fetched.Add(words[i]);
+    std::vector<std::wstring> fetchedStrings;
+    for (size_t i = 0; i < fetched.Size(); ++i) fetchedStrings.push_back(fetched.String(i));
+
+    const size_t pages = fetched.Size() / kPageSize;
+    const size_t turns = 200000;
+    std::vector<std::wstring> shownStrings;
+    start = BenchClock::now();
+    for (size_t t = 0; t < turns; ++t)
+    {
+        size_t first = (t % pages) * kPageSize;
+        bool same = shownStrings.size() == (size_t)kPageSize &&
+                    std::equal(shownStrings.begin(), shownStrings.end(), fetchedStrings.begin() + first);
+        if (!same) shownStrings.assign(fetchedStrings.begin() + first, fetchedStrings.begin() + first + kPageSize);
+        g_sink += shownStrings[0].length();
+    }
+    Report("page as strings", ElapsedMs(start), turns, 0);
+
+    CCandidateList shown;
+    start = BenchClock::now();
+    for (size_t t = 0; t < turns; ++t)
+    {
+        size_t first = (t % pages) * kPageSize;
+        if (!shown.EqualsRange(fetched, first, kPageSize)) shown.AssignRange(fetched, first, kPageSize);
+        g_sink += shown.Length(0);
+    }
+    Report("page as pool ids", ElapsedMs(start), turns, 0);
+    return 0;
+}
+
+// ---------------------------------------------------------
+// mixed
+// ---------------------------------------------------------
+
+// A word of the synthetic lexicon, as the abbreviations table holds it.
+struct MixedBenchWord
+{
+    std::string pinyin;
+    std::string initials;
+};
+
+static bool InitialsBefore(const MixedBenchWord& a, const MixedBenchWord& b)
+{
+    return a.initials < b.initials;
+}
+
+static int BenchMixed(int, char*[])
+{
+    static const char* syllables[] = {
+        "ni", "hao", "zhong", "guo", "ren", "shi", "jie", "xue", "sheng", "huo", "bei", "jing", "da", "shu", "ru", "fa",
+        "tian", "qi", "yu", "bao", "chang", "cheng", "an", "ai", "er", "lv", "xiang", "zhuang", "wo", "men", "dian", "nao"
+    };
+    const size_t syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+
+    // Two- to four-syllable words, sorted by initials like the table
+    std::mt19937 rng(49);
+    std::vector<std::vector<const char*>> spellings(40000);
+    std::vector<MixedBenchWord> words(spellings.size());
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        size_t count = 2 + rng() % 3;
+        for (size_t s = 0; s < count; ++s)
+        {
+            const char* syllable = syllables[rng() % syllableCount];
+            spellings[i].push_back(syllable);
+            words[i].pinyin += syllable;
+            words[i].initials += syllable[0];
+        }
+    }
+
+    // Each typed with at least one syllable before the last cut to its
+    // initial (zh, ch, sh to one or two letters); the last sometimes too
+    std::vector<std::string> keys;
+    std::vector<std::string> intended;
+    for (size_t k = 0; k < 5000; ++k)
+    {
+        const std::vector<const char*>& spelling = spellings[rng() % spellings.size()];
+        std::string key;
+        size_t cut = rng() % (spelling.size() - 1);
+        for (size_t s = 0; s < spelling.size(); ++s)
+        {
+            const char* syllable = spelling[s];
+            size_t initial = PinyinInitialLength(syllable, strlen(syllable));
+            bool abbreviate = initial > 0 && (s == cut || rng() % 4 == 0);
+            if (abbreviate) key.append(syllable, initial == 2 && rng() % 2 ? 2 : 1);
+            else key += syllable;
+        }
+        keys.push_back(key);
+        intended.push_back(std::string());
+        for (const char* syllable : spelling) intended.back() += syllable;
+    }
+
+    CCompositionArena arena(64 * 1024);
+    std::vector<MixedReading> readings;
+    size_t mixed = 0;
+    size_t readingTotal = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (const std::string& key : keys)
+    {
+        size_t count = GetMixedReadings(key.data(), key.length(), readings, 5, &arena);
+        arena.Reset();
+        if (count > 0) mixed++;
+        readingTotal += count;
+    }
+    printf("mixed: %zu keys over %zu words\n", keys.size(), words.size());
+    Report("lattice readings", ElapsedMs(start), keys.size(), 0);
+    printf("  %-28s %10zu read as mixed, %.2f readings each; %zu read as full pinyin or not at all\n", "",
+           mixed, mixed ? (double)readingTotal / mixed : 0.0, keys.size() - mixed);
+
+    // The initials ranges of each key, filtered by its readings
+    std::sort(words.begin(), words.end(), InitialsBefore);
+    std::vector<std::string> ranges;
+    size_t rows = 0;
+    size_t matched = 0;
+    size_t found = 0;
+    start = BenchClock::now();
+    for (size_t k = 0; k < keys.size(); ++k)
+    {
+        const std::string& key = keys[k];
+        size_t count = GetMixedReadings(key.data(), key.length(), readings, 5, &arena);
+        arena.Reset();
+        size_t rangeCount = GetMixedSearchKeys(readings, count, ranges);
+        bool hit = false;
+        for (size_t r = 0; r < rangeCount; ++r)
+        {
+            MixedBenchWord probe = { std::string(), ranges[r] };
+            auto it = std::lower_bound(words.begin(), words.end(), probe, InitialsBefore);
+            for (; it != words.end() && it->initials.compare(0, ranges[r].length(), ranges[r]) == 0; ++it)
+            {
+                rows++;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (MatchesMixedReading(key.data(), readings[i], it->pinyin.data(), it->pinyin.length(),
+                                            it->initials.data(), it->initials.length()))
+                    {
+                        matched++;
+                        hit = hit || it->pinyin.compare(0, intended[k].length(), intended[k]) == 0;
+                        break;
+                    }
+                }
+            }
+        }
+        if (hit) found++;
+    }
+    double ms = ElapsedMs(start);
+    Report("ranges filtered, per row", ms, rows, 0);
+    printf("  %-28s %10.1f rows per key, %.1f%% kept; intended word found for %.1f%% of the mixed keys\n", "",
+           (double)rows / keys.size(), rows ? 100.0 * matched / rows : 0.0, mixed ? 100.0 * found / mixed : 0.0);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: PerfBench <benchmark> [args]\n");
+        printf("  tones <pinyin.txt>   Tone-mark stripping throughput\n");
+        printf("  normalize            Key normalization and auto-correction\n");
+        printf("  rules [file]         Auto-correction cost vs rule count\n");
+        printf("  typo                 Typo-tolerant key search\n");
+        printf("  compose [events]     Composition key events per second\n");
+        printf("  fuzz [events] [seed] Composition state machine invariants\n");
+        printf("  caret                Caret strategy cache\n");
+        printf("  layout               Candidate layout, extent cache and hit testing\n");
+        printf("  alloc                Heap allocations per steady-state keystroke\n");
+        printf("  pool                 Candidate pages as pool ids vs strings\n");
+        printf("  mixed                Keys mixing whole syllables and initials\n");
+        return 1;
+    }
+
+    std::string name = argv[1];
+    if (name == "tones") return BenchTones(argc, argv);
+    if (name == "normalize") return BenchNormalize(argc, argv);
+    if (name == "rules") return BenchRules(argc, argv);
+    if (name == "typo") return BenchTypo(argc, argv);
+    if (name == "compose") return BenchCompose(argc, argv);
+    if (name == "fuzz") return FuzzCompose(argc, argv);
+    if (name == "caret") return BenchCaret(argc, argv);
+    if (name == "layout") return BenchLayout(argc, argv);
+    if (name == "alloc") return BenchAlloc(argc, argv);
+    if (name == "pool") return BenchPool(argc, argv);
+    if (name == "mixed") return BenchMixed(argc, argv);
+
+    fprintf(stderr, "Unknown benchmark: %s\n", argv[1]);
+    return 1;
+}
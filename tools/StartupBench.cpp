@@ -0,0 +1,297 @@
+// Dictionary activation cost: the old first-run path (copy utime.db into a
+// writable directory, open it read-write, COUNT(*) the lexicon) against
+// opening the shipped file in place as an immutable database.
+//
+// "Cold" runs evict the database from the OS page cache first
+// (posix_fadvise; on Windows there is no unprivileged equivalent, so only
+// the first iteration is cold there). "Warm" runs repeat with the cache hot,
+// as when a second application activates the IME.
+//
+// The last section measures the first keystroke after a cold activation,
+// with and without warming the lexicon's hot set (the hot_pages table
+// written by DictBuilder, or recorded on the spot for older files) the way
+// the engine does on its loader thread.
+//
+// Usage: StartupBench <utime.db> [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "sqlite/sqlite3.h"
+#include "SqliteUri.h"
+#include "HotPageRecorder.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double ElapsedMs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+static void EvictFromCache(const std::filesystem::path& path)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#else
+    (void)path;
+#endif
+}
+
+// Run `sql` to completion; returns the number of rows.
+static int Exec(sqlite3* db, const char* sql)
+{
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return -1;
+    int rows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) rows++;
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+// The first query a user sees: a short prefix with the engine's ordering.
+static const char* kFirstQuery =
+    "SELECT hanzi FROM lexicon WHERE (pinyin_clean >= 'ni' AND pinyin_clean < 'nj') "
+    "ORDER BY length(pinyin_clean), priority DESC LIMIT 20;";
+
+// The first keystroke: a single letter.
+static const char* kFirstKeyQuery =
+    "SELECT hanzi FROM lexicon WHERE (pinyin_clean >= 'n' AND pinyin_clean < 'o') "
+    "ORDER BY length(pinyin_clean), priority DESC LIMIT 20;";
+
+// Time until the engine is ready, then time for the first query.
+struct ActivationTiming
+{
+    double readyMs;
+    double firstQueryMs;
+};
+
+static ActivationTiming Failed()
+{
+    ActivationTiming timing = { -1.0, -1.0 };
+    return timing;
+}
+
+static ActivationTiming Activate(sqlite3* db, const char* validation, BenchClock::time_point start)
+{
+    ActivationTiming timing;
+    Exec(db, validation);
+    timing.readyMs = ElapsedMs(start);
+    auto query = BenchClock::now();
+    Exec(db, kFirstQuery);
+    timing.firstQueryMs = ElapsedMs(query);
+    sqlite3_close(db);
+    return timing;
+}
+
+// Previous behaviour on a user's first activation.
+static ActivationTiming CopyAndOpen(const std::filesystem::path& source, const std::filesystem::path& copy)
+{
+    std::error_code error;
+    std::filesystem::remove(copy, error);
+
+    auto start = BenchClock::now();
+    std::filesystem::copy_file(source, copy, std::filesystem::copy_options::overwrite_existing, error);
+    sqlite3* db = NULL;
+    if (error || sqlite3_open(copy.string().c_str(), &db) != SQLITE_OK) return Failed();
+    return Activate(db, "SELECT COUNT(*) FROM lexicon LIMIT 1;", start);
+}
+
+// Previous behaviour on later activations: the copy exists already.
+static ActivationTiming OpenCopy(const std::filesystem::path& copy)
+{
+    auto start = BenchClock::now();
+    sqlite3* db = NULL;
+    if (sqlite3_open(copy.string().c_str(), &db) != SQLITE_OK) return Failed();
+    return Activate(db, "SELECT COUNT(*) FROM lexicon LIMIT 1;", start);
+}
+
+// Current behaviour: open the shipped file where it is.
+static ActivationTiming OpenInPlace(const std::filesystem::path& source)
+{
+    auto start = BenchClock::now();
+    sqlite3* db = NULL;
+    std::string uri = MakeImmutableSqliteUri(source.u8string());
+    if (sqlite3_open_v2(uri.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, NULL) != SQLITE_OK) return Failed();
+    return Activate(db, "SELECT 1 FROM lexicon LIMIT 1;", start);
+}
+
+// Hot set stored in the lexicon, or recorded now if the file predates it.
+static bool LoadHotSet(const std::filesystem::path& source, std::vector<PageRun>& runs, int& pageSize, bool& stored)
+{
+    runs.clear();
+    pageSize = 0;
+    stored = false;
+    sqlite3* db = NULL;
+    if (sqlite3_open_v2(source.string().c_str(), &db, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK)
+    {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "PRAGMA page_size;", -1, &stmt, 0) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_ROW) pageSize = sqlite3_column_int(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+        if (sqlite3_prepare_v2(db, "SELECT first_page, page_count FROM hot_pages ORDER BY first_page;", -1, &stmt, 0) == SQLITE_OK)
+        {
+            stored = true;
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                PageRun run = { (uint32_t)sqlite3_column_int64(stmt, 0), (uint32_t)sqlite3_column_int64(stmt, 1) };
+                runs.push_back(run);
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
+    sqlite3_close(db);
+    if (stored && pageSize > 0) return true;
+    return RecordHotPages(source.string(), GetHotPrefixes(), 4, runs, pageSize);
+}
+
+// Read the hot set through the file cache, as PrefetchFileRanges does.
+static size_t WarmHotSet(const std::filesystem::path& source, const std::vector<PageRun>& runs, int pageSize)
+{
+    FILE* file = fopen(source.string().c_str(), "rb");
+    if (!file) return 0;
+    std::vector<char> buffer;
+    size_t total = 0;
+    for (const PageRun& run : runs)
+    {
+        buffer.resize((size_t)run.count * pageSize);
+        if (fseek(file, (long)((long long)run.first * pageSize), SEEK_SET) != 0) continue;
+        total += fread(buffer.data(), 1, buffer.size(), file);
+    }
+    fclose(file);
+    return total;
+}
+
+// Cold activation, optionally warming the hot set before the first key
+// arrives; returns the time of that first key's query.
+static double FirstKeystroke(const std::filesystem::path& source, const std::vector<PageRun>* hotSet, int pageSize,
+                             double& warmMs)
+{
+    EvictFromCache(source);
+    sqlite3* db = NULL;
+    std::string uri = MakeImmutableSqliteUri(source.u8string());
+    if (sqlite3_open_v2(uri.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, NULL) != SQLITE_OK) return -1.0;
+    Exec(db, "SELECT 1 FROM lexicon LIMIT 1;");
+
+    auto warm = BenchClock::now();
+    if (hotSet) WarmHotSet(source, *hotSet, pageSize);
+    warmMs = ElapsedMs(warm);
+
+    auto query = BenchClock::now();
+    Exec(db, kFirstKeyQuery);
+    double queryMs = ElapsedMs(query);
+    sqlite3_close(db);
+    return queryMs;
+}
+
+static double Median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+static void Report(const char* name, const std::vector<ActivationTiming>& samples)
+{
+    std::vector<double> ready, query;
+    for (const ActivationTiming& timing : samples)
+    {
+        if (timing.readyMs < 0)
+        {
+            printf("  %-24s failed\n", name);
+            return;
+        }
+        ready.push_back(timing.readyMs);
+        query.push_back(timing.firstQueryMs);
+    }
+    printf("  %-24s ready %9.2f ms   first query %9.2f ms   (medians)\n", name, Median(ready), Median(query));
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: StartupBench <utime.db> [iterations]\n");
+        return 1;
+    }
+
+    std::filesystem::path source = argv[1];
+    int iterations = argc > 2 ? atoi(argv[2]) : 10;
+    if (iterations < 1) iterations = 1;
+
+    std::error_code error;
+    auto size = std::filesystem::file_size(source, error);
+    if (error)
+    {
+        fprintf(stderr, "Cannot read %s\n", argv[1]);
+        return 1;
+    }
+    std::filesystem::path copy = std::filesystem::temp_directory_path() / "utime_startup_copy.db";
+
+    printf("Lexicon: %s (%.1f MB), %d iterations\n", source.string().c_str(), size / (1024.0 * 1024.0), iterations);
+
+    std::vector<ActivationTiming> copyCold, copyWarm, reopenCold, reopenWarm, inPlaceCold, inPlaceWarm;
+    for (int i = 0; i < iterations; ++i)
+    {
+        EvictFromCache(source);
+        copyCold.push_back(CopyAndOpen(source, copy));
+        copyWarm.push_back(CopyAndOpen(source, copy));
+
+        EvictFromCache(copy);
+        reopenCold.push_back(OpenCopy(copy));
+        reopenWarm.push_back(OpenCopy(copy));
+
+        EvictFromCache(source);
+        inPlaceCold.push_back(OpenInPlace(source));
+        inPlaceWarm.push_back(OpenInPlace(source));
+    }
+    std::filesystem::remove(copy, error);
+
+    printf("First activation (before: copy + open + COUNT(*))\n");
+    Report("copy, cold", copyCold);
+    Report("copy, warm", copyWarm);
+    printf("Later activations (before: open copy + COUNT(*))\n");
+    Report("open copy, cold", reopenCold);
+    Report("open copy, warm", reopenWarm);
+    printf("Every activation (now: immutable open in place)\n");
+    Report("in place, cold", inPlaceCold);
+    Report("in place, warm", inPlaceWarm);
+
+    std::vector<PageRun> hotSet;
+    int pageSize = 0;
+    bool stored = false;
+    if (!LoadHotSet(source, hotSet, pageSize, stored))
+    {
+        printf("Cannot record the hot set\n");
+        return 0;
+    }
+    size_t hotPages = 0;
+    for (const PageRun& run : hotSet) hotPages += run.count;
+
+    std::vector<double> plainKey, warmedKey, warmCost;
+    for (int i = 0; i < iterations; ++i)
+    {
+        double warmMs = 0;
+        plainKey.push_back(FirstKeystroke(source, NULL, pageSize, warmMs));
+        warmedKey.push_back(FirstKeystroke(source, &hotSet, pageSize, warmMs));
+        warmCost.push_back(warmMs);
+    }
+    printf("First keystroke after a cold activation ('n'; hot set %s: %zu pages in %zu runs, %.1f KB)\n",
+           stored ? "from hot_pages" : "recorded now", hotPages, hotSet.size(), hotPages * pageSize / 1024.0);
+    printf("  %-24s first key %9.2f ms\n", "no prefetch", Median(plainKey));
+    printf("  %-24s first key %9.2f ms   prefetch %9.2f ms in the background   (medians)\n", "hot set prefetched",
+           Median(warmedKey), Median(warmCost));
+    return 0;
+}
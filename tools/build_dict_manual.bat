@@ -23,9 +23,9 @@ if %errorlevel% neq 0 (
 echo.
 echo Running DictBuilder...
 if exist "tools\DictBuilder\x64\Debug\DictBuilder.exe" (
-    "tools\DictBuilder\x64\Debug\DictBuilder.exe" src\cedict_ts.u8 src\utime.db
+    "tools\DictBuilder\x64\Debug\DictBuilder.exe" src\cedict_ts.u8 src\utime.db src\pinyin.txt
 ) else if exist "tools\DictBuilder\Debug\DictBuilder.exe" (
-    "tools\DictBuilder\Debug\DictBuilder.exe" src\cedict_ts.u8 src\utime.db
+    "tools\DictBuilder\Debug\DictBuilder.exe" src\cedict_ts.u8 src\utime.db src\pinyin.txt
 ) else (
     echo [ERROR] DictBuilder.exe not found.
     exit /b 1